@@ -10,45 +10,132 @@
  *
  *************************************************************************/
 
+#include <errno.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include "assert.h"
+#include <unistd.h>
+#include <stdbool.h>
 #include "compress40.h"
+#include "batch.h"
+#include "uarray2rows.h"
+#include "a2blocked.h"
 
 static void (*compress_or_decompress)(FILE *input) = compress40;
+static void (*compress_or_decompress_file)(const char *path) = compress40_file;
+
+static void usage(const char *progname)
+{
+        fprintf(stderr, "Usage: %s -d [-j threads] [--fixed|--tables] "
+                "[filename]\n"
+                "       %s -c [-j threads] [--fixed|--tables] [filename]\n"
+                "       %s -d|-c [-j threads] [--fixed|--tables] --batch "
+                "list --outdir dir\n"
+                "       %s -d|-c --layout plain|blocked [--tables] "
+                "[filename]\n"
+                "       %s -d|-c --layout plain|blocked [--tables] "
+                "[-j threads] --batch list --outdir dir\n",
+                progname, progname, progname, progname, progname);
+        exit(1);
+}
 
 int main(int argc, char *argv[])
 {
         int i;
+        bool compress = true;
+        long threads = 0;
+        const char *batch = NULL, *outdir = NULL;
+        A2Methods_T layout = NULL;
+        bool fixed = false;
+        bool tables = false;
 
         for (i = 1; i < argc; i++) {
                 if (strcmp(argv[i], "-c") == 0) {
                         compress_or_decompress = compress40;
+                        compress_or_decompress_file = compress40_file;
+                        compress = true;
                 } else if (strcmp(argv[i], "-d") == 0) {
                         compress_or_decompress = decompress40;
+                        compress_or_decompress_file = decompress40_file;
+                        compress = false;
+                } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+                        char *end;
+                        threads = strtol(argv[++i], &end, 10);
+                        if (*end != '\0' || threads < 1 || threads > 1024) {
+                                fprintf(stderr, "%s: bad thread count '%s'\n",
+                                        argv[0], argv[i]);
+                                exit(1);
+                        }
+                } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+                        batch = argv[++i];
+                } else if (strcmp(argv[i], "--outdir") == 0 && i + 1 < argc) {
+                        outdir = argv[++i];
+                } else if (strcmp(argv[i], "--layout") == 0 && i + 1 < argc) {
+                        i++;
+                        if (strcmp(argv[i], "plain") == 0) {
+                                layout = uarray2_methods_plain_rows;
+                        } else if (strcmp(argv[i], "blocked") == 0) {
+                                layout = uarray2_methods_blocked;
+                        } else {
+                                usage(argv[0]);
+                        }
+                } else if (strcmp(argv[i], "--fixed") == 0) {
+                        fixed = true;
+                } else if (strcmp(argv[i], "--tables") == 0) {
+                        tables = true;
                 } else if (*argv[i] == '-') {
                         fprintf(stderr, "%s: unknown option '%s'\n",
                                 argv[0], argv[i]);
                         exit(1);
                 } else if (argc - i > 2) {
-                        fprintf(stderr, "Usage: %s -d [filename]\n"
-                                "       %s -c [filename]\n",
-                                argv[0], argv[0]);
-                        exit(1);
+                        usage(argv[0]);
                 } else {
                         break;
                 }
         }
         assert(argc - i <= 1);    /* at most one file on command line */
+        /* the staged pipeline runs each image on one thread */
+        if (layout != NULL && batch == NULL && threads > 1) {
+                usage(argv[0]);
+        }
+        /* and always in floating point */
+        if (layout != NULL && fixed) {
+                usage(argv[0]);
+        }
+        /* which has its own conversion */
+        if (fixed && tables) {
+                usage(argv[0]);
+        }
+        compress40_methods(layout);
+        compress40_fixed(fixed);
+        compress40_tables(tables);
+        if (batch != NULL || outdir != NULL) {
+                if (batch == NULL || outdir == NULL || i < argc) {
+                        usage(argv[0]);
+                }
+                /* one file per thread, as many threads as cores by default */
+                if (threads == 0) {
+                        threads = sysconf(_SC_NPROCESSORS_ONLN);
+                }
+                int failed = batch_run(batch, outdir, compress, 
+                                       threads < 1 ? 1 : threads);
+                return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+        if (threads > 0) {
+                compress40_threads(threads);
+        }
         if (i < argc) {
-                FILE *fp = fopen(argv[i], "r");
-                assert(fp != NULL);
-                compress_or_decompress(fp);
-                fclose(fp);
+                compress_or_decompress_file(argv[i]);
         } else {
                 compress_or_decompress(stdin);
         }
+        /* a failed write only sets stdout's error flag */
+        if (fflush(stdout) != 0 || ferror(stdout)) {
+                fprintf(stderr, "%s: can't write output: %s\n", argv[0], 
+                        strerror(errno != 0 ? errno : EIO));
+                return EXIT_FAILURE;
+        }
 
         return EXIT_SUCCESS; 
 }
@@ -15,6 +15,7 @@
 #include <string.h>
 #include <a2plain.h>
 #include "uarray2.h"
+#include "uarray2rows.h"
 #include "assert.h"
 
 /************************************************/
@@ -23,6 +24,12 @@
 /************************************************/
 typedef A2Methods_UArray2 A2; 
 
+/* map_block_major visits tiles of about this many bytes, which leaves room
+ * for the tile being written in a 32KB L1 cache */
+#define TILE_BYTES (16 * 1024)
+
+static int tile_side(A2Methods_UArray2 uarray2);
+
 /* Struct */
 struct small_closure {
         A2Methods_smallapplyfun *apply; 
@@ -74,6 +81,37 @@ static A2Methods_UArray2 new_with_blocksize(int width, int height, int size,
         return UArray2_new(width, height, size);
 }
 
+/****************** new_rows *********************************************
+ *
+ * calls UArray2_new_row_major which returns a new Uarray2_T stored row by 
+ * row
+ *
+ * Parameters:
+ *      int width: number of columns for this new Uarray2_T
+ *      int height: number of rows in our new Uarray2_T
+ *      int size: the amount of memory needed for each index
+ *      int blocksize: unused, this isn't a blocked implementation
+ *
+ * Return: UArray2_T that has been created as an A2Methods_UArray2
+ *
+ * Expects
+ *      width, height, size must be greater than zero.
+ * Notes:
+ *      may CRE if unable to allocate space or if expects not met. The 
+ *      rest of the methods are shared with uarray2_methods_plain.
+ ************************************************************************/
+static A2Methods_UArray2 new_rows(int width, int height, int size)
+{
+        return UArray2_new_row_major(width, height, size);
+}
+
+static A2Methods_UArray2 new_with_blocksize_rows(int width, int height, 
+                                                 int size, int blocksize)
+{
+        (void) blocksize;
+        return UArray2_new_row_major(width, height, size);
+}
+
 /****************** a2free ***********************************************
  *
  * Frees any/all allocated space used by the A2 array.
@@ -256,6 +294,63 @@ static void map_col_major(A2Methods_UArray2 uarray2,
         UArray2_map_col_major(uarray2, (applyfun *)apply, cl);
 }
 
+/******************* map_block_major ************************************
+ *
+ * Calls an apply function for each element in the A2Methods_UArray2, one 
+ * square tile at a time. The tiles are about TILE_BYTES of elements, an 
+ * even number on a side, and are visited in row major order, as are the 
+ * elements in each tile.
+ *
+ * Parameters:
+ *      A2Methods_UArray2 array: The array to be traversed
+ *      void apply: some function that will be called on every value of
+ *                  the A2Methods_UArray2
+ *      void *cl: a void pointer that can be passed by reference into
+ *                     each call of the apply function
+ *
+ * Return: none
+ *
+ * Expects
+ *      valid, initialized UArray2_T
+ *      implemented function, apply, closure if necessary
+ *
+ * Notes:
+ *      A plain array has a blocksize of 1, so any order is block major; 
+ *      tiles are used so that neighbouring elements (and the 2-by-2 blocks
+ *      the DCT works on, which a tile never splits) are visited while they
+ *      are still in the cache.
+ ************************************************************************/
+static void map_block_major(A2Methods_UArray2 uarray2,
+                            A2Methods_applyfun apply,
+                            void *cl)
+{
+        UArray2_map_tiles(uarray2, tile_side(uarray2), (applyfun *)apply, 
+                          cl);
+}
+
+/********************* tile_side *****************************************
+ *
+ * Works out the side of the tiles map_block_major uses for an array: the 
+ * largest even number of elements whose square fits in TILE_BYTES.
+ *
+ * Parameters:
+ *      A2Methods_UArray2 array: The array to be traversed
+ *
+ * Return: the side of a tile, at least 2
+ *
+ * Expects
+ *      valid, initialized UArray2_T
+ ************************************************************************/
+static int tile_side(A2Methods_UArray2 uarray2)
+{
+        int size = UArray2_size(uarray2);
+        int side = 2;
+        while ((side + 2) * (side + 2) * size <= TILE_BYTES) {
+                side += 2;
+        }
+        return side;
+}
+
 /************************* apply_small ***********************************
  *
  * Calls an apply function found in the closure for a given element
@@ -349,6 +444,35 @@ static void small_map_col_major(A2Methods_UArray2        a2,
         UArray2_map_col_major(a2, apply_small, &mycl);
 }
 
+/***************** small_map_block_major ********************************
+ *
+ * Calls apply_small for each element in the A2Methods_UArray2 after making
+ * a closure with the original apply and closure to pass through, in the
+ * same tile order as map_block_major.
+ *
+ * Parameters:
+ *      A2Methods_UArray2 array: The array to be traversed
+ *      void apply: some function that will be called on every value of
+ *                  the A2Methods_UArray2
+ *      void *cl: a void pointer that can be passed by reference into
+ *                     each call of the apply function
+ *
+ * Return: none
+ *
+ * Expects
+ *      valid, initialized UArray2_T
+ *      implemented function, apply, closure if necessary
+ *
+ * Notes:
+ *      may CRE if given inproper inputs
+ ************************************************************************/
+static void small_map_block_major(A2Methods_UArray2        a2,
+                                  A2Methods_smallapplyfun  apply,
+                                  void *cl)
+{
+        struct small_closure mycl = { apply, cl };
+        UArray2_map_tiles(a2, tile_side(a2), apply_small, &mycl);
+}
 
 static struct A2Methods_T uarray2_methods_plain_struct = {
         new,
@@ -361,14 +485,56 @@ static struct A2Methods_T uarray2_methods_plain_struct = {
         at,
         map_row_major,                  
         map_col_major,           
-        NULL,                      /* map_block_major */
+        map_block_major,
         map_row_major,             /* map default */
         small_map_row_major,
         small_map_col_major,
-        NULL,                     /* small_map_block_major */
+        small_map_block_major,
         small_map_row_major,      /* small map default */
 };
 
 /* finally the payoff: here is the exported pointer to the struct */
 
 A2Methods_T uarray2_methods_plain = &uarray2_methods_plain_struct;
+
+/* the same methods, but new arrays are stored row by row */
+static struct A2Methods_T uarray2_methods_plain_rows_struct = {
+        new_rows,
+        new_with_blocksize_rows,
+        a2free,
+        width,
+        height,
+        size,
+        blocksize,
+        at,
+        map_row_major,                  
+        map_col_major,           
+        map_block_major,
+        map_row_major,             /* map default */
+        small_map_row_major,
+        small_map_col_major,
+        small_map_block_major,
+        small_map_row_major,      /* small map default */
+};
+
+A2Methods_T uarray2_methods_plain_rows = &uarray2_methods_plain_rows_struct;
+
+/********************* uarray2_methods_is_plain **************************
+ *
+ * Tells whether a methods suite is one of the two in this file, whose 
+ * arrays are all UArray2_T's and so can be asked their layout (see 
+ * uarray2rows.h).
+ *
+ * Parameters:
+ *      A2Methods_T methods: the suite
+ *
+ * Return: true for uarray2_methods_plain and uarray2_methods_plain_rows
+ *
+ * Expects
+ *      nothing
+ ************************************************************************/
+bool uarray2_methods_is_plain(A2Methods_T methods)
+{
+        return methods == uarray2_methods_plain || 
+               methods == uarray2_methods_plain_rows;
+}
@@ -0,0 +1,734 @@
+/*************************************************************************
+ *
+ *                     batch.c
+ *
+ *     Assignment: arith
+ *     Author:   Eva Caro
+ *     Date:     3/6/24
+ *
+ *     Implementation of batch. The files are dealt out to the threads in 
+ *     equal runs, one deque of file numbers per thread. A thread takes 
+ *     files from the front of its own deque, and once that is empty it 
+ *     steals from the back of the others', so a thread stuck with large 
+ *     files doesn't hold up the rest. Each thread keeps one 
+ *     compress40_context, so its buffers are reused from file to file.
+ *
+ *************************************************************************/
+
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "batch.h"
+#include "compress40.h"
+#include "assert.h"
+#include "mem.h"
+
+/* the file numbers a thread has left: first to last - 1 */
+struct deque {
+        pthread_mutex_t lock;
+        int first, last;
+};
+
+/* everything the threads share */
+struct batch {
+        char **paths;
+        int count;
+        /* where each file's result goes, or NULL if it is not to be done */
+        char **outputs;
+        const char *outdir;
+        bool compress;
+        unsigned threads;
+        struct deque *deques;
+        /* totals, under lock */
+        pthread_mutex_t lock;
+        size_t bytes_in, bytes_out;
+        int done, failed;
+};
+
+/* what one thread is given */
+struct batch_worker {
+        struct batch *batch;
+        unsigned id;
+        compress40_context context;
+};
+
+static char **read_list(const char *list, int *count);
+static void find_outputs(struct batch *batch);
+static int compare_outputs(const void *x, const void *y);
+static void *batch_main(void *arg);
+static int next_file(struct batch *batch, unsigned id);
+static void do_file(struct batch_worker *self, int file);
+static const char *check_header(const char *path, bool compress, 
+                                const struct stat *info);
+static const char *check_ppm(FILE *input, uint64_t *need);
+static const char *check_c40(FILE *input, uint64_t *need);
+static bool read_number(FILE *input, bool comments, unsigned *n);
+static void fail_file(struct batch *batch, const char *name, 
+                      const char *reason);
+static char *output_path(const char *path, const char *outdir, 
+                         bool compress);
+static double seconds(void);
+static double rate(size_t bytes, double time);
+
+/********** batch_run *****************************************************
+ *
+ * This function compresses (or decompresses) every file named in a list, 
+ * writing the results into a directory, and prints how long each file and
+ * the whole batch took.
+ *
+ * Parameters:
+ *      const char *list        name of a file with one path per line
+ *      const char *outdir      directory to write the results to
+ *      bool compress           true to compress, false to decompress
+ *      unsigned threads        number of files to work on at once
+ *
+ * Return: the number of files that couldn't be done
+ *
+ * Expects: list and outdir are not NULL, threads is at least 1
+ *     
+ * Notes: a compressed file is named after its input plus ".c40", and a 
+ *        decompressed one after its input minus ".c40" (or plus ".ppm" if
+ *        it doesn't end in ".c40"). outdir is made if it doesn't exist.
+ *        Throughput is printed to stderr.
+ *    -   Files whose results would have the same name (a/x.ppm and 
+ *        b/x.ppm) would be written at the same time by different threads,
+ *        so only the first of them in the list is done and the others are
+ *        counted as failed.
+ *    -   Files that can't be opened are skipped, and so are files whose 
+ *        header is wrong or that are shorter than their header says 
+ *        (check_header), before their output is made. A malformed file the
+ *        header check can't see (a sample over the denominator, or a bad 
+ *        one in a plain ppm) still stops the whole batch, just as it stops a single 40image run, since an
+ *        exception on a thread can't be caught (see workers.h).
+ *    -   Each file is done on a single thread; the threads work on 
+ *        different files, and their contexts grow with ALLOC (which is 
+ *        thread safe, see workers.h).
+ *      
+ ***********************************************************************/
+int batch_run(const char *list, const char *outdir, bool compress, 
+              unsigned threads)
+{
+        assert(list != NULL && outdir != NULL);
+        assert(threads >= 1);
+        if (mkdir(outdir, 0777) != 0 && errno != EEXIST) {
+                fprintf(stderr, "cannot make directory %s: %s\n", outdir,
+                        strerror(errno));
+                exit(1);
+        }
+
+        struct batch batch;
+        batch.paths = read_list(list, &batch.count);
+        batch.outdir = outdir;
+        batch.compress = compress;
+        batch.threads = threads;
+        batch.bytes_in = batch.bytes_out = 0;
+        batch.done = batch.failed = 0;
+        pthread_mutex_init(&batch.lock, NULL);
+        find_outputs(&batch);
+
+        /* deal the files out in equal runs, and give each thread a context
+           up front */
+        batch.deques = ALLOC(threads * sizeof(struct deque));
+        struct batch_worker *workers = ALLOC(threads * 
+                                             sizeof(struct batch_worker));
+        pthread_t *ids = ALLOC(threads * sizeof(pthread_t));
+        for (unsigned i = 0; i < threads; i++) {
+                pthread_mutex_init(&batch.deques[i].lock, NULL);
+                batch.deques[i].first = (long)batch.count * i / threads;
+                batch.deques[i].last = (long)batch.count * (i + 1) / threads;
+                workers[i].batch = &batch;
+                workers[i].id = i;
+                workers[i].context = compress40_context_new(1);
+        }
+
+        double start = seconds();
+        for (unsigned i = 1; i < threads; i++) {
+                int err = pthread_create(&ids[i], NULL, batch_main, 
+                                         &workers[i]);
+                assert(err == 0);
+        }
+        batch_main(&workers[0]);
+        for (unsigned i = 1; i < threads; i++) {
+                pthread_join(ids[i], NULL);
+        }
+        double time = seconds() - start;
+
+        fprintf(stderr, "%d files (%d failed), %zu -> %zu bytes, %.3f s, "
+                "%.1f MB/s in, %.1f files/s\n", batch.done, batch.failed, 
+                batch.bytes_in, batch.bytes_out, time, 
+                rate(batch.bytes_in, time), 
+                time > 0 ? batch.done / time : 0.0);
+
+        for (unsigned i = 0; i < threads; i++) {
+                compress40_context_free(&workers[i].context);
+                pthread_mutex_destroy(&batch.deques[i].lock);
+        }
+        for (int i = 0; i < batch.count; i++) {
+                FREE(batch.paths[i]);
+                free(batch.outputs[i]);
+        }
+        if (batch.paths != NULL) {
+                FREE(batch.paths);
+                FREE(batch.outputs);
+        }
+        FREE(batch.deques);
+        FREE(workers);
+        FREE(ids);
+        pthread_mutex_destroy(&batch.lock);
+        return batch.failed;
+}
+
+/********** read_list *****************************************************
+ *
+ * This function reads a list of paths, one per line. Blank lines are 
+ * skipped.
+ *
+ * Parameters:
+ *      const char *list        name of the file holding the list, or "-" 
+ *                              for standard input
+ *      int *count              where to put the number of paths
+ *
+ * Return: an array of the paths, or NULL if there are none
+ *
+ * Expects: list and count are not NULL
+ *     
+ * Notes: exits if the list can't be opened. The array and each path are 
+ *        freed by batch_run.
+ *      
+ ***********************************************************************/
+static char **read_list(const char *list, int *count)
+{
+        FILE *fp = (strcmp(list, "-") == 0) ? stdin : fopen(list, "r");
+        if (fp == NULL) {
+                fprintf(stderr, "cannot open %s: %s\n", list, 
+                        strerror(errno));
+                exit(1);
+        }
+        char **paths = NULL;
+        int size = 0;
+        *count = 0;
+        char *line = NULL;
+        size_t capacity = 0;
+        ssize_t length;
+        while ((length = getline(&line, &capacity, fp)) >= 0) {
+                while (length > 0 && (line[length - 1] == '\n' || 
+                                      line[length - 1] == '\r')) {
+                        line[--length] = '\0';
+                }
+                if (length == 0) {
+                        continue;
+                }
+                if (*count == size) {
+                        size = (size == 0) ? 64 : 2 * size;
+                        if (paths == NULL) {
+                                paths = ALLOC(size * sizeof(char *));
+                        } else {
+                                RESIZE(paths, size * sizeof(char *));
+                        }
+                }
+                paths[*count] = ALLOC(length + 1);
+                memcpy(paths[*count], line, length + 1);
+                (*count)++;
+        }
+        free(line);
+        if (fp != stdin) {
+                fclose(fp);
+        }
+        return paths;
+}
+
+/* a file's number and where its result goes, for sorting by the latter */
+struct output {
+        const char *path;
+        int file;
+};
+
+/********** find_outputs **************************************************
+ *
+ * This function works out where each file's result goes, and drops every
+ * file whose result would go where an earlier file's does.
+ *
+ * Parameters:
+ *      struct batch *batch     the batch, with its paths read
+ *
+ * Return: N/A
+ *
+ * Expects: batch is not NULL
+ *     
+ * Notes: sorts the output paths to find the clashes. A dropped file's 
+ *        output is NULL and it is counted as failed. Runs before the 
+ *        threads start.
+ *      
+ ***********************************************************************/
+static void find_outputs(struct batch *batch)
+{
+        assert(batch != NULL);
+        batch->outputs = NULL;
+        if (batch->count == 0) {
+                return;
+        }
+        batch->outputs = ALLOC(batch->count * sizeof(char *));
+        struct output *sorted = ALLOC(batch->count * sizeof(struct output));
+        for (int i = 0; i < batch->count; i++) {
+                batch->outputs[i] = output_path(batch->paths[i], 
+                                                batch->outdir, 
+                                                batch->compress);
+                sorted[i].path = batch->outputs[i];
+                sorted[i].file = i;
+        }
+        qsort(sorted, batch->count, sizeof(struct output), compare_outputs);
+
+        /* each run of the same output starts with its first file; the rest
+           are dropped once the run has been compared */
+        int first = 0;
+        for (int i = 1; i <= batch->count; i++) {
+                if (i < batch->count && 
+                    strcmp(sorted[i].path, sorted[first].path) == 0) {
+                        fprintf(stderr, "%s: same output as %s\n", 
+                                batch->paths[sorted[i].file], 
+                                batch->paths[sorted[first].file]);
+                        continue;
+                }
+                for (int j = first + 1; j < i; j++) {
+                        free(batch->outputs[sorted[j].file]);
+                        batch->outputs[sorted[j].file] = NULL;
+                        batch->failed++;
+                }
+                first = i;
+        }
+        FREE(sorted);
+}
+
+/********** compare_outputs ***********************************************
+ *
+ * This function orders struct outputs by path, then by file number.
+ *
+ * Parameters:
+ *      const void *x, *y       the struct outputs to compare
+ *
+ * Return: less than, equal to, or more than 0 as x comes before, with, or
+ *         after y
+ *
+ * Expects: x and y are not NULL
+ *     
+ * Notes: for qsort
+ *      
+ ***********************************************************************/
+static int compare_outputs(const void *x, const void *y)
+{
+        const struct output *a = x, *b = y;
+        int order = strcmp(a->path, b->path);
+        if (order != 0) {
+                return order;
+        }
+        return (a->file > b->file) - (a->file < b->file);
+}
+
+/********** batch_main ****************************************************
+ *
+ * This is the body of each thread: do files until none are left anywhere.
+ *
+ * Parameters:
+ *      void *arg               the thread's struct batch_worker
+ *
+ * Return: NULL
+ *
+ * Expects: arg is not NULL
+ *     
+ * Notes: 
+ *      
+ ***********************************************************************/
+static void *batch_main(void *arg)
+{
+        struct batch_worker *self = arg;
+        int file;
+        while ((file = next_file(self->batch, self->id)) >= 0) {
+                do_file(self, file);
+        }
+        return NULL;
+}
+
+/********** next_file *****************************************************
+ *
+ * This function gives a thread the next file to work on: the front of its 
+ * own deque, or failing that the back of another thread's.
+ *
+ * Parameters:
+ *      struct batch *batch     the batch
+ *      unsigned id             number of the thread asking
+ *
+ * Return: the file's number, or -1 if every deque is empty
+ *
+ * Expects: batch is not NULL
+ *     
+ * Notes: thieves take from the back so that they rarely contend with the 
+ *        owner, who works from the front. Victims are tried in order 
+ *        starting after the thief.
+ *      
+ ***********************************************************************/
+static int next_file(struct batch *batch, unsigned id)
+{
+        struct deque *own = &batch->deques[id];
+        int file = -1;
+        pthread_mutex_lock(&own->lock);
+        if (own->first < own->last) {
+                file = own->first++;
+        }
+        pthread_mutex_unlock(&own->lock);
+
+        for (unsigned i = 1; file < 0 && i < batch->threads; i++) {
+                struct deque *victim = 
+                        &batch->deques[(id + i) % batch->threads];
+                pthread_mutex_lock(&victim->lock);
+                if (victim->first < victim->last) {
+                        file = --victim->last;
+                }
+                pthread_mutex_unlock(&victim->lock);
+        }
+        return file;
+}
+
+/********** do_file *******************************************************
+ *
+ * This function compresses or decompresses one file of the batch and 
+ * prints how long it took.
+ *
+ * Parameters:
+ *      struct batch_worker *self       the thread doing the file
+ *      int file                        the file's number
+ *
+ * Return: N/A
+ *
+ * Expects: self is not NULL
+ *     
+ * Notes: counts the file as failed if it can't be read, fails 
+ *        check_header, or its output can't be written, and then removes 
+ *        whatever of the output was written
+ *      
+ ***********************************************************************/
+static void do_file(struct batch_worker *self, int file)
+{
+        struct batch *batch = self->batch;
+        const char *path = batch->paths[file];
+        const char *out_path = batch->outputs[file];
+        if (out_path == NULL) {
+                return;         /* already counted by find_outputs */
+        }
+        struct stat info;
+        FILE *output = NULL;
+        const char *reason;
+        if (stat(path, &info) != 0 || access(path, R_OK) != 0) {
+                fail_file(batch, path, strerror(errno));
+        } else if ((reason = check_header(path, batch->compress, &info)) 
+                   != NULL) {
+                fail_file(batch, path, reason);
+        } else if ((output = fopen(out_path, "wb")) == NULL) {
+                fail_file(batch, out_path, strerror(errno));
+        }
+        if (output == NULL) {
+                return;
+        }
+
+        double start = seconds();
+        if (batch->compress) {
+                compress40_path(path, output, self->context);
+        } else {
+                decompress40_path(path, output, self->context);
+        }
+        /* a write that failed part way (say, out of space) is only 
+           remembered by the stream's error flag, and by errno */
+        long bytes_out = ftell(output);
+        bool ok = bytes_out >= 0 && fflush(output) == 0 && !ferror(output);
+        int error = errno;
+        if (fclose(output) != 0 && ok) {
+                ok = false;
+                error = errno;
+        }
+        double time = seconds() - start;
+        size_t bytes_in = info.st_size;
+
+        if (!ok) {
+                fail_file(batch, out_path, 
+                          strerror(error != 0 ? error : EIO));
+                remove(out_path);
+                return;
+        }
+        fprintf(stderr, "%s: %zu -> %ld bytes, %.3f s, %.1f MB/s\n", path, 
+                bytes_in, bytes_out, time, rate(bytes_in, time));
+        pthread_mutex_lock(&batch->lock);
+        batch->done++;
+        batch->bytes_in += bytes_in;
+        batch->bytes_out += bytes_out;
+        pthread_mutex_unlock(&batch->lock);
+}
+
+/********** check_header **************************************************
+ *
+ * This function checks that a file starts the way compress40 or 
+ * decompress40 expects, and is as long as its header says, so that most 
+ * bad files fail on their own instead of stopping the batch.
+ *
+ * Parameters:
+ *      const char *path        the file
+ *      bool compress           true if it should be a ppm, false if it 
+ *                              should be a compressed image
+ *      const struct stat *info the file's stat
+ *
+ * Return: NULL if the file looks right, otherwise why not
+ *
+ * Expects: path and info are not NULL
+ *     
+ * Notes: reads only the header. The length is only checked for regular 
+ *        files, and the samples aren't checked at all (ppmio checks them 
+ *        as each row is read).
+ *      
+ ***********************************************************************/
+static const char *check_header(const char *path, bool compress, 
+                                const struct stat *info)
+{
+        assert(path != NULL && info != NULL);
+        FILE *input = fopen(path, "rb");
+        if (input == NULL) {
+                return strerror(errno);
+        }
+        uint64_t need = 0;
+        const char *reason = compress ? check_ppm(input, &need) 
+                                      : check_c40(input, &need);
+        if (reason == NULL && S_ISREG(info->st_mode) && 
+            (uint64_t)info->st_size < need) {
+                reason = "shorter than its header says";
+        }
+        fclose(input);
+        return reason;
+}
+
+/********** check_ppm *****************************************************
+ *
+ * This function reads a ppm header the way ppm_stream_open does.
+ *
+ * Parameters:
+ *      FILE *input             the file, at its start
+ *      uint64_t *need          where to put how long the file must be
+ *
+ * Return: NULL if the header is right, otherwise why not
+ *
+ * Expects: input and need are not NULL
+ *     
+ * Notes: a plain ppm needs no more than its header. A width or height of 1
+ *        is refused, since compress40 can't trim it to an even size.
+ *      
+ ***********************************************************************/
+static const char *check_ppm(FILE *input, uint64_t *need)
+{
+        int p = getc(input);
+        int kind = getc(input);
+        if (p != 'P' || (kind != '3' && kind != '6')) {
+                return "not a ppm";
+        }
+        unsigned width, height, denominator;
+        if (!read_number(input, true, &width) || 
+            !read_number(input, true, &height) ||
+            !read_number(input, true, &denominator) || 
+            !isspace(getc(input))) {
+                return "bad ppm header";
+        }
+        if (denominator == 0 || denominator > 65535) {
+                return "bad ppm denominator";
+        }
+        if (width == 1 || height == 1) {
+                return "too small to compress";
+        }
+        long header = ftell(input);
+        *need = (header < 0) ? 0 : (uint64_t)header;
+        if (kind == '6') {
+                unsigned sample_bytes = (denominator > 255) ? 2 : 1;
+                *need += (uint64_t)width * height * 3 * sample_bytes;
+        }
+        return NULL;
+}
+
+/********** check_c40 *****************************************************
+ *
+ * This function reads a compressed image's header the way decompress40 
+ * does.
+ *
+ * Parameters:
+ *      FILE *input             the file, at its start
+ *      uint64_t *need          where to put how long the file must be
+ *
+ * Return: NULL if the header is right, otherwise why not
+ *
+ * Expects: input and need are not NULL
+ *     
+ ***********************************************************************/
+static const char *check_c40(FILE *input, uint64_t *need)
+{
+        const char *magic = "COMP40 Compressed image format 2";
+        for (size_t i = 0; magic[i] != '\0'; i++) {
+                if (getc(input) != magic[i]) {
+                        return "not a compressed image";
+                }
+        }
+        unsigned width, height;
+        if (!read_number(input, false, &width) || 
+            !read_number(input, false, &height) || getc(input) != '\n') {
+                return "bad compressed image header";
+        }
+        long header = ftell(input);
+        *need = (header < 0) ? 0 : (uint64_t)header;
+        *need += (uint64_t)(width / 2) * (height / 2) * sizeof(uint32_t);
+        return NULL;
+}
+
+/********** read_number ***************************************************
+ *
+ * This function reads an unsigned number from a header, skipping the 
+ * whitespace (and '#' comments, in a ppm) before it.
+ *
+ * Parameters:
+ *      FILE *input             where to read from
+ *      bool comments           true if '#' starts a comment
+ *      unsigned *n             where to put the number
+ *
+ * Return: true if there was a number that fits in an unsigned
+ *
+ * Expects: input and n are not NULL
+ *     
+ * Notes: leaves the character after the number unread
+ *      
+ ***********************************************************************/
+static bool read_number(FILE *input, bool comments, unsigned *n)
+{
+        int c = getc(input);
+        while (isspace(c) || (comments && c == '#')) {
+                if (c == '#') {
+                        while (c != '\n' && c != EOF) {
+                                c = getc(input);
+                        }
+                }
+                c = getc(input);
+        }
+        if (!isdigit(c)) {
+                return false;
+        }
+        *n = 0;
+        for (; isdigit(c); c = getc(input)) {
+                if (*n > (UINT_MAX - (c - '0')) / 10) {
+                        return false;
+                }
+                *n = 10 * *n + (c - '0');
+        }
+        ungetc(c, input);
+        return true;
+}
+
+/********** fail_file *****************************************************
+ *
+ * This function reports that a file of the batch couldn't be done, and 
+ * counts it as failed.
+ *
+ * Parameters:
+ *      struct batch *batch     the batch
+ *      const char *name        the file that couldn't be read or written
+ *      const char *reason      why, e.g. strerror(errno)
+ *
+ * Return: N/A
+ *
+ * Expects: batch and name are not NULL
+ *     
+ * Notes: 
+ *      
+ ***********************************************************************/
+static void fail_file(struct batch *batch, const char *name, 
+                      const char *reason)
+{
+        fprintf(stderr, "%s: %s\n", name, reason);
+        pthread_mutex_lock(&batch->lock);
+        batch->failed++;
+        pthread_mutex_unlock(&batch->lock);
+}
+
+/********** output_path ***************************************************
+ *
+ * This function works out where the result for a file goes.
+ *
+ * Parameters:
+ *      const char *path        the file's path
+ *      const char *outdir      the output directory
+ *      bool compress           true if compressing
+ *
+ * Return: outdir, then the last part of path with ".c40" added when 
+ *         compressing or taken off when decompressing (or ".ppm" added if 
+ *         there is no ".c40")
+ *
+ * Expects: path and outdir are not NULL
+ *     
+ * Notes: the result is allocated with malloc and freed by the caller
+ *      
+ ***********************************************************************/
+static char *output_path(const char *path, const char *outdir, 
+                         bool compress)
+{
+        const char *name = strrchr(path, '/');
+        name = (name == NULL) ? path : name + 1;
+        size_t length = strlen(name);
+        const char *suffix = compress ? ".c40" : ".ppm";
+        if (!compress && length > 4 && 
+            strcmp(name + length - 4, ".c40") == 0) {
+                length -= 4;
+                suffix = "";
+        }
+        size_t size = strlen(outdir) + 1 + length + strlen(suffix) + 1;
+        char *out = malloc(size);
+        assert(out != NULL);
+        snprintf(out, size, "%s/%.*s%s", outdir, (int)length, name, suffix);
+        return out;
+}
+
+/********** seconds *******************************************************
+ *
+ * This function reads the monotonic clock.
+ *
+ * Parameters: N/A
+ *
+ * Return: the time in seconds
+ *
+ * Expects: N/A
+ *     
+ * Notes: 
+ *      
+ ***********************************************************************/
+static double seconds(void)
+{
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/********** rate **********************************************************
+ *
+ * This function works out a throughput.
+ *
+ * Parameters:
+ *      size_t bytes            bytes processed
+ *      double time             seconds taken
+ *
+ * Return: megabytes per second, or 0 if no time passed
+ *
+ * Expects: N/A
+ *     
+ * Notes: 
+ *      
+ ***********************************************************************/
+static double rate(size_t bytes, double time)
+{
+        return (time > 0) ? bytes / time / 1e6 : 0.0;
+}
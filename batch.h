@@ -0,0 +1,21 @@
+/*************************************************************************
+ *
+ *                     batch.h
+ *
+ *     Assignment: arith
+ *     Author:   Eva Caro
+ *     Date:     3/6/24
+ *
+ *     Interface of batch, which compresses or decompresses a whole list of
+ *     files in one process, spread over a pool of threads.
+ *
+ *************************************************************************/
+
+#ifndef BATCH_INCLUDED
+#define BATCH_INCLUDED
+#include <stdbool.h>
+
+int batch_run(const char *list, const char *outdir, bool compress, 
+              unsigned threads);
+
+#endif
@@ -0,0 +1,210 @@
+#!/bin/bash
+#
+#                     bench.sh
+#
+#     Assignment: arith
+#     Author:   Eva Caro
+#     Date:     3/6/24
+#
+#     Times 40image on images it makes itself, so the timings quoted in
+#     README.md can be rerun on any machine. Each section prints what it
+#     compares and the best wall-clock time of $RUNS runs (or the peak RSS).
+#
+#     Usage: ./bench.sh [section ...]          (make bench runs them all)
+#     Sections: staged layouts trim memory tables
+#     Environment: IMAGE      the 40image to time (default ./40image)
+#                  RUNS       runs per timing (default 5)
+#                  BENCH_DIR  where the images are made and kept between
+#                             runs (default /tmp/arith-bench)
+#
+
+set -e
+
+IMAGE=${IMAGE:-./40image}
+RUNS=${RUNS:-5}
+BENCH_DIR=${BENCH_DIR:-/tmp/arith-bench}
+
+# make_ppm width height denominator: makes a raw ppm of that size (the
+# first time only) and prints its path. It is smooth gradients plus a
+# little noise from a fixed-seed Park-Miller generator, so every run and
+# every machine times the same bytes.
+make_ppm()
+{
+        local path="$BENCH_DIR/$1x$2-$3.ppm"
+        if [ ! -e "$path" ]; then
+                LC_ALL=C awk -v w="$1" -v h="$2" -v d="$3" '
+                BEGIN {
+                        for (i = 0; i < 256; i++)
+                                chr[i] = sprintf("%c", i)
+                        printf "P6\n%d %d\n%d\n", w, h, d
+                        x = 1
+                        for (r = 0; r < h; r++) {
+                                for (c = 0; c < w; c++) {
+                                        x = (x * 16807) % 2147483647
+                                        n = x
+                                        grad[0] = c / w
+                                        grad[1] = r / h
+                                        grad[2] = (c + r) / (w + h)
+                                        for (k = 0; k < 3; k++) {
+                                                v = int(grad[k] * (d - 16))
+                                                v += n % 17
+                                                n = int(n / 17)
+                                                if (d > 255)
+                                                        printf "%s%s",
+                                                            chr[int(v / 256)],
+                                                            chr[v % 256]
+                                                else
+                                                        printf "%s", chr[v]
+                                        }
+                                }
+                        }
+                }' > "$path.tmp" || exit 1
+                mv "$path.tmp" "$path"
+        fi
+        echo "$path"
+}
+
+# make_c40 ppm: compresses the ppm (the first time only) and prints the
+# path of the compressed file
+make_c40()
+{
+        local path="${1%.ppm}.c40"
+        if [ ! -e "$path" ]; then
+                "$IMAGE" -c "$1" > "$path.tmp" || exit 1
+                mv "$path.tmp" "$path"
+        fi
+        echo "$path"
+}
+
+# best_of label command...: runs the command $RUNS times with its output
+# thrown away and reports the fastest wall-clock time. Stops the script if
+# the command fails.
+best_of()
+{
+        local TIMEFORMAT=%R
+        local label="$1" err="$BENCH_DIR/stderr" best="" t run
+        shift
+        for ((run = 0; run < RUNS; run++)); do
+                t=$( { time "$@" > /dev/null 2> "$err"; } 2>&1 ) ||
+                        { cat "$err" >&2; exit 1; }
+                best=$(echo "$t $best" |
+                       awk '{ print ($2 == "" || $1 < $2) ? $1 : $2 }')
+        done
+        printf "  %-44s %ss\n" "$label" "$best"
+}
+
+# peak_rss label command...: runs the command once and reports its peak 
+# resident set size, which needs GNU time
+peak_rss()
+{
+        local label="$1" kb
+        shift
+        if [ ! -x /usr/bin/time ]; then
+                printf "  %-44s %s\n" "$label" "(needs /usr/bin/time)"
+                return
+        fi
+        kb=$(/usr/bin/time -f %M "$@" 2>&1 > /dev/null | tail -n 1)
+        printf "  %-44s %sMB\n" "$label" $((kb / 1024))
+}
+
+# staged: the staged pipeline on a tall image, where walking the arrays a
+# column at a time would stride across the most rows
+staged()
+{
+        local ppm c40
+        ppm=$(make_ppm 512 8192 255)
+        c40=$(make_c40 "$ppm")
+        echo "staged pipeline, 512x8192:"
+        best_of "compress --layout plain" "$IMAGE" -c --layout plain "$ppm"
+        best_of "decompress --layout plain" "$IMAGE" -d --layout plain "$c40"
+}
+
+# layouts: the two staged layouts against each other
+layouts()
+{
+        local ppm c40 layout
+        ppm=$(make_ppm 3001 2003 255)
+        c40=$(make_c40 "$ppm")
+        echo "staged layouts, 3001x2003:"
+        for layout in plain blocked; do
+                best_of "compress --layout $layout" \
+                        "$IMAGE" -c --layout $layout "$ppm"
+                best_of "decompress --layout $layout" \
+                        "$IMAGE" -d --layout $layout "$c40"
+        done
+}
+
+# trim: staged compression of an even image against one a pixel bigger
+# each way, which has to be trimmed first
+trim()
+{
+        local even odd layout
+        even=$(make_ppm 3000 2002 255)
+        odd=$(make_ppm 3001 2003 255)
+        echo "trimming odd images, staged compress:"
+        for layout in plain blocked; do
+                best_of "3000x2002 --layout $layout" \
+                        "$IMAGE" -c --layout $layout "$even"
+                best_of "3001x2003 --layout $layout" \
+                        "$IMAGE" -c --layout $layout "$odd"
+        done
+}
+
+# memory: peak RSS of each pipeline, and the staged decompression time
+# that the smaller codeword arrays help
+memory()
+{
+        local ppm c40 layout
+        ppm=$(make_ppm 3000 2002 255)
+        c40=$(make_c40 "$ppm")
+        echo "memory, 3000x2002:"
+        for layout in plain blocked; do
+                peak_rss "peak RSS compress --layout $layout" \
+                         "$IMAGE" -c --layout $layout "$ppm"
+                peak_rss "peak RSS decompress --layout $layout" \
+                         "$IMAGE" -d --layout $layout "$c40"
+        done
+        peak_rss "peak RSS compress (streaming)" "$IMAGE" -c "$ppm"
+        peak_rss "peak RSS decompress (streaming)" "$IMAGE" -d "$c40"
+        best_of "decompress --layout plain" "$IMAGE" -d --layout plain "$c40"
+}
+
+# tables: rgb to comp video with the lookup tables against the arithmetic,
+# for a batch of one-byte images and for a two-byte image. With AVX2 the
+# arithmetic runs on the vector kernels (see README.md).
+tables()
+{
+        local ppm wide i
+        local list="$BENCH_DIR/batch.list" out="$BENCH_DIR/out"
+        ppm=$(make_ppm 3000 2002 255)
+        wide=$(make_ppm 3000 2000 1000)
+        mkdir -p "$BENCH_DIR/batch" "$out"
+        rm -f "$list"
+        for i in 1 2 3 4 5 6 7 8; do
+                ln -sf "$ppm" "$BENCH_DIR/batch/$i.ppm"
+                echo "$BENCH_DIR/batch/$i.ppm" >> "$list"
+        done
+        echo "lookup tables, compress:"
+        best_of "8 x 3000x2002 --batch -j 1" \
+                "$IMAGE" -c -j 1 --batch "$list" --outdir "$out"
+        best_of "8 x 3000x2002 --batch -j 1 --tables" \
+                "$IMAGE" -c -j 1 --tables --batch "$list" --outdir "$out"
+        best_of "3000x2000, denominator 1000" "$IMAGE" -c "$wide"
+        best_of "3000x2000, denominator 1000 --tables" \
+                "$IMAGE" -c --tables "$wide"
+}
+
+if [ ! -x "$IMAGE" ]; then
+        echo "$0: no $IMAGE to time (make 40image first)" >&2
+        exit 1
+fi
+mkdir -p "$BENCH_DIR"
+for section in ${@:-staged layouts trim memory tables}; do
+        case "$section" in
+        staged|layouts|trim|memory|tables)
+                $section ;;
+        *)
+                echo "$0: unknown section '$section'" >&2
+                exit 1 ;;
+        esac
+done
@@ -16,6 +16,12 @@
 #include "arith40.h"
 #include "except.h"
 
+/* vector kernels are built for x86 and picked at runtime (see below) */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BITPACK_SIMD 1
+#include <immintrin.h>
+#endif
+
 Except_T Bitpack_Overflow = { "Overflow packing bits" };
 
 const unsigned MAX = 64;
@@ -40,14 +46,11 @@ bool Bitpack_fitsu(uint64_t n, unsigned width)
 {
         assert(width <= MAX);
 
-        if (width <= 0) {
+        if (width == 0) {
                 return false;
         }
-        if ((n >> width) > 0) {
-            return false;
-        } else {
-            return true;
-        }
+        /* two shifts, since shifting by all 64 bits at once is undefined */
+        return ((n >> (width - 1)) >> 1) == 0;
 }
 
 /********** Bitpack_fitss ********************************************
@@ -70,18 +73,13 @@ bool Bitpack_fitss(int64_t n, unsigned width)
 {
         assert(width <= MAX);
 
-        if (width <= 0) {
-                return false;
-        }
-
-        int64_t upper = (1 << (width - 1)) - 1;
-        int64_t neg_1 = -1;
-        int64_t lower = (neg_1 << (width - 1));
-
-        if (n > upper || n < lower) {
+        if (width == 0) {
                 return false;
         }
-        return true;
+        /* n fits iff every bit from the sign bit of the field up is a copy 
+         * of it, which leaves either all 0's or all 1's after the shift */
+        int64_t top = n >> (width - 1);
+        return top == 0 || top == -1;
 }
 
 /********** Bitpack_getu ********************************************
@@ -107,18 +105,11 @@ uint64_t Bitpack_getu(uint64_t word, unsigned width, unsigned lsb)
 {
         assert(width <= MAX);
         assert(width + lsb <= MAX);
-        word = (word >> lsb);
 
         if (width == 0) {
                 return 0;
         }
-
-        long long n = 1;
-        for (int i = 0; i < (int)width; i++) {
-            n *= 2;
-        }
-        uint64_t cast = n - 1;
-        return (word & cast);
+        return Bitpack_getu_fast(word, width, lsb);
 } 
 
 /********** Bitpack_gets ********************************************
@@ -146,22 +137,11 @@ int64_t Bitpack_gets(uint64_t word, unsigned width, unsigned lsb)
 {
         assert(width <= MAX);
         assert(width + lsb <= MAX);
-        word = word >> lsb;
+
         if (width == 0) {
                 return 0;
         }
-
-        long long n = 1;
-        for (int i = 0; i < (int)width - 1; i++) {
-                n *= 2;
-        }
-
-        if ((n & word) == 0) {
-                return Bitpack_getu(word, width, 0); /* already shifted */
-        } else {
-                signed new_word = Bitpack_getu(word, width, 0) - (2 * n);
-                return new_word;
-        }
+        return Bitpack_gets_fast(word, width, lsb);
 }
 
 
@@ -184,7 +164,7 @@ int64_t Bitpack_gets(uint64_t word, unsigned width, unsigned lsb)
  * Expects: value is in width, RAISE if not, 0 <= width <= 64, CRE if not, 
  * width + lsb <= 64, CRE if not
  *     
- * Notes: 
+ * Notes: The field is cleared and filled with one mask, no loops
  *      
  *******************************************************************/
 uint64_t Bitpack_newu(uint64_t word, unsigned width, unsigned lsb, 
@@ -193,30 +173,10 @@ uint64_t Bitpack_newu(uint64_t word, unsigned width, unsigned lsb,
         assert(width <= MAX);
         assert(width + lsb <= MAX);
 
-
-        value = Bitpack_getu(value, width, 0);
-
         if (Bitpack_fitsu(value, width) == false) {
                 RAISE(Bitpack_Overflow);
         } 
-
-        /* making the bits to the right of the field be all 1's */
-
-        uint64_t right_mask = 1;
-        right_mask = ((right_mask << lsb) - 1);
-         
-        /* making the bits to the left of the field be all 1's */
-        uint64_t left_mask = 1;
-        left_mask = (((left_mask << (MAX - width - lsb)) - 1) << 
-                        (width + lsb));
-
-        uint64_t mask = right_mask | left_mask;
-        word = word & mask;
-
-        
-        value = (value << lsb);
-        return (value | word);
-
+        return Bitpack_newu_fast(word, width, lsb, value);
 }
 
 
@@ -239,8 +199,8 @@ uint64_t Bitpack_newu(uint64_t word, unsigned width, unsigned lsb,
  * Expects: value is in width, RAISE if not, 0 <= width <= 64, CRE if not, 
  * width + lsb <= 64, CRE if not
  *     
- * Notes: Calls Bitpack_newu to do the conversion after verifying whether value
- *        is positive or negative.
+ * Notes: The two's complement bits of value are cut down to width bits 
+ *        after the check, so negative values need no special case.
  *      
  *******************************************************************/
 
@@ -251,15 +211,318 @@ uint64_t Bitpack_news(uint64_t word, unsigned width, unsigned lsb,
         assert(width <= MAX);
         assert(width + lsb <= MAX);
 
-        if (value > 0) {
-                return Bitpack_newu(word, width, lsb, value);
-        } else {
+        if (Bitpack_fitss(value, width) == false) {
+                RAISE(Bitpack_Overflow);
+        } 
+        return Bitpack_news_fast(word, width, lsb, value);
+}
+
+/********** fits_many ********************************************
+ *
+ * These functions check whether every one of n values fits in width bits, 
+ * the way Bitpack_fitsu and Bitpack_fitss would.
+ *
+ * Parameters:
+ *      const uint64_t *values  the unsigned values (fitsu_many)
+ *      const int64_t *values   the signed values (fitss_many)
+ *      int n                   number of values
+ *      unsigned width          the width they should fit in
+ *
+ * Return: true if all of them fit (or there are none)
+ *
+ * Expects: width is not greater than 64
+ *     
+ * Notes: ORs the values together (a negative value is flipped to its 
+ *        magnitude minus one first) and checks the result once, so the 
+ *        loop has no branches
+ *      
+ *******************************************************************/
+static bool fitsu_many(const uint64_t *values, int n, unsigned width)
+{
+        uint64_t all = 0;
+        for (int i = 0; i < n; i++) {
+                all |= values[i];
+        }
+        return n == 0 || Bitpack_fitsu(all, width);
+}
+
+static bool fitss_many(const int64_t *values, int n, unsigned width)
+{
+        uint64_t all = 0;
+        for (int i = 0; i < n; i++) {
+                all |= (uint64_t)(values[i] ^ (values[i] >> 63));
+        }
+        return n == 0 || Bitpack_fitss(all, width);
+}
+
+/********** many_scalar ********************************************
+ *
+ * One word at a time versions of the Bitpack_*_many functions, used when
+ * there is no vector unit and for the words left over by the vector 
+ * kernels.
+ *
+ * Expects: 0 < width, width + lsb <= 64, the values fit
+ *      
+ *******************************************************************/
+static void getu_many_scalar(const uint64_t *words, int n, unsigned width, 
+                             unsigned lsb, uint64_t *fields)
+{
+        for (int i = 0; i < n; i++) {
+                fields[i] = Bitpack_getu_fast(words[i], width, lsb);
+        }
+}
+
+static void gets_many_scalar(const uint64_t *words, int n, unsigned width, 
+                             unsigned lsb, int64_t *fields)
+{
+        for (int i = 0; i < n; i++) {
+                fields[i] = Bitpack_gets_fast(words[i], width, lsb);
+        }
+}
+
+static void newu_many_scalar(uint64_t *words, int n, unsigned width, 
+                             unsigned lsb, const uint64_t *values)
+{
+        for (int i = 0; i < n; i++) {
+                words[i] = Bitpack_newu_fast(words[i], width, lsb, values[i]);
+        }
+}
+
+#ifdef BITPACK_SIMD
+
+/********** many_avx2 ********************************************
+ *
+ * AVX2 versions of the Bitpack_*_many functions, 4 words at a time.
+ *
+ * Expects: 0 < width, width + lsb <= 64, the values fit
+ *     
+ * Notes: AVX2 has no 64-bit arithmetic shift, so gets sign-extends the 
+ *        field it has shifted down and masked with an xor and a subtract of
+ *        its sign bit. Leftover words go through the scalar versions.
+ *      
+ *******************************************************************/
+__attribute__((target("avx2")))
+static void getu_many_avx2(const uint64_t *words, int n, unsigned width, 
+                           unsigned lsb, uint64_t *fields)
+{
+        __m256i mask = _mm256_set1_epi64x(Bitpack_mask_fast(width, 0));
+        __m128i shift = _mm_cvtsi32_si128(lsb);
+        int i = 0;
+        for (; i + 4 <= n; i += 4) {
+                __m256i w = _mm256_loadu_si256((const __m256i *)(words + i));
+                _mm256_storeu_si256((__m256i *)(fields + i), _mm256_and_si256(
+                                    _mm256_srl_epi64(w, shift), mask));
+        }
+        getu_many_scalar(words + i, n - i, width, lsb, fields + i);
+}
+
+__attribute__((target("avx2")))
+static void gets_many_avx2(const uint64_t *words, int n, unsigned width, 
+                           unsigned lsb, int64_t *fields)
+{
+        __m256i mask = _mm256_set1_epi64x(Bitpack_mask_fast(width, 0));
+        __m256i sign = _mm256_set1_epi64x((uint64_t)1 << (width - 1));
+        __m128i shift = _mm_cvtsi32_si128(lsb);
+        int i = 0;
+        for (; i + 4 <= n; i += 4) {
+                __m256i w = _mm256_loadu_si256((const __m256i *)(words + i));
+                w = _mm256_and_si256(_mm256_srl_epi64(w, shift), mask);
+                w = _mm256_sub_epi64(_mm256_xor_si256(w, sign), sign);
+                _mm256_storeu_si256((__m256i *)(fields + i), w);
+        }
+        gets_many_scalar(words + i, n - i, width, lsb, fields + i);
+}
+
+__attribute__((target("avx2")))
+static void newu_many_avx2(uint64_t *words, int n, unsigned width, 
+                           unsigned lsb, const uint64_t *values)
+{
+        __m256i mask = _mm256_set1_epi64x(Bitpack_mask_fast(width, lsb));
+        __m128i shift = _mm_cvtsi32_si128(lsb);
+        int i = 0;
+        for (; i + 4 <= n; i += 4) {
+                __m256i w = _mm256_loadu_si256((const __m256i *)(words + i));
+                __m256i v = _mm256_loadu_si256((const __m256i *)(values + i));
+                v = _mm256_and_si256(_mm256_sll_epi64(v, shift), mask);
+                _mm256_storeu_si256((__m256i *)(words + i), _mm256_or_si256(
+                                    _mm256_andnot_si256(mask, w), v));
+        }
+        newu_many_scalar(words + i, n - i, width, lsb, values + i);
+}
+
+#endif
+
+/********** Bitpack_getu_many ********************************************
+ *
+ * This function extracts the width-bit unsigned field with least 
+ * significant bit at lsb from each of n words, like n calls to 
+ * Bitpack_getu. It uses AVX2 when the CPU has it.
+ *
+ * Parameters:
+ *      const uint64_t *words   the words
+ *      int n                   number of words
+ *      unsigned width          width of the field
+ *      unsigned lsb            least significant bit of the field
+ *      uint64_t *fields        where to put the n fields
+ *
+ * Return: void
+ *
+ * Expects: words and fields are not NULL when n > 0, n >= 0, width + lsb 
+ *          <= 64, CRE if not
+ *     
+ * Notes: A width of 0 gives all 0's, like Bitpack_getu
+ *      
+ *******************************************************************/
+void Bitpack_getu_many(const uint64_t *words, int n, unsigned width, 
+                       unsigned lsb, uint64_t *fields)
+{
+        assert(n >= 0);
+        assert(n == 0 || (words != NULL && fields != NULL));
+        assert(width + lsb <= MAX);
+
+        if (width == 0) {
+                for (int i = 0; i < n; i++) {
+                        fields[i] = 0;
+                }
+                return;
+        }
+#ifdef BITPACK_SIMD
+        if (__builtin_cpu_supports("avx2")) {
+                getu_many_avx2(words, n, width, lsb, fields);
+                return;
+        }
+#endif
+        getu_many_scalar(words, n, width, lsb, fields);
+}
+
+/********** Bitpack_gets_many ********************************************
+ *
+ * This function extracts the width-bit signed field with least 
+ * significant bit at lsb from each of n words, like n calls to 
+ * Bitpack_gets. It uses AVX2 when the CPU has it.
+ *
+ * Parameters:
+ *      const uint64_t *words   the words
+ *      int n                   number of words
+ *      unsigned width          width of the field
+ *      unsigned lsb            least significant bit of the field
+ *      int64_t *fields         where to put the n fields
+ *
+ * Return: void
+ *
+ * Expects: words and fields are not NULL when n > 0, n >= 0, width + lsb 
+ *          <= 64, CRE if not
+ *     
+ * Notes: A width of 0 gives all 0's, like Bitpack_gets
+ *      
+ *******************************************************************/
+void Bitpack_gets_many(const uint64_t *words, int n, unsigned width, 
+                       unsigned lsb, int64_t *fields)
+{
+        assert(n >= 0);
+        assert(n == 0 || (words != NULL && fields != NULL));
+        assert(width + lsb <= MAX);
+
+        if (width == 0) {
+                for (int i = 0; i < n; i++) {
+                        fields[i] = 0;
+                }
+                return;
+        }
+#ifdef BITPACK_SIMD
+        if (__builtin_cpu_supports("avx2")) {
+                gets_many_avx2(words, n, width, lsb, fields);
+                return;
+        }
+#endif
+        gets_many_scalar(words, n, width, lsb, fields);
+}
+
+/********** Bitpack_newu_many ********************************************
+ *
+ * This function replaces the width-bit field with least significant bit at
+ * lsb in each of n words with the matching unsigned value, like n calls to
+ * Bitpack_newu. It uses AVX2 when the CPU has it.
+ *
+ * Parameters:
+ *      uint64_t *words         the words, updated in place
+ *      int n                   number of words
+ *      unsigned width          width of the field
+ *      unsigned lsb            least significant bit of the field
+ *      const uint64_t *values  the n new values
+ *
+ * Return: void
+ *
+ * Expects: every value fits in width bits, RAISE if not, words and values
+ *          are not NULL when n > 0, n >= 0, width + lsb <= 64, CRE if not
+ *     
+ * Notes: All of the values are checked before any word is changed, so 
+ *        words is untouched if Bitpack_Overflow is raised
+ *      
+ *******************************************************************/
+void Bitpack_newu_many(uint64_t *words, int n, unsigned width, unsigned lsb, 
+                       const uint64_t *values)
+{
+        assert(n >= 0);
+        assert(n == 0 || (words != NULL && values != NULL));
+        assert(width + lsb <= MAX);
 
-                if (Bitpack_fitss(value, width) == false) {
-                        RAISE(Bitpack_Overflow);
-                } 
-                uint64_t u_value = 0;
-                u_value = value + (1 << width);
-                return Bitpack_newu(word, width, lsb, u_value);
+        if (fitsu_many(values, n, width) == false) {
+                RAISE(Bitpack_Overflow);
+        }
+        if (n == 0) {
+                return;
+        }
+#ifdef BITPACK_SIMD
+        if (__builtin_cpu_supports("avx2")) {
+                newu_many_avx2(words, n, width, lsb, values);
+                return;
+        }
+#endif
+        newu_many_scalar(words, n, width, lsb, values);
+}
+
+/********** Bitpack_news_many ********************************************
+ *
+ * This function replaces the width-bit field with least significant bit at
+ * lsb in each of n words with the matching signed value, like n calls to
+ * Bitpack_news. It uses AVX2 when the CPU has it.
+ *
+ * Parameters:
+ *      uint64_t *words         the words, updated in place
+ *      int n                   number of words
+ *      unsigned width          width of the field
+ *      unsigned lsb            least significant bit of the field
+ *      const int64_t *values   the n new values
+ *
+ * Return: void
+ *
+ * Expects: every value fits in width bits, RAISE if not, words and values
+ *          are not NULL when n > 0, n >= 0, width + lsb <= 64, CRE if not
+ *     
+ * Notes: Once the values are known to fit, their two's complement bits are
+ *        packed the same way unsigned values are
+ *      
+ *******************************************************************/
+void Bitpack_news_many(uint64_t *words, int n, unsigned width, unsigned lsb, 
+                       const int64_t *values)
+{
+        assert(n >= 0);
+        assert(n == 0 || (words != NULL && values != NULL));
+        assert(width + lsb <= MAX);
+
+        if (fitss_many(values, n, width) == false) {
+                RAISE(Bitpack_Overflow);
+        }
+        if (n == 0) {
+                return;
+        }
+        const uint64_t *bits = (const uint64_t *)values;
+#ifdef BITPACK_SIMD
+        if (__builtin_cpu_supports("avx2")) {
+                newu_many_avx2(words, n, width, lsb, bits);
+                return;
         }
+#endif
+        newu_many_scalar(words, n, width, lsb, bits);
 }
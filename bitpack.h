@@ -8,6 +8,14 @@
  *
  *     Interface of bitpack, which packs bits into uint64_t's. 
  *
+ *     The Bitpack_* functions check their arguments and raise 
+ *     Bitpack_Overflow when a value does not fit its field. The 
+ *     Bitpack_*_fast functions below are the same field operations with no 
+ *     checks at all: they are defined here so the compiler can inline them 
+ *     into hot loops, where a constant width and lsb fold them down to a 
+ *     shift and a mask. Use them only where the caller already knows the 
+ *     field and the value are in range.
+ *
  *************************************************************************/
 
 #ifndef BITPACK_INCLUDED
@@ -16,6 +24,10 @@
 #include <stdint.h>
 #include "except.h"
 
+#if defined(__BMI__) || defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
 bool Bitpack_fitsu(uint64_t n, unsigned width);
 bool Bitpack_fitss( int64_t n, unsigned width);
 uint64_t Bitpack_getu(uint64_t word, unsigned width, unsigned lsb);
@@ -24,4 +36,67 @@ uint64_t Bitpack_newu(uint64_t word, unsigned width, unsigned lsb, uint64_t valu
 uint64_t Bitpack_news(uint64_t word, unsigned width, unsigned lsb,  int64_t value);
 extern Except_T Bitpack_Overflow;
 
-#endif
\ No newline at end of file
+/* the same field of n words at once */
+void Bitpack_getu_many(const uint64_t *words, int n, unsigned width, 
+                       unsigned lsb, uint64_t *fields);
+void Bitpack_gets_many(const uint64_t *words, int n, unsigned width, 
+                       unsigned lsb, int64_t *fields);
+void Bitpack_newu_many(uint64_t *words, int n, unsigned width, unsigned lsb, 
+                       const uint64_t *values);
+void Bitpack_news_many(uint64_t *words, int n, unsigned width, unsigned lsb, 
+                       const int64_t *values);
+
+/********** Bitpack_*_fast **************************************************
+ *
+ * Unchecked versions of Bitpack_getu, Bitpack_gets, Bitpack_newu, and 
+ * Bitpack_news. None of them branch or loop.
+ *
+ * Expects: 0 < width <= 64 and width + lsb <= 64; for the new* functions, 
+ *          value fits in width bits. Nothing is asserted and 
+ *          Bitpack_Overflow is never raised: a value that does not fit is 
+ *          cut down to its low width bits.
+ *
+ * Notes: Bitpack_gets_fast shifts the field up to the top of the word and 
+ *        arithmetic-shifts it back down, which sign-extends it. When built 
+ *        with -mbmi or -mbmi2, getu becomes a bextr and newu a pdep.
+ *      
+ *************************************************************************/
+static inline uint64_t Bitpack_mask_fast(unsigned width, unsigned lsb)
+{
+        return (~(uint64_t)0 >> (64 - width)) << lsb;
+}
+
+static inline uint64_t Bitpack_getu_fast(uint64_t word, unsigned width, 
+                                         unsigned lsb)
+{
+#if defined(__BMI__) && defined(__x86_64__)
+        return _bextr_u64(word, lsb, width);
+#else
+        return (word >> lsb) & (~(uint64_t)0 >> (64 - width));
+#endif
+}
+
+static inline int64_t Bitpack_gets_fast(uint64_t word, unsigned width, 
+                                        unsigned lsb)
+{
+        return (int64_t)(word << (64 - width - lsb)) >> (64 - width);
+}
+
+static inline uint64_t Bitpack_newu_fast(uint64_t word, unsigned width, 
+                                         unsigned lsb, uint64_t value)
+{
+        uint64_t mask = Bitpack_mask_fast(width, lsb);
+#if defined(__BMI2__) && defined(__x86_64__)
+        return (word & ~mask) | _pdep_u64(value, mask);
+#else
+        return (word & ~mask) | ((value << lsb) & mask);
+#endif
+}
+
+static inline uint64_t Bitpack_news_fast(uint64_t word, unsigned width, 
+                                         unsigned lsb, int64_t value)
+{
+        return Bitpack_newu_fast(word, width, lsb, (uint64_t)value);
+}
+
+#endif
@@ -0,0 +1,463 @@
+/*************************************************************************
+ *
+ *                     blocktable.c
+ *
+ *     Assignment: arith
+ *     Author:   Eva Caro
+ *     Date:     3/6/24
+ *
+ *     Implementation of block_table. Decompressing a block is affine in 
+ *     the codeword's fields: each of the four Y's is a plus or minus b, c,
+ *     and d, and each rgb value is a Y plus an offset that only depends on
+ *     pB and pR. So the tables hold the value of every a, of every b, c, 
+ *     and d (which are quantized alike), and the red, green, and blue 
+ *     offsets of each of the 256 pB and pR pairs, already scaled to the 
+ *     denominator, as ints in units of 2 ^ -BLOCK_BITS. Decoding a block is
+ *     then five lookups, adds, and a clamp and shift for each of its twelve 
+ *     values. The fields of the raw codeword index the tables directly; the
+ *     entries for b, c, and d are already sign-extended.
+ *
+ *************************************************************************/
+
+#include <math.h>
+#include "blocktable.h"
+#include "codewords.h"
+#include "chroma.h"
+#include "assert.h"
+#include "mem.h"
+
+/* vector kernels are built for x86 and picked at runtime (see below) */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BLOCK_SIMD 1
+#include <immintrin.h>
+#include "rgb8simd.h"
+#endif
+
+#define BLOCK_BITS 16
+
+/* 
+ * a sum is at most 1 + 3 * 16/50 + 1.772 * 0.5 < 2.9 and at least 
+ * -3 * 16/50 - 1.772 * 0.5 > -1.9 times the denominator, so after the 
+ * shift it indexes the clamp table with this bias
+ */
+#define CLAMP_BIAS 512
+#define CLAMP_SIZE 1280
+
+/* the quantization scales of a and of b, c, and d, as in float.c */
+const int BLOCK_SFA = 511;
+const int BLOCK_SFBCD = 50;
+
+/* the pB and pR fields side by side, as the chroma tables are indexed */
+#define CHROMA_WIDTH (CODEWORD_pB_WIDTH + CODEWORD_pR_WIDTH)
+
+struct block_table {
+        unsigned denom;
+        int32_t a[1 << CODEWORD_a_WIDTH];
+        /* b, c, and d are all quantized the same way */
+        int32_t bcd[1 << CODEWORD_b_WIDTH];
+        /* what each pB and pR pair adds to red, green, and blue */
+        int32_t red[1 << CHROMA_WIDTH];
+        int32_t green[1 << CHROMA_WIDTH];
+        int32_t blue[1 << CHROMA_WIDTH];
+        /* clamp[x + CLAMP_BIAS] is x clamped to [0, denom] */
+        unsigned char clamp[CLAMP_SIZE];
+};
+
+/********** to_table_units ************************************************
+ *
+ * This function turns a value out of 1 into the tables' units.
+ *
+ * Parameters:
+ *      double x                the value
+ *      double scale            the denominator times 2 ^ BLOCK_BITS
+ *
+ * Return: the nearest unit
+ *
+ * Expects: N/A
+ *     
+ *************************************************************************/
+static inline int32_t to_table_units(double x, double scale)
+{
+        return (int32_t)lround(x * scale);
+}
+
+/********** block_table_new ***********************************************
+ *
+ * This function builds the tables for decoding to rgb values out of denom.
+ *
+ * Parameters:
+ *      unsigned denom          the denominator of the decoded image
+ *
+ * Return: the new tables
+ *
+ * Expects: denom is between 1 and 255
+ *     
+ * Notes: a, b, c, and d are unscaled to floats the way block_inverse_DCT 
+ *        does it, and the chroma offsets use comp_to_rgb's coefficients on
+ *        chroma_level. The bcd entry for bits i is for i read as a signed 
+ *        (two's complement) number. Must be freed with block_table_free. 
+ *        Decompression
+ *      
+ *************************************************************************/
+block_table block_table_new(unsigned denom)
+{
+        assert(denom >= 1 && denom <= 255);
+        block_table table;
+        NEW(table);
+        table->denom = denom;
+        double scale = (double)denom * (1 << BLOCK_BITS);
+
+        for (unsigned a = 0; a < (1u << CODEWORD_a_WIDTH); a++) {
+                float value = (float)((double)a / (double)BLOCK_SFA);
+                table->a[a] = to_table_units(value, scale);
+        }
+        unsigned width = CODEWORD_b_WIDTH;
+        for (unsigned bits = 0; bits < (1u << width); bits++) {
+                int field = (bits >= (1u << (width - 1))) 
+                            ? (int)bits - (1 << width) : (int)bits;
+                float value = (float)((double)field / (double)BLOCK_SFBCD);
+                table->bcd[bits] = to_table_units(value, scale);
+        }
+        for (unsigned pB = 0; pB < (1u << CODEWORD_pB_WIDTH); pB++) {
+                for (unsigned pR = 0; pR < (1u << CODEWORD_pR_WIDTH); pR++) {
+                        double b = chroma_level(pB);
+                        double r = chroma_level(pR);
+                        unsigned i = pB << CODEWORD_pR_WIDTH | pR;
+                        table->red[i] = to_table_units(1.402 * r, scale);
+                        table->green[i] = to_table_units(-0.344136 * b - 
+                                                         0.714136 * r, scale);
+                        table->blue[i] = to_table_units(1.772 * b, scale);
+                }
+        }
+        int max = denom;
+        for (int x = -CLAMP_BIAS; x < CLAMP_SIZE - CLAMP_BIAS; x++) {
+                table->clamp[x + CLAMP_BIAS] = x < 0 ? 0 : x > max ? max : x;
+        }
+        return table;
+}
+
+/********** block_table_free **********************************************
+ *
+ * This function frees tables made by block_table_new.
+ *
+ * Parameters:
+ *      block_table *table      pointer to the tables to free
+ *
+ * Return: N/A
+ *
+ * Expects: table and *table are not NULL
+ *     
+ * Notes: sets *table to NULL
+ *      
+ *************************************************************************/
+void block_table_free(block_table *table)
+{
+        assert(table != NULL && *table != NULL);
+        FREE(*table);
+}
+
+/********** block_table_denom *********************************************
+ *
+ * This function returns the denominator tables were built for.
+ *
+ * Parameters:
+ *      block_table table       the tables
+ *
+ * Return: the denominator
+ *
+ * Expects: table is not NULL
+ *     
+ *************************************************************************/
+unsigned block_table_denom(block_table table)
+{
+        assert(table != NULL);
+        return table->denom;
+}
+
+/********** field *********************************************************
+ *
+ * This function reads an unsigned field of a codeword.
+ *
+ * Parameters:
+ *      uint32_t codeword       the codeword
+ *      unsigned lsb            the field's least significant bit
+ *      unsigned width          the field's width in bits
+ *
+ * Return: the field's bits
+ *
+ * Expects: lsb + width is at most 32
+ *     
+ *************************************************************************/
+static inline unsigned field(uint32_t codeword, unsigned lsb, unsigned width)
+{
+        return (codeword >> lsb) & ((1u << width) - 1);
+}
+
+/********** put_pixel *****************************************************
+ *
+ * This function finishes one pixel of a block.
+ *
+ * Parameters:
+ *      const unsigned char *clamp      the table's clamp table
+ *      int32_t y                       the pixel's Y, in table units
+ *      const int32_t offsets[3]        its red, green, and blue offsets
+ *      unsigned char *rgb              where to put the pixel
+ *
+ * Return: N/A
+ *
+ * Expects: N/A
+ *     
+ * Notes: rounds down, like storing comp_to_rgb's floats does (>> on a 
+ *        negative int is an arithmetic shift with gcc)
+ *      
+ *************************************************************************/
+static inline void put_pixel(const unsigned char *clamp, int32_t y, 
+                             const int32_t offsets[3], unsigned char *rgb)
+{
+        for (int k = 0; k < 3; k++) {
+                rgb[k] = clamp[((y + offsets[k]) >> BLOCK_BITS) + CLAMP_BIAS];
+        }
+}
+
+/********** block_table_row_scalar ****************************************
+ *
+ * This function decodes a row of codewords one block at a time.
+ *
+ * Parameters: see block_table_row
+ *
+ * Return: N/A
+ *
+ * Expects: see block_table_row
+ *     
+ * Notes: the fallback when the CPU has no AVX2, and used for the blocks 
+ *        left over by the vector loop. Decompression
+ *      
+ *************************************************************************/
+static void block_table_row_scalar(block_table table, 
+                                   const uint32_t *codewords, int n, 
+                                   unsigned char *top, unsigned char *bottom)
+{
+        const unsigned char *clamp = table->clamp;
+        for (int i = 0; i < n; i++) {
+                uint32_t word = codewords[i];
+                int32_t a = table->a[field(word, CODEWORD_a_LSB, 
+                                           CODEWORD_a_WIDTH)];
+                int32_t b = table->bcd[field(word, CODEWORD_b_LSB, 
+                                             CODEWORD_b_WIDTH)];
+                int32_t c = table->bcd[field(word, CODEWORD_c_LSB, 
+                                             CODEWORD_c_WIDTH)];
+                int32_t d = table->bcd[field(word, CODEWORD_d_LSB, 
+                                             CODEWORD_d_WIDTH)];
+                unsigned chroma = field(word, CODEWORD_pB_LSB, 
+                                        CODEWORD_pB_WIDTH) 
+                                  << CODEWORD_pR_WIDTH | 
+                                  field(word, CODEWORD_pR_LSB, 
+                                        CODEWORD_pR_WIDTH);
+                int32_t offsets[3] = { table->red[chroma], 
+                                       table->green[chroma], 
+                                       table->blue[chroma] };
+
+                put_pixel(clamp, a - b - c + d, offsets, top + 6 * i);
+                put_pixel(clamp, a - b + c - d, offsets, top + 6 * i + 3);
+                put_pixel(clamp, a + b - c - d, offsets, bottom + 6 * i);
+                put_pixel(clamp, a + b + c + d, offsets, bottom + 6 * i + 3);
+        }
+}
+
+#ifdef BLOCK_SIMD
+
+/********** field_avx2 ****************************************************
+ *
+ * This function reads an unsigned field of 8 codewords.
+ *
+ * Parameters:
+ *      __m256i words           the codewords
+ *      int lsb                 the field's least significant bit
+ *      int width               the field's width in bits
+ *
+ * Return: the 8 fields' bits
+ *
+ * Expects: N/A
+ *     
+ *************************************************************************/
+__attribute__((target("avx2")))
+static inline __m256i field_avx2(__m256i words, int lsb, int width)
+{
+        return _mm256_and_si256(_mm256_srli_epi32(words, lsb), 
+                                _mm256_set1_epi32((1 << width) - 1));
+}
+
+/********** samples_avx2 **************************************************
+ *
+ * This function finishes one channel of 16 pixels in a row: 8 blocks' 
+ * left pixels and their right ones.
+ *
+ * Parameters:
+ *      __m256i left            the left pixels' Y's, in table units
+ *      __m256i right           the right pixels' Y's
+ *      __m256i offset          the channel's offset for each block
+ *      __m256i denom           the denominator in every lane
+ *
+ * Return: the 16 values, in order across the row, in the low 16 bytes
+ *
+ * Expects: N/A
+ *     
+ * Notes: unpacking and packing within each 128-bit lane puts blocks 0-3 
+ *        and 4-7 in the two halves, each left pixel before its right one; 
+ *        the permute joins the halves. Same results as put_pixel. 
+ *        Decompression
+ *      
+ *************************************************************************/
+__attribute__((target("avx2")))
+static inline __m128i samples_avx2(__m256i left, __m256i right, 
+                                   __m256i offset, __m256i denom)
+{
+        left = _mm256_srai_epi32(_mm256_add_epi32(left, offset), BLOCK_BITS);
+        right = _mm256_srai_epi32(_mm256_add_epi32(right, offset), 
+                                  BLOCK_BITS);
+        __m256i lo = _mm256_unpacklo_epi32(left, right);
+        __m256i hi = _mm256_unpackhi_epi32(left, right);
+        __m256i x = _mm256_packs_epi32(lo, hi);
+        x = _mm256_min_epi16(_mm256_max_epi16(x, _mm256_setzero_si256()), 
+                             denom);
+        x = _mm256_packus_epi16(x, x);
+        return _mm256_castsi256_si128(_mm256_permute4x64_epi64(x, 0x08));
+}
+
+/********** store_row_avx2 ************************************************
+ *
+ * This function finishes and stores 16 pixels of a row: the left and 
+ * right pixels of 8 blocks.
+ *
+ * Parameters:
+ *      unsigned char *rgb              where to put the pixels, 48 bytes
+ *      __m256i left, right             the left and right pixels' Y's
+ *      __m256i red, green, blue        the blocks' offsets
+ *      __m256i denom                   the denominator in every lane
+ *
+ * Return: N/A
+ *
+ * Expects: rgb is not NULL
+ *     
+ * Notes: Decompression
+ *      
+ *************************************************************************/
+__attribute__((target("avx2")))
+static inline void store_row_avx2(unsigned char *rgb, __m256i left, 
+                                  __m256i right, __m256i red, __m256i green,
+                                  __m256i blue, __m256i denom)
+{
+        __m128i r = samples_avx2(left, right, red, denom);
+        __m128i g = samples_avx2(left, right, green, denom);
+        __m128i b = samples_avx2(left, right, blue, denom);
+        store_rgb8(rgb, r, g, b);
+        store_rgb8(rgb + 24, _mm_srli_si128(r, 8), _mm_srli_si128(g, 8), 
+                   _mm_srli_si128(b, 8));
+}
+
+/********** block_table_row_avx2 ******************************************
+ *
+ * This function decodes a row of codewords 8 blocks at a time, gathering 
+ * each table's entries for the 8 codewords at once.
+ *
+ * Parameters: see block_table_row
+ *
+ * Return: N/A
+ *
+ * Expects: see block_table_row
+ *     
+ * Notes: clamps with min and max instead of the clamp table, which gives 
+ *        the same values. Same results as block_table_row_scalar. 
+ *        Decompression
+ *      
+ *************************************************************************/
+__attribute__((target("avx2")))
+static void block_table_row_avx2(block_table table, const uint32_t *codewords,
+                                 int n, unsigned char *top, 
+                                 unsigned char *bottom)
+{
+        const __m256i denom = _mm256_set1_epi16(table->denom);
+        int i = 0;
+        for (; i + 8 <= n; i += 8) {
+                __m256i words = _mm256_loadu_si256((const __m256i *)
+                                                   (codewords + i));
+                __m256i a = _mm256_i32gather_epi32(table->a, 
+                            field_avx2(words, CODEWORD_a_LSB, 
+                                       CODEWORD_a_WIDTH), 4);
+                __m256i b = _mm256_i32gather_epi32(table->bcd, 
+                            field_avx2(words, CODEWORD_b_LSB, 
+                                       CODEWORD_b_WIDTH), 4);
+                __m256i c = _mm256_i32gather_epi32(table->bcd, 
+                            field_avx2(words, CODEWORD_c_LSB, 
+                                       CODEWORD_c_WIDTH), 4);
+                __m256i d = _mm256_i32gather_epi32(table->bcd, 
+                            field_avx2(words, CODEWORD_d_LSB, 
+                                       CODEWORD_d_WIDTH), 4);
+                __m256i chroma = _mm256_or_si256(_mm256_slli_epi32(
+                                 field_avx2(words, CODEWORD_pB_LSB, 
+                                            CODEWORD_pB_WIDTH), 
+                                 CODEWORD_pR_WIDTH),
+                                 field_avx2(words, CODEWORD_pR_LSB, 
+                                            CODEWORD_pR_WIDTH));
+                __m256i red = _mm256_i32gather_epi32(table->red, chroma, 4);
+                __m256i green = _mm256_i32gather_epi32(table->green, chroma,
+                                                       4);
+                __m256i blue = _mm256_i32gather_epi32(table->blue, chroma, 4);
+
+                __m256i a_minus_b = _mm256_sub_epi32(a, b);
+                __m256i a_plus_b = _mm256_add_epi32(a, b);
+                __m256i c_minus_d = _mm256_sub_epi32(c, d);
+                __m256i c_plus_d = _mm256_add_epi32(c, d);
+                store_row_avx2(top + 6 * i, 
+                               _mm256_sub_epi32(a_minus_b, c_minus_d),
+                               _mm256_add_epi32(a_minus_b, c_minus_d), 
+                               red, green, blue, denom);
+                store_row_avx2(bottom + 6 * i, 
+                               _mm256_sub_epi32(a_plus_b, c_plus_d),
+                               _mm256_add_epi32(a_plus_b, c_plus_d), 
+                               red, green, blue, denom);
+        }
+        block_table_row_scalar(table, codewords + i, n - i, top + 6 * i, 
+                               bottom + 6 * i);
+}
+
+#endif
+
+/********** block_table_row ***********************************************
+ *
+ * This function decodes a row of codewords into two rows of pixels. It 
+ * uses AVX2 when the CPU has it, falling back to one block at a time.
+ *
+ * Parameters:
+ *      block_table table               tables for the output denominator
+ *      const uint32_t *codewords       the codewords, one per block
+ *      int n                           number of codewords
+ *      unsigned char *top              where to put the blocks' upper 
+ *                                      pixels, 3 bytes each
+ *      unsigned char *bottom           where to put their lower pixels
+ *
+ * Return: N/A
+ *
+ * Expects: table, codewords, top, and bottom are not NULL, and top and 
+ *          bottom hold 2n pixels
+ *     
+ * Notes: takes the place of unpack_codeword, block_inverse_DCT, and 
+ *        comp_to_rgb. The tables round each term to the nearest unit, so a
+ *        value just over a whole number can come out 1 lower than 
+ *        comp_to_rgb's (and the other way). Both versions give the same 
+ *        bytes. Decompression
+ *      
+ *************************************************************************/
+void block_table_row(block_table table, const uint32_t *codewords, int n,
+                     unsigned char *top, unsigned char *bottom)
+{
+        assert(table != NULL && codewords != NULL);
+        assert(top != NULL && bottom != NULL);
+#ifdef BLOCK_SIMD
+        if (__builtin_cpu_supports("avx2")) {
+                block_table_row_avx2(table, codewords, n, top, bottom);
+                return;
+        }
+#endif
+        block_table_row_scalar(table, codewords, n, top, bottom);
+}
@@ -0,0 +1,34 @@
+/*************************************************************************
+ *
+ *                     blocktable.h
+ *
+ *     Assignment: arith
+ *     Author:   Eva Caro
+ *     Date:     3/6/24
+ *
+ *     Interface of block_table, a table-driven decoder that turns each 
+ *     codeword straight into the rgb values of its 2-by-2 block, without 
+ *     going through scaled DCT values or comp video.
+ *
+ *************************************************************************/
+
+#ifndef BLOCKTABLE_INCLUDED
+#define BLOCKTABLE_INCLUDED
+#include <stdint.h>
+
+typedef struct block_table *block_table;
+
+/* tables for rgb values out of denom, which is at most 255 */
+block_table block_table_new(unsigned denom);
+void block_table_free(block_table *table);
+unsigned block_table_denom(block_table table);
+
+/* 
+ * decodes n codewords into 2n pixels of each of two rows of interleaved 
+ * 8-bit rgb; each value is within 1 of what unpack_codeword, 
+ * block_inverse_DCT, and comp_to_rgb give
+ */
+void block_table_row(block_table table, const uint32_t *codewords, int n,
+                     unsigned char *top, unsigned char *bottom);
+
+#endif
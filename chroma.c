@@ -0,0 +1,369 @@
+/*************************************************************************
+ *
+ *                     chroma.c
+ *
+ *     Assignment: arith
+ *     Author:   Eva Caro
+ *     Date:     3/6/24
+ *
+ *     Implementation of chroma. Quantizing a chroma value means finding 
+ *     the nearest of the 16 levels, which is the same as counting how many
+ *     of the 15 thresholds between neighbouring levels it is at or above. 
+ *     The thresholds are found once by bisecting Arith40_index_of_chroma 
+ *     over the floats in [-1, 1] (every pB and pR is within [-0.5, 0.5]), 
+ *     so chroma_index agrees with the library on every float in that range.
+ *     The fixed-point thresholds are the same ones rounded up to the next 
+ *     unit, so chroma_index_fixed agrees with chroma_index exactly.
+ *
+ *************************************************************************/
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include "chroma.h"
+#include "arith40.h"
+#include "assert.h"
+
+/* vector kernels are built for x86 and picked at runtime (see below) */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CHROMA_SIMD 1
+#include <immintrin.h>
+#endif
+
+const float CHROMA_RANGE = 1.0;
+
+/* levels[i] is the chroma value of index i, and thresholds[i] is the 
+   smallest float whose index is more than i */
+static float levels[CHROMA_LEVELS];
+static float thresholds[CHROMA_LEVELS - 1];
+/* the same in units of 1 / CHROMA_FIXED_ONE */
+static int fixed_levels[CHROMA_LEVELS];
+static int fixed_thresholds[CHROMA_LEVELS - 1];
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+static void build_tables(void);
+
+/********** float_key *****************************************************
+ *
+ * This function maps a float to an unsigned key such that the keys are in
+ * the same order as the floats.
+ *
+ * Parameters:
+ *      float x                 the float, not NaN
+ *
+ * Return: the key
+ *
+ * Expects: N/A
+ *     
+ * Notes: lets build_tables bisect over every float between two others
+ *      
+ ***********************************************************************/
+static uint32_t float_key(float x)
+{
+        uint32_t bits;
+        memcpy(&bits, &x, sizeof(bits));
+        return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+}
+
+/********** key_float *****************************************************
+ *
+ * This function undoes float_key.
+ *
+ * Parameters:
+ *      uint32_t key            the key
+ *
+ * Return: the float with that key
+ *
+ * Expects: N/A
+ *     
+ * Notes: 
+ *      
+ ***********************************************************************/
+static float key_float(uint32_t key)
+{
+        uint32_t bits = (key & 0x80000000u) ? (key & 0x7fffffffu) : ~key;
+        float x;
+        memcpy(&x, &bits, sizeof(x));
+        return x;
+}
+
+/********** build_tables **************************************************
+ *
+ * This function fills in levels and thresholds from the arith40 library. 
+ * Each threshold is found by bisecting over the floats in [-1, 1] for the 
+ * first one the library gives a higher index.
+ *
+ * Parameters: N/A
+ *
+ * Return: N/A
+ *
+ * Expects: Arith40_index_of_chroma never goes down as chroma goes up, and
+ *          gives the first and last index at -1 and 1
+ *     
+ * Notes: runs once, through pthread_once, so threads can share the tables.
+ *        Takes about 32 library calls per threshold.
+ *      
+ ***********************************************************************/
+static void build_tables(void)
+{
+        for (unsigned i = 0; i < CHROMA_LEVELS; i++) {
+                levels[i] = Arith40_chroma_of_index(i);
+        }
+        assert(Arith40_index_of_chroma(-CHROMA_RANGE) == 0);
+        assert(Arith40_index_of_chroma(CHROMA_RANGE) == CHROMA_LEVELS - 1);
+
+        for (unsigned i = 1; i < CHROMA_LEVELS; i++) {
+                /* the library gives less than i at lo and at least i at hi */
+                uint32_t lo = float_key(-CHROMA_RANGE);
+                uint32_t hi = float_key(CHROMA_RANGE);
+                while (hi - lo > 1) {
+                        uint32_t mid = lo + (hi - lo) / 2;
+                        if (Arith40_index_of_chroma(key_float(mid)) >= i) {
+                                hi = mid;
+                        } else {
+                                lo = mid;
+                        }
+                }
+                thresholds[i - 1] = key_float(hi);
+        }
+
+        /* both products are exact, since CHROMA_FIXED_ONE is a power of 2 */
+        for (unsigned i = 0; i < CHROMA_LEVELS; i++) {
+                fixed_levels[i] = lroundf(levels[i] * CHROMA_FIXED_ONE);
+        }
+        for (unsigned i = 0; i < CHROMA_LEVELS - 1; i++) {
+                fixed_thresholds[i] = ceilf(thresholds[i] * CHROMA_FIXED_ONE);
+        }
+}
+
+/********** chroma_index **************************************************
+ *
+ * This function quantizes a chroma value (a pB or pR) to the index of the 
+ * nearest chroma level, like Arith40_index_of_chroma.
+ *
+ * Parameters:
+ *      float chroma            the chroma value
+ *
+ * Return: the index, from 0 to CHROMA_LEVELS - 1
+ *
+ * Expects: chroma is in [-1, 1]
+ *     
+ * Notes: a branch-free binary search over the thresholds. Compression
+ *      
+ ***********************************************************************/
+unsigned chroma_index(float chroma)
+{
+        pthread_once(&tables_once, build_tables);
+        unsigned index = 0;
+        for (unsigned step = CHROMA_LEVELS / 2; step > 0; step /= 2) {
+                index += (chroma >= thresholds[index + step - 1]) ? step : 0;
+        }
+        return index;
+}
+
+#ifdef CHROMA_SIMD
+
+/********** chroma_index_many_avx2 ****************************************
+ *
+ * AVX2 version of chroma_index_many, 8 values at a time.
+ *
+ * Parameters: see chroma_index_many
+ *
+ * Return: N/A
+ *
+ * Expects: see chroma_index_many
+ *     
+ * Notes: counts the thresholds each value is at or above. Each compare 
+ *        gives -1 where it holds, so subtracting the compares counts up. 
+ *        Leftover values go through chroma_index.
+ *      
+ ***********************************************************************/
+__attribute__((target("avx2")))
+static void chroma_index_many_avx2(const float *chroma, int n, 
+                                   unsigned *indices)
+{
+        int i = 0;
+        for (; i + 8 <= n; i += 8) {
+                __m256 x = _mm256_loadu_ps(chroma + i);
+                __m256i count = _mm256_setzero_si256();
+                for (int t = 0; t < CHROMA_LEVELS - 1; t++) {
+                        __m256 ge = _mm256_cmp_ps(x, 
+                                        _mm256_set1_ps(thresholds[t]), 
+                                        _CMP_GE_OQ);
+                        count = _mm256_sub_epi32(count, 
+                                                 _mm256_castps_si256(ge));
+                }
+                _mm256_storeu_si256((__m256i *)(indices + i), count);
+        }
+        for (; i < n; i++) {
+                indices[i] = chroma_index(chroma[i]);
+        }
+}
+
+/********** chroma_index_many_sse *****************************************
+ *
+ * SSE4.1 version of chroma_index_many, 4 values at a time.
+ *
+ * Parameters: see chroma_index_many
+ *
+ * Return: N/A
+ *
+ * Expects: see chroma_index_many
+ *     
+ * Notes: see chroma_index_many_avx2
+ *      
+ ***********************************************************************/
+__attribute__((target("sse4.1")))
+static void chroma_index_many_sse(const float *chroma, int n, 
+                                  unsigned *indices)
+{
+        int i = 0;
+        for (; i + 4 <= n; i += 4) {
+                __m128 x = _mm_loadu_ps(chroma + i);
+                __m128i count = _mm_setzero_si128();
+                for (int t = 0; t < CHROMA_LEVELS - 1; t++) {
+                        __m128 ge = _mm_cmpge_ps(x, 
+                                                 _mm_set1_ps(thresholds[t]));
+                        count = _mm_sub_epi32(count, _mm_castps_si128(ge));
+                }
+                _mm_storeu_si128((__m128i *)(indices + i), count);
+        }
+        for (; i < n; i++) {
+                indices[i] = chroma_index(chroma[i]);
+        }
+}
+
+#endif
+
+/********** chroma_index_many *********************************************
+ *
+ * This function quantizes n chroma values at once, using the widest vector
+ * unit the CPU has (AVX2, then SSE4.1).
+ *
+ * Parameters:
+ *      const float *chroma     the chroma values
+ *      int n                   how many there are
+ *      unsigned *indices       where to put the n indices
+ *
+ * Return: N/A
+ *
+ * Expects: chroma and indices are not NULL, every value is in [-1, 1]
+ *     
+ * Notes: same results as chroma_index. Compression
+ *      
+ ***********************************************************************/
+void chroma_index_many(const float *chroma, int n, unsigned *indices)
+{
+        assert(chroma != NULL && indices != NULL);
+        pthread_once(&tables_once, build_tables);
+#ifdef CHROMA_SIMD
+        if (__builtin_cpu_supports("avx2")) {
+                chroma_index_many_avx2(chroma, n, indices);
+                return;
+        }
+        if (__builtin_cpu_supports("sse4.1")) {
+                chroma_index_many_sse(chroma, n, indices);
+                return;
+        }
+#endif
+        for (int i = 0; i < n; i++) {
+                indices[i] = chroma_index(chroma[i]);
+        }
+}
+
+/********** chroma_level **************************************************
+ *
+ * This function gives the chroma value of an index, like 
+ * Arith40_chroma_of_index.
+ *
+ * Parameters:
+ *      unsigned index          the index
+ *
+ * Return: the chroma value
+ *
+ * Expects: index is less than CHROMA_LEVELS
+ *     
+ * Notes: a table lookup. Decompression
+ *      
+ ***********************************************************************/
+float chroma_level(unsigned index)
+{
+        assert(index < CHROMA_LEVELS);
+        pthread_once(&tables_once, build_tables);
+        return levels[index];
+}
+
+/********** chroma_index_fixed ********************************************
+ *
+ * This function quantizes a fixed-point chroma value, like chroma_index.
+ *
+ * Parameters:
+ *      int chroma              the chroma value, in units of 
+ *                              1 / CHROMA_FIXED_ONE
+ *
+ * Return: the index of the nearest level
+ *
+ * Expects: N/A
+ *     
+ * Notes: the same as chroma_index(chroma / CHROMA_FIXED_ONE), with no 
+ *        floating point. Compression
+ *      
+ ***********************************************************************/
+unsigned chroma_index_fixed(int chroma)
+{
+        pthread_once(&tables_once, build_tables);
+        unsigned index = 0;
+        for (unsigned step = CHROMA_LEVELS / 2; step > 0; step /= 2) {
+                index += (chroma >= fixed_thresholds[index + step - 1]) ? step
+                                                                        : 0;
+        }
+        return index;
+}
+
+/********** chroma_level_fixed ********************************************
+ *
+ * This function gives the fixed-point chroma value of an index.
+ *
+ * Parameters:
+ *      unsigned index          the index
+ *
+ * Return: chroma_level(index) in units of 1 / CHROMA_FIXED_ONE, rounded
+ *
+ * Expects: index is less than CHROMA_LEVELS
+ *     
+ * Notes: a table lookup. Decompression
+ *      
+ ***********************************************************************/
+int chroma_level_fixed(unsigned index)
+{
+        assert(index < CHROMA_LEVELS);
+        pthread_once(&tables_once, build_tables);
+        return fixed_levels[index];
+}
+
+/********** chroma_fixed_thresholds ***************************************
+ *
+ * This function copies out the thresholds chroma_index_fixed uses, for 
+ * vector kernels that compare against all of them at once.
+ *
+ * Parameters:
+ *      int16_t thresholds[]    where to put the CHROMA_LEVELS - 1 
+ *                              thresholds, in units of 1 / CHROMA_FIXED_ONE
+ *
+ * Return: N/A
+ *
+ * Expects: thresholds is not NULL
+ *     
+ * Notes: a chroma's index is the number of thresholds it is at or above.
+ *        Compression
+ *      
+ ***********************************************************************/
+void chroma_fixed_thresholds(int16_t thresholds[CHROMA_LEVELS - 1])
+{
+        assert(thresholds != NULL);
+        pthread_once(&tables_once, build_tables);
+        for (unsigned i = 0; i < CHROMA_LEVELS - 1; i++) {
+                thresholds[i] = fixed_thresholds[i];
+        }
+}
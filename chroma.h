@@ -0,0 +1,42 @@
+/*************************************************************************
+ *
+ *                     chroma.h
+ *
+ *     Assignment: arith
+ *     Author:   Eva Caro
+ *     Date:     3/6/24
+ *
+ *     Interface of chroma, a table-driven replacement for 
+ *     Arith40_index_of_chroma and Arith40_chroma_of_index. The tables are 
+ *     built from the arith40 library the first time they are needed, so the
+ *     indices and levels are exactly the ones the library gives and existing
+ *     compressed files still decompress the same way.
+ *
+ *************************************************************************/
+
+#ifndef CHROMA_INCLUDED
+#define CHROMA_INCLUDED
+#include <stdint.h>
+
+/* number of quantized chroma levels, indices are 0 to CHROMA_LEVELS - 1 */
+#define CHROMA_LEVELS 16
+
+unsigned chroma_index(float chroma);
+void chroma_index_many(const float *chroma, int n, unsigned *indices);
+float chroma_level(unsigned index);
+
+/* 
+ * Fixed-point versions, for the integer pipeline: chroma values are ints in
+ * units of 1 / CHROMA_FIXED_ONE. chroma_index_fixed(x) is chroma_index(x /
+ * CHROMA_FIXED_ONE), and chroma_level_fixed rounds chroma_level to the 
+ * nearest unit.
+ */
+#define CHROMA_FIXED_BITS 14
+#define CHROMA_FIXED_ONE (1 << CHROMA_FIXED_BITS)
+
+unsigned chroma_index_fixed(int chroma);
+int chroma_level_fixed(unsigned index);
+/* thresholds[i] is the smallest chroma whose index is more than i */
+void chroma_fixed_thresholds(int16_t thresholds[CHROMA_LEVELS - 1]);
+
+#endif
@@ -18,16 +18,54 @@
 #include "a2methods.h"
 #include "a2plain.h"
 #include "bitpack.h"
+#include "mem.h"
+#include <string.h>
 
 typedef A2Methods_UArray2 A2;
 
 const int BYTE = 8;
-const int SCALEDBCD = 5;
-const int AFACTOR = 9;
-const int ALSB = 23;
-const int BLSB = 18;
-const int CLSB = 13;
-const int SCALEPBPR = 4;
+
+/* fails to compile if the fields in CODEWORD_FIELDS outgrow a codeword */
+typedef char codeword_fits[CODEWORD_BITS <= 32 ? 1 : -1];
+
+/* fails to compile if a field outgrows its member of scaled_dct */
+#define MEMBER_FITS(field, width, sign) \
+        && (width) <= 8 * sizeof(((scaled_dct *)0)->field)
+typedef char scaled_dct_fits[(1 CODEWORD_FIELDS(MEMBER_FITS)) ? 1 : -1];
+#undef MEMBER_FITS
+
+/* Straight-line field operations generated from CODEWORD_FIELDS. The u and s
+ * versions are picked by pasting the field's sign onto the macro name. */
+#define FIELD_MASK(field) (~(uint32_t)0 >> (32 - CODEWORD_##field##_WIDTH))
+
+#define FITS_u(value, field) \
+        (((uint32_t)(value) >> CODEWORD_##field##_WIDTH) == 0)
+#define FITS_s(value, field) \
+        ((uint32_t)(((int32_t)(value) >> (CODEWORD_##field##_WIDTH - 1)) \
+                    + 1) <= 1)
+
+#define GET_u(word, field) \
+        (((word) >> CODEWORD_##field##_LSB) & FIELD_MASK(field))
+#define GET_s(word, field) \
+        ((int32_t)((word) << (31 - CODEWORD_##field##_MSB)) \
+         >> (32 - CODEWORD_##field##_WIDTH))
+
+#define ASSERT_FIELD(field, width, sign) \
+        assert(FITS_##sign(elem.field, field));
+#define PACK_FIELD(field, width, sign) \
+        | (((uint32_t)elem.field & FIELD_MASK(field)) \
+           << CODEWORD_##field##_LSB)
+#define UNPACK_FIELD(field, width, sign) \
+        new_elem.field = GET_##sign(codeword, field);
+#define UNPACK_MANY_FIELD(field, width, sign) \
+        Bitpack_get##sign##_many(chunk, m, CODEWORD_##field##_WIDTH, \
+                                 CODEWORD_##field##_LSB, field_##sign); \
+        for (int k = 0; k < m; k++) { \
+                elems[i + k].field = field_##sign[k]; \
+        }
+
+/* number of codewords unpack_codeword_row decodes per Bitpack_*_many call */
+#define UNPACK_CHUNK 64
 
 /* Struct to help with closures */
 typedef struct array_methods {
@@ -37,14 +75,6 @@ typedef struct array_methods {
         A2Methods_T methods;
 } array_methods;
 
-/* Struct of scaled DCT values with unsigned and signed values */
-typedef struct scaled_dct {
-        /* unsigned values for a, pB, and pR */
-        unsigned a, pB, pR;
-        /* signed b, c, and d components */
-        signed b, c, d;
-} scaled_dct;
-
 /* Struct to help with reading in the compressed file and unpacking it */
 typedef struct unpack_cl {
         /* file/input given */
@@ -53,6 +83,10 @@ typedef struct unpack_cl {
         int *counter;
 } unpack_cl;
 
+static void swap_codewords(uint32_t *codewords, size_t n);
+static void map_rows(A2 array, A2Methods_T methods, A2Methods_applyfun apply,
+                     void *cl);
+
 /* Exceptions to raise */
 Except_T File_Too_Short = { "Supplied input does not match width and height" };
 
@@ -67,33 +101,38 @@ Except_T File_Too_Short = { "Supplied input does not match width and height" };
  * Parameters:
  *      Pnm_ppm my_ppm          the Pnm_ppm
  *      bool compress           if we are compressing or not
- *      FILE *input             file given for decompression
+ *      FILE *fp                file to print the compressed image to when
+ *                              compressing, or to read it from when 
+ *                              decompressing
  *
  * Return: a Pnm_ppm with the new values in the array
  *
- * Expects: my_ppm is not NULL
+ * Expects: my_ppm and fp are not NULL
  *     
- * Notes: Only use file if decompressing
+ * Notes: Uses the ppm's own methods, and
+ *        reads and prints the codewords in row major order whatever order 
+ *        the methods' default map goes in.
  *      
  ***********************************************************************/
-Pnm_ppm codewords_parent(Pnm_ppm my_ppm, bool compress, FILE *input)
+Pnm_ppm codewords_parent(Pnm_ppm my_ppm, bool compress, FILE *fp)
 {
         assert(my_ppm != NULL);
+        assert(fp != NULL);
         A2 array = my_ppm->pixels;
-        A2Methods_T methods = uarray2_methods_plain;
+        A2Methods_T methods = my_ppm->methods;
         if (compress) {
                 my_ppm->pixels = pack(array, methods);
-                printf("COMP40 Compressed image format 2\n%u %u\n", 
+                fprintf(fp, "COMP40 Compressed image format 2\n%u %u\n", 
                         methods->width(my_ppm->pixels) * 2, 
                         methods->height(my_ppm->pixels) * 2);
-                methods->map_row_major(my_ppm->pixels, apply_print, NULL);
+                map_rows(my_ppm->pixels, methods, apply_print, fp);
         } else {
                 unpack_cl u_c;
-                u_c.input = input;
+                u_c.input = fp;
                 int counter = 0;
                 u_c.counter = &counter;
                 void *cl = &u_c;
-                methods->map_row_major(array, code_apply, cl);
+                map_rows(array, methods, code_apply, cl);
                 if (counter != (int)(my_ppm->width * my_ppm->height)) {
                         RAISE(File_Too_Short);
                 }
@@ -104,6 +143,45 @@ Pnm_ppm codewords_parent(Pnm_ppm my_ppm, bool compress, FILE *input)
 }
 
 
+/********** map_rows ******************************************************
+ *
+ * This function calls apply on every element of the array in row major 
+ * order, for the codewords, which have to be read and written in that 
+ * order.
+ *
+ * Parameters:
+ *      A2 array                the array
+ *      A2Methods_T methods     its methods
+ *      apply                   the apply function
+ *      void *cl                closure, passed to apply
+ *
+ * Return: void
+ *
+ * Expects: array and methods are not NULL
+ *     
+ * Notes: uses the methods' own map_row_major, or goes through at() for 
+ *        suites without one (like the blocked one)
+ *      
+ ***********************************************************************/
+static void map_rows(A2 array, A2Methods_T methods, A2Methods_applyfun apply,
+                     void *cl)
+{
+        assert(array != NULL);
+        assert(methods != NULL);
+        if (methods->map_row_major != NULL) {
+                methods->map_row_major(array, apply, cl);
+                return;
+        }
+        int width = methods->width(array);
+        int height = methods->height(array);
+        for (int row = 0; row < height; row++) {
+                for (int col = 0; col < width; col++) {
+                        apply(col, row, array, methods->at(array, col, row), 
+                              cl);
+                }
+        }
+}
+
 /********** pack ********************************************************
  *
  * This function is a mapping function that creates a closure and then calls
@@ -128,7 +206,7 @@ A2 pack(A2 array, A2Methods_T methods)
         assert(methods != NULL);
         A2 *new_array = methods->new(methods->width(array), 
                                      methods->height(array), 
-                                     sizeof(uint64_t));
+                                     sizeof(uint32_t));
         array_methods a_m;
         a_m.array = new_array;
         a_m.methods = methods;
@@ -170,40 +248,25 @@ void apply_pack(int col, int row, A2 array, void *elem, void *cl)
         A2 *new_array = a_m->array;
         A2Methods_T methods = a_m->methods;
         scaled_dct *elem_p = elem;
-        
-        assert(Bitpack_fitsu(elem_p->a, AFACTOR)); 
-        assert(Bitpack_fitss(elem_p->b, SCALEDBCD));
-        assert(Bitpack_fitss(elem_p->c, SCALEDBCD));
-        assert(Bitpack_fitss(elem_p->d, SCALEDBCD));
-        assert(Bitpack_fitsu(elem_p->pB, SCALEPBPR));
-        assert(Bitpack_fitsu(elem_p->pR, SCALEPBPR));
-
-        uint64_t codeword = Bitpack_newu(0, SCALEPBPR, 0, elem_p->pR); 
-
-        codeword = Bitpack_newu(codeword, SCALEPBPR, SCALEPBPR, elem_p->pB);
-        codeword = Bitpack_news(codeword, SCALEDBCD, BYTE, elem_p->d);
-        codeword = Bitpack_news(codeword, SCALEDBCD, CLSB, elem_p->c);
-        codeword = Bitpack_news(codeword, SCALEDBCD, BLSB, elem_p->b);
-        codeword = Bitpack_newu(codeword, AFACTOR, ALSB, elem_p->a);
-
-        *(uint64_t *)methods->at(new_array, col, row) = codeword;
+
+        *(uint32_t *)methods->at(new_array, col, row) = pack_codeword(*elem_p);
 }
 
 /********** apply_print ****************************************************
  *
  * This function is the apply function for our packing function. It turns each
- * codeword into 4 bytes and uses putchar to print out the bytes accordingly.
+ * codeword into 4 bytes and prints them out to the file in the closure.
  *
  * Parameters:
  *      int col                          column
  *      int row                          row
  *      A2 array                         the array
  *      void *elem                       elem at that position
- *      void *cl                         closure struct
+ *      void *cl                         FILE to print to
  *
  * Return: void
  *
- * Expects: elem is not NULL
+ * Expects: elem and cl are not NULL
  *     
  * Notes: Compression
  *      
@@ -211,21 +274,12 @@ void apply_pack(int col, int row, A2 array, void *elem, void *cl)
 void apply_print(int col, int row, A2 array, void *elem, void *cl)
 {
         assert(elem != NULL);
-        (void) cl;
+        assert(cl != NULL);
         (void) col;
         (void) row;
         (void) array;
-        uint64_t *elem_p = elem;
-        uint64_t byte;
-        byte = Bitpack_getu(*elem_p, BYTE, BYTE * 3);
-        putchar(byte);
-        byte = Bitpack_getu(*elem_p, BYTE, BYTE * 2);
-        putchar(byte);
-        byte = Bitpack_getu(*elem_p, BYTE, BYTE);
-        putchar(byte);
-        byte = Bitpack_getu(*elem_p, BYTE, 0);
-        putchar(byte);
-
+        uint32_t *elem_p = elem;
+        write_codeword(*elem_p, cl);
 }
 
 
@@ -255,30 +309,22 @@ void code_apply(int col, int row, A2 array, void *elem, void *cl)
 {
         assert(array != NULL);
         assert(cl != NULL);
-        (void) elem;
+        assert(elem != NULL);
         unpack_cl *u_cl = cl;
         FILE *input = u_cl->input;
         int *counter = u_cl->counter;
-        uint64_t byte1, byte2, byte3, byte4, codeword;
-        A2Methods_T methods = uarray2_methods_plain;
-
-        byte1 = fgetc(input);
-        byte2 = fgetc(input);
-        byte3 = fgetc(input);
-        byte4 = fgetc(input);
-        codeword = Bitpack_newu(0, BYTE, 0, byte4);
-        codeword = Bitpack_newu(codeword, BYTE, BYTE, byte3);
-        codeword = Bitpack_newu(codeword, BYTE, BYTE * 2, byte2);
-        codeword = Bitpack_newu(codeword, BYTE, BYTE * 3, byte1);
-        *(uint64_t *)methods->at(array, col, row) = codeword;
+        (void) col;
+        (void) row;
+
+        *(uint32_t *)elem = read_codeword(input);
         (*counter)++;
 }
 
 /********** unpack ********************************************************
  *
- * This function is a mapping function that creates a closure and then calls
- * on an apply function to change from the given codewords to 6 component 
- * video values. 
+ * This function changes from the given codewords to 6 component video 
+ * values. It copies out one row of codewords at a time and decodes the 
+ * whole row with unpack_codeword_row.
  *
  * Parameters:
  *      A2 array                the array given
@@ -291,7 +337,8 @@ void code_apply(int col, int row, A2 array, void *elem, void *cl)
  * Expects: array is not NULL, methods not NULL
  *     
  * Notes: creating a new array that is not freed here, frees the old array,
- *        new array is of type scaled dct, Decompression
+ *        new array is of type scaled dct, Decompression. The rows are 
+ *        copied through at() since methods may not keep a row together.
  *      
  ***********************************************************************/
 A2 unpack(A2 array, A2Methods_T methods, int width, int height)
@@ -300,11 +347,20 @@ A2 unpack(A2 array, A2Methods_T methods, int width, int height)
         assert(methods != NULL);
 
         A2 *new_array = methods->new(width, height, sizeof(struct scaled_dct));
-        array_methods a_m;
-        a_m.array = new_array;
-        a_m.methods = methods;
-        void *cl = &a_m;
-        methods->map_row_major(array, apply_unpack, cl);
+        uint32_t *words = ALLOC(width * sizeof(*words));
+        scaled_dct *elems = ALLOC(width * sizeof(*elems));
+        for (int row = 0; row < height; row++) {
+                for (int col = 0; col < width; col++) {
+                        words[col] = *(uint32_t *)methods->at(array, col, row);
+                }
+                unpack_codeword_row(words, width, elems);
+                for (int col = 0; col < width; col++) {
+                        *(scaled_dct *)methods->at(new_array, col, row) = 
+                                elems[col];
+                }
+        }
+        FREE(words);
+        FREE(elems);
         methods->free(&array);
         return new_array;
 }
@@ -314,6 +370,8 @@ A2 unpack(A2 array, A2Methods_T methods, int width, int height)
  * This function is the apply function for our unpacking function. It takes 
  * current element's codeword and uses Bitpack to unpack the codeword into its
  * a, b, c, d, pR, and pB values. It then places the word into the new array.
+ * unpack itself now decodes a row at a time; this is the one-element 
+ * version for clients that map.
  *
  * Parameters:
  *      int col                          column
@@ -334,20 +392,253 @@ void apply_unpack(int col, int row, A2 array, void *elem, void *cl)
         (void) array;
         assert(cl != NULL);
         assert(elem != NULL);
-        uint64_t *elem_p = elem;
-        scaled_dct new_elem;
+        uint32_t *elem_p = elem;
         array_methods *a_m = cl;
         A2 new_array = a_m->array;
         A2Methods_T methods = a_m->methods;
 
-        new_elem.a = Bitpack_getu(*elem_p, AFACTOR, ALSB);
-        new_elem.b = Bitpack_gets(*elem_p, SCALEDBCD, BLSB);
-        new_elem.c = Bitpack_gets(*elem_p, SCALEDBCD, CLSB);
-        new_elem.d = Bitpack_gets(*elem_p, SCALEDBCD, BYTE);
-        new_elem.pB = Bitpack_getu(*elem_p, SCALEPBPR, SCALEPBPR);
-        new_elem.pR = Bitpack_getu(*elem_p, SCALEPBPR, 0);
+        scaled_dct new_elem = unpack_codeword(*elem_p);
        
         *(scaled_dct *)methods->at(new_array, col, row) = new_elem;
 }
 
+/********** pack_codeword ***************************************************
+ *
+ * This function packs one block's a, b, c, d, pB, and pR values into a 
+ * 32-bit codeword, laid out as CODEWORD_FIELDS in codewords.h says. 
+ *
+ * Parameters:
+ *      scaled_dct elem                  the scaled DCT values to pack
+ *
+ * Return: the codeword
+ *
+ * Expects: a, b, c, d, pR, and pB fit into their corresponding bit values,
+ *          CRE if not
+ *     
+ * Notes: Compression. Runs once per block, so the body is generated from 
+ *        CODEWORD_FIELDS as one OR of masked, shifted fields with no calls;
+ *        the asserts are inline shift tests.
+ *      
+ *************************************************************************/
+uint32_t pack_codeword(scaled_dct elem)
+{
+        CODEWORD_FIELDS(ASSERT_FIELD)
+
+        return 0 CODEWORD_FIELDS(PACK_FIELD);
+}
+
+/********** unpack_codeword *************************************************
+ *
+ * This function unpacks a 32-bit codeword into its a, b, c, d, pB, and pR 
+ * values, laid out as CODEWORD_FIELDS in codewords.h says.
+ *
+ * Parameters:
+ *      uint32_t codeword                the codeword to unpack
+ *
+ * Return: the scaled DCT values held in the codeword
+ *
+ * Expects: N/A
+ *     
+ * Notes: Decompression. The body is generated from CODEWORD_FIELDS as one
+ *        shift and mask per unsigned field, and one shift up and 
+ *        arithmetic shift down per signed field to sign-extend it.
+ *      
+ *************************************************************************/
+scaled_dct unpack_codeword(uint32_t codeword)
+{
+        scaled_dct new_elem;
+        CODEWORD_FIELDS(UNPACK_FIELD)
+        return new_elem;
+}
+
+/********** unpack_codeword_row *********************************************
+ *
+ * This function unpacks a row of codewords into their a, b, c, d, pB, and pR
+ * values, giving the same values unpack_codeword would.
+ *
+ * Parameters:
+ *      const uint32_t *codewords        the codewords
+ *      int n                            number of codewords
+ *      scaled_dct *elems                where to put the n decoded blocks
+ *
+ * Return: void
+ *
+ * Expects: codewords and elems are not NULL, n >= 0
+ *     
+ * Notes: Decompression. Widens UNPACK_CHUNK codewords at a time into the 
+ *        words the Bitpack_*_many functions take, pulls each field out of 
+ *        them (one call per field, generated from CODEWORD_FIELDS), then 
+ *        spreads them into elems.
+ *      
+ *************************************************************************/
+void unpack_codeword_row(const uint32_t *codewords, int n, 
+                         scaled_dct *elems)
+{
+        assert(codewords != NULL);
+        assert(elems != NULL);
+        assert(n >= 0);
+        uint64_t chunk[UNPACK_CHUNK];
+        uint64_t field_u[UNPACK_CHUNK];
+        int64_t field_s[UNPACK_CHUNK];
+
+        for (int i = 0; i < n; i += UNPACK_CHUNK) {
+                int m = n - i < UNPACK_CHUNK ? n - i : UNPACK_CHUNK;
+                for (int k = 0; k < m; k++) {
+                        chunk[k] = codewords[i + k];
+                }
+                CODEWORD_FIELDS(UNPACK_MANY_FIELD)
+        }
+}
+
+/********** write_codeword **************************************************
+ *
+ * This function writes a codeword to the given output as 4 bytes in 
+ * big-endian order.
+ *
+ * Parameters:
+ *      uint32_t codeword                the codeword to write
+ *      FILE *output                     where to write it
+ *
+ * Return: void
+ *
+ * Expects: output is not NULL
+ *     
+ * Notes: Compression
+ *      
+ *************************************************************************/
+void write_codeword(uint32_t codeword, FILE *output)
+{
+        assert(output != NULL);
+        putc(Bitpack_getu(codeword, BYTE, BYTE * 3), output);
+        putc(Bitpack_getu(codeword, BYTE, BYTE * 2), output);
+        putc(Bitpack_getu(codeword, BYTE, BYTE), output);
+        putc(Bitpack_getu(codeword, BYTE, 0), output);
+}
+
+/********** read_codeword ***************************************************
+ *
+ * This function reads a codeword from the given input, which holds it as 4
+ * bytes in big-endian order.
+ *
+ * Parameters:
+ *      FILE *input                      where to read the codeword from
+ *
+ * Return: the codeword
+ *
+ * Expects: input is not NULL
+ *     
+ * Notes: raises File_Too_Short if the input ends partway through the 
+ *        codeword, Decompression
+ *      
+ *************************************************************************/
+uint32_t read_codeword(FILE *input)
+{
+        assert(input != NULL);
+        int byte1 = getc(input);
+        int byte2 = getc(input);
+        int byte3 = getc(input);
+        int byte4 = getc(input);
+        if (byte4 == EOF) {
+                RAISE(File_Too_Short);
+        }
+        uint64_t codeword = Bitpack_newu(0, BYTE, 0, byte4);
+        codeword = Bitpack_newu(codeword, BYTE, BYTE, byte3);
+        codeword = Bitpack_newu(codeword, BYTE, BYTE * 2, byte2);
+        codeword = Bitpack_newu(codeword, BYTE, BYTE * 3, byte1);
+        return codeword;
+}
+
+/********** write_codeword_row **********************************************
+ *
+ * This function writes a whole row of codewords to the given output with a 
+ * single fwrite, each codeword as 4 bytes in big-endian order. The bytes 
+ * come out exactly as if write_codeword had been called on each codeword.
+ *
+ * Parameters:
+ *      uint32_t *codewords              the row of codewords
+ *      size_t n                         number of codewords in the row
+ *      FILE *output                     where to write them
+ *
+ * Return: void
+ *
+ * Expects: codewords and output are not NULL
+ *     
+ * Notes: the codewords are byte-swapped in place, so the row holds big-endian
+ *        words afterwards and should not be used again. Like putc in 
+ *        write_codeword, a failed write only sets output's error flag, for
+ *        the caller to check. Compression
+ *      
+ *************************************************************************/
+void write_codeword_row(uint32_t *codewords, size_t n, FILE *output)
+{
+        assert(codewords != NULL);
+        assert(output != NULL);
+        swap_codewords(codewords, n);
+        fwrite(codewords, sizeof(uint32_t), n, output);
+}
+
+/********** read_codeword_row ***********************************************
+ *
+ * This function reads a whole row of codewords from the given source, where 
+ * each codeword is held as 4 bytes in big-endian order. A FILE is read with 
+ * a single fread, and a mapped file is read straight from the mapping.
+ *
+ * Parameters:
+ *      uint32_t *codewords              where to put the row of codewords
+ *      size_t n                         number of codewords in the row
+ *      source input                     where to read them from
+ *
+ * Return: void
+ *
+ * Expects: codewords and input are not NULL
+ *     
+ * Notes: raises File_Too_Short if the input ends before the row does, 
+ *        Decompression
+ *      
+ *************************************************************************/
+void read_codeword_row(uint32_t *codewords, size_t n, source input)
+{
+        assert(codewords != NULL);
+        assert(input != NULL);
+        size_t bytes = n * sizeof(uint32_t);
+        const unsigned char *row = source_read(input, bytes, 
+                                               (unsigned char *)codewords);
+        if (row == NULL) {
+                RAISE(File_Too_Short);
+        }
+        if (row != (unsigned char *)codewords) {
+                memcpy(codewords, row, bytes);
+        }
+        swap_codewords(codewords, n);
+}
+
+/********** swap_codewords **************************************************
+ *
+ * This function converts a row of codewords between big-endian (the order 
+ * they are stored in a compressed file) and the machine's own byte order.
+ *
+ * Parameters:
+ *      uint32_t *codewords              the row of codewords
+ *      size_t n                         number of codewords in the row
+ *
+ * Return: void
+ *
+ * Expects: codewords is not NULL
+ *     
+ * Notes: does nothing on a big-endian machine. The loop is a plain 
+ *        __builtin_bswap32 over the buffer, which the compiler vectorizes.
+ *      
+ *************************************************************************/
+static void swap_codewords(uint32_t *codewords, size_t n)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        for (size_t i = 0; i < n; i++) {
+                codewords[i] = __builtin_bswap32(codewords[i]);
+        }
+#else
+        (void) codewords;
+        (void) n;
+#endif
+}
+
 #undef A2 
\ No newline at end of file
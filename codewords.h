@@ -9,11 +9,41 @@
  *     Interface of codewords.h. 
  *
  *************************************************************************/
+#ifndef CODEWORDS_INCLUDED
+#define CODEWORDS_INCLUDED
 #include <stdbool.h>
+#include <stdint.h>
 #include "pnm.h"
+#include "float.h"
+#include "source.h"
 
+/* Layout of a 32-bit codeword, one X(field, width, u or s) per field of 
+ * scaled_dct, listed from the least significant field up. Each field starts
+ * where the one before it ends, so a different bit budget is an edit to the
+ * widths here and nothing else. Every field must be under 32 bits wide. */
+#define CODEWORD_FIELDS(X) \
+        X(pR, 4, u)        \
+        X(pB, 4, u)        \
+        X(d,  5, s)        \
+        X(c,  5, s)        \
+        X(b,  5, s)        \
+        X(a,  9, u)
 
-Pnm_ppm codewords_parent(Pnm_ppm my_ppm, bool compress, FILE *input);
+/* CODEWORD_<field>_WIDTH */
+#define CODEWORD_WIDTH_ENUM(field, width, sign) \
+        CODEWORD_##field##_WIDTH = (width),
+enum { CODEWORD_FIELDS(CODEWORD_WIDTH_ENUM) };
+#undef CODEWORD_WIDTH_ENUM
+
+/* CODEWORD_<field>_LSB and CODEWORD_<field>_MSB; each LSB counts on from the
+ * MSB before it, and CODEWORD_BITS is the total width */
+#define CODEWORD_LSB_ENUM(field, width, sign) \
+        CODEWORD_##field##_LSB, \
+        CODEWORD_##field##_MSB = CODEWORD_##field##_LSB + (width) - 1,
+enum { CODEWORD_FIELDS(CODEWORD_LSB_ENUM) CODEWORD_BITS };
+#undef CODEWORD_LSB_ENUM
+
+Pnm_ppm codewords_parent(Pnm_ppm my_ppm, bool compress, FILE *fp);
 
 /* Compress */
 A2Methods_UArray2 pack(A2Methods_UArray2 array, A2Methods_T methods);
@@ -28,4 +58,16 @@ void code_apply(int col, int row, A2Methods_UArray2 array, void *elem,
 A2Methods_UArray2 unpack(A2Methods_UArray2 array, A2Methods_T methods, 
                          int width, int height);
 void apply_unpack(int col, int row, A2Methods_UArray2 array, void *elem, 
-                  void *cl);
\ No newline at end of file
+                  void *cl);
+
+/* Per-codeword helpers shared with the fused pipeline in compress40.c */
+uint32_t pack_codeword(scaled_dct elem);
+scaled_dct unpack_codeword(uint32_t codeword);
+void unpack_codeword_row(const uint32_t *codewords, int n, 
+                         scaled_dct *elems);
+void write_codeword(uint32_t codeword, FILE *output);
+uint32_t read_codeword(FILE *input);
+void write_codeword_row(uint32_t *codewords, size_t n, FILE *output);
+void read_codeword_row(uint32_t *codewords, size_t n, source input);
+
+#endif
\ No newline at end of file
@@ -15,6 +15,12 @@
 #include "int.h"
 #include "float.h"
 #include "codewords.h"
+#include "blocktable.h"
+#include "ppmio.h"
+#include "source.h"
+#include "workers.h"
+#include "jobarena.h"
+#include <string.h>
 #include "a2methods.h"
 #include "uarray2.h"
 #include "a2plain.h"
@@ -27,20 +33,238 @@
 
 const unsigned DENOM = 255;
 const int HALF = 2;
+/* block-rows in each job handed to the workers */
+const unsigned BAND = 16;
 
 typedef A2Methods_UArray2 A2;
 
-/* structure containing scaled DCT values */
-struct scaled_dct {
-        unsigned a, pB, pR;
-        signed b, c, d;
+/* number of threads compress40 and decompress40 use */
+static unsigned threads = 1;
+
+/* methods of the staged pipeline, or NULL to stream */
+static A2Methods_T staged_methods = NULL;
+
+/* whether streaming uses the fixed-point kernels */
+static bool fixed_point = false;
+
+/* whether rgb is converted to comp video with lookup tables */
+static bool use_tables = false;
+
+/* the workers and buffers used to compress or decompress, which can be kept
+   from one image to the next */
+struct compress40_context {
+        unsigned threads;
+        workers pool;
+        /* one scratch for each thread, for rows of up to scratch_width 
+           pixels */
+        struct scratch *scratch;
+        unsigned scratch_width;
+        /* chunk buffers and their sizes in bytes, grown as needed */
+        const unsigned char **raw;
+        size_t raw_size;
+        unsigned char *bytes;
+        size_t bytes_size;
+        struct Pnm_rgb *pixels;
+        size_t pixels_size;
+        uint32_t *codewords;
+        size_t codewords_size;
+        /* where the staged pipeline's arrays are made, reset after each 
+           image */
+        job_arena arena;
+        /* the lookup tables for the last denominator they were needed for,
+           and for decoding codewords to DENOM, or NULL until needed */
+        comp_table table;
+        block_table decoder;
+};
+
+/* buffers that belong to one worker thread */
+struct scratch {
+        comp_row top, bottom;
+        fixed_row fixed_top, fixed_bottom;
+        scaled_dct *elems;
 };
 
+/* a chunk of block-rows being compressed by the workers */
+struct compress_chunk {
+        /* pixels used from each row (even), and the ppm's denominator */
+        unsigned width;
+        float denom;
+        /* whether to use the fixed-point kernels, with color's 
+           coefficients */
+        bool fixed;
+        fixed_color color;
+        /* the lookup tables to convert with, or NULL to do the arithmetic */
+        comp_table table;
+        /* number of block-rows in the chunk, and in each job */
+        unsigned rows, band;
+        /* the chunk's rows of the ppm: raw rows of bytes if bytes is true, 
+           otherwise rows of stride Pnm_rgb's */
+        bool bytes;
+        const unsigned char **raw;
+        struct Pnm_rgb *pixels;
+        unsigned stride;
+        /* the chunk's codewords, width / 2 for each block-row */
+        uint32_t *codewords;
+        struct scratch *scratch;
+};
+
+/* a chunk of block-rows being decompressed by the workers */
+struct decompress_chunk {
+        /* pixels in each row (even) */
+        unsigned width;
+        /* whether to use the fixed-point kernels */
+        bool fixed;
+        /* the lookup tables to decode with, or NULL */
+        block_table table;
+        /* number of block-rows in the chunk, and in each job */
+        unsigned rows, band;
+        /* the chunk's codewords, width / 2 for each block-row */
+        uint32_t *codewords;
+        /* the chunk's finished rows of the ppm, 3 * width bytes each */
+        unsigned char *pixels;
+        struct scratch *scratch;
+};
+
+static void compress_source(source input, FILE *output, 
+                            compress40_context context);
+static void compress_stream(ppm_stream stream, FILE *output, 
+                            compress40_context context);
+static void read_chunk(ppm_stream stream, struct compress_chunk *chunk, 
+                       unsigned char *copies);
+static void compress_band(int band, unsigned worker, void *cl);
+static void row_to_comp(struct compress_chunk *chunk, unsigned row, 
+                        comp_row comp);
+static void row_to_fixed(struct compress_chunk *chunk, unsigned row, 
+                         fixed_row comp);
+static void compress_row_pair(comp_row top, comp_row bottom, unsigned width,
+                              scaled_dct *elems, uint32_t *codewords);
+static void decompress_source(source input, FILE *output, 
+                              compress40_context context);
+static void decompress_rows(source input, unsigned width, unsigned height,
+                            FILE *output, compress40_context context);
+static void decompress_band(int band, unsigned worker, void *cl);
+static struct scratch *scratch_new(unsigned count, unsigned width);
+static void scratch_free(struct scratch **scratch, unsigned count);
+static struct scratch *context_scratch(compress40_context context, 
+                                       unsigned width);
+static comp_table context_table(compress40_context context, unsigned denom);
+static void *grow(void *buffer, size_t *size, size_t need);
+static unsigned chunk_rows(compress40_context context);
+static void compress_staged(FILE *input, FILE *output, 
+                            compress40_context context);
+static void decompress_staged(FILE *input, FILE *output, 
+                              compress40_context context);
+
+/********** compress40_threads *********************************************
+ *
+ * This function sets the number of threads compress40 and decompress40 use.
+ *
+ * Parameters:
+ *      unsigned n              number of threads
+ *
+ * Return: N/A
+ *
+ * Expects: n is at least 1
+ *     
+ * Notes: the output is the same for any number of threads. The default is 1.
+ *      
+ ***********************************************************************/
+extern void compress40_threads(unsigned n)
+{
+        assert(n >= 1);
+        threads = n;
+}
+
+/********** compress40_methods *********************************************
+ *
+ * This function chooses between the streaming pipeline and the staged one 
+ * for compress40, decompress40, and their _file versions.
+ *
+ * Parameters:
+ *      A2Methods_T methods     methods for the staged pipeline's arrays, or
+ *                              NULL to stream
+ *
+ * Return: N/A
+ *
+ * Expects: N/A
+ *     
+ * Notes: the default is NULL. The staged pipeline's output is the same 
+ *        for every layout, since it always does the exact arithmetic; the 
+ *        streaming pipeline's vector kernels can round a sample differently
+ *        (see int.h), so its output can differ from it by 1 in places. The
+ *        staged pipeline keeps the whole image in memory and is slower, but
+ *        lets the array layouts be compared (e.g. uarray2_methods_plain_rows against
+ *        uarray2_methods_blocked). The staged pipeline's arrays are made 
+ *        in the context's job_arena, so with a context that is kept, the 
+ *        memory for one image is reused for the next.
+ *      
+ ***********************************************************************/
+extern void compress40_methods(A2Methods_T methods)
+{
+        staged_methods = methods;
+}
+
+/********** compress40_fixed ***********************************************
+ *
+ * This function chooses between the floating-point kernels and the 
+ * fixed-point ones for the streaming pipeline.
+ *
+ * Parameters:
+ *      bool on                 whether to use the fixed-point kernels
+ *
+ * Return: N/A
+ *
+ * Expects: N/A
+ *     
+ * Notes: the default is false. The fixed-point kernels (fixed_* in int.h 
+ *        and float.h) use no floating point, so the codewords they make are
+ *        the same on every compiler and machine; they work in 16-bit lanes
+ *        and are faster, and their output is as close to the original as 
+ *        the floating-point kernels' (compare with ppmdiff). Either 
+ *        decompressor reads what either compressor writes. The staged 
+ *        pipeline always uses floating point.
+ *      
+ ***********************************************************************/
+extern void compress40_fixed(bool on)
+{
+        fixed_point = on;
+}
+
+/********** compress40_tables **********************************************
+ *
+ * This function chooses between doing the color arithmetic for every pixel
+ * and looking it up in tables: comp_table (int.h) to compress, and 
+ * block_table (blocktable.h) to decompress.
+ *
+ * Parameters:
+ *      bool on                 whether to use the lookup tables
+ *
+ * Return: N/A
+ *
+ * Expects: N/A
+ *     
+ * Notes: the default is false. Compressing, the tables are used by the 
+ *        floating-point streaming pipeline and by the staged one, and give
+ *        exactly the per-pixel arithmetic's results, which the vector 
+ *        kernels for raw 8-bit rows only come within 1e-6 of. 
+ *        Decompressing, only the streaming pipeline uses them, to turn 
+ *        each codeword straight into its block's rgb values; those can 
+ *        differ from the arithmetic's by 1. Tables are built once per 
+ *        context (and denominator), so a batch shares them.
+ *      
+ ***********************************************************************/
+extern void compress40_tables(bool on)
+{
+        use_tables = on;
+}
+
 /********** compress40 ****************************************************
  *
- * This function handles compression. It calls on functions in external helper 
- * files (int, float, and codewords), which turn a ppm from rgb values to 
- * packed binary codewords, and prints the codewords to standard output.
+ * This function handles compression. It wraps the input in a source and 
+ * hands it to compress_source, which uses the per-pixel and per-block helpers
+ * in external files (int, float, and codewords) to turn the ppm from rgb 
+ * values to packed binary codewords, and prints the codewords to standard 
+ * output.
  *
  * Parameters:
  *      FILE *input             a file pointer to read the ppm from
@@ -50,33 +274,435 @@ struct scaled_dct {
  * Expects: input is not null and contains information for a valid ppm file
  *     
  * Notes: resulting compressed file is printed to standard output.
- *        Calls on functions in int.h, float.h, and codewords.h, which could 
- *    -   result in exceptions (see function contracts in those three files for
- *        more info).
+ *        Calls on functions in ppmio.h, int.h, float.h, and codewords.h, 
+ *    -   which could result in exceptions (see function contracts in those 
+ *        files for more info).
  *    -   The height and width in the header of the printed information 
  *        reflects that of the original file, not the compressed one (which is
  *        about 1/4 the size).
+ *    -   Only two rows of the ppm are in memory at a time, so images larger
+ *        than memory can be compressed.
  *      
  ***********************************************************************/
 extern void compress40(FILE *input) 
 {
-        A2Methods_T methods = uarray2_methods_plain;
-        Pnm_ppm my_ppm = Pnm_ppmread(input, methods);
+        compress40_context context = compress40_context_new(threads);
+        if (staged_methods != NULL) {
+                compress_staged(input, stdout, context);
+                compress40_context_free(&context);
+                return;
+        }
 
-        my_ppm = int_parent(my_ppm, true);
-        my_ppm = float_parent(my_ppm, true);
-        my_ppm = codewords_parent(my_ppm, true, input);
+        source src = source_new(input);
 
-        Pnm_ppmfree(&my_ppm);
+        compress_source(src, stdout, context);
+
+        compress40_context_free(&context);
+        source_free(&src);
+}
+
+/********** compress40_file ************************************************
+ *
+ * This function compresses the named ppm file to standard output. See 
+ * compress40_path.
+ *
+ * Parameters:
+ *      const char *path        name of the ppm file
+ *
+ * Return: N/A
+ *
+ * Expects: path is not NULL and names a readable ppm file
+ *     
+ * Notes: uses the number of threads set by compress40_threads
+ *      
+ ***********************************************************************/
+extern void compress40_file(const char *path)
+{
+        compress40_context context = compress40_context_new(threads);
+
+        compress40_path(path, stdout, context);
+
+        compress40_context_free(&context);
+}
+
+/********** compress40_path ************************************************
+ *
+ * This function compresses the named ppm file. If the file can be mapped into
+ * memory, the pixels are read straight from the mapping. Otherwise the file is
+ * opened and read with stdio.
+ *
+ * Parameters:
+ *      const char *path                name of the ppm file
+ *      FILE *output                    where to write the compressed image
+ *      compress40_context context      the workers and buffers to use
+ *
+ * Return: N/A
+ *
+ * Expects: path, output, and context are not NULL, and path names a readable
+ *          ppm file
+ *     
+ * Notes: see compress40. Buffers in context are reused, and grown if 
+ *        needed, so compressing many files with one context allocates 
+ *        little after the first.
+ *      
+ ***********************************************************************/
+extern void compress40_path(const char *path, FILE *output, 
+                            compress40_context context)
+{
+        assert(path != NULL);
+        if (staged_methods != NULL) {
+                FILE *fp = fopen(path, "r");
+                assert(fp != NULL);
+                compress_staged(fp, output, context);
+                fclose(fp);
+                return;
+        }
+        source src = source_map(path);
+        FILE *fp = NULL;
+        if (src == NULL) {
+                fp = fopen(path, "r");
+                assert(fp != NULL);
+                src = source_new(fp);
+        }
+
+        compress_source(src, output, context);
+
+        source_free(&src);
+        if (fp != NULL) {
+                fclose(fp);
+        }
+}
 
+/********** compress_source ************************************************
+ *
+ * This function opens the ppm in the given source as a ppm_stream and hands
+ * it to compress_stream.
+ *
+ * Parameters:
+ *      source input                    where to read the ppm from
+ *      FILE *output                    where to write the compressed image
+ *      compress40_context context      the workers and buffers to use
+ *
+ * Return: N/A
+ *
+ * Expects: input and output are not NULL
+ *     
+ * Notes: does not free input
+ *      
+ ***********************************************************************/
+static void compress_source(source input, FILE *output, 
+                            compress40_context context)
+{
+        ppm_stream stream = ppm_stream_open(input);
+
+        compress_stream(stream, output, context);
+
+        ppm_stream_close(&stream);
+}
+
+/********** compress_stream ************************************************
+ *
+ * This function is the fused, streaming compression pipeline. It reads the
+ * ppm a chunk of block-rows (pairs of rows) at a time and has the workers 
+ * turn each block-row into a row of codewords, then writes the chunk's 
+ * codewords out before reading the next chunk.
+ *
+ * Parameters:
+ *      ppm_stream stream               the ppm to compress, with no rows 
+ *                                      read yet
+ *      FILE *output                    where to write the compressed image
+ *      compress40_context context      the workers and buffers to use
+ *
+ * Return: N/A
+ *
+ * Expects: stream, output, and context are not NULL, width and height of 
+ *          the ppm are not 1
+ *     
+ * Notes: an odd last column is trimmed by never visiting it, and an odd last
+ *        row by never reading it. With one thread a chunk is a single 
+ *        block-row, so nothing but the two current rows is ever buffered; 
+ *        with n threads it is n bands of BAND block-rows. Does the same work
+ *        as int_parent, float_parent, and codewords_parent.
+ *    -   Reading and writing happen on the calling thread and in order, so
+ *        the output is the same for any number of threads.
+ *      
+ ***********************************************************************/
+static void compress_stream(ppm_stream stream, FILE *output, 
+                            compress40_context context)
+{
+        assert(stream != NULL);
+        assert(output != NULL);
+        assert(context != NULL);
+        assert(stream->height - 1 != 0 && stream->width - 1 != 0);
+        unsigned width = stream->width - stream->width % HALF;
+        unsigned height = stream->height - stream->height % HALF;
+        unsigned max_rows = chunk_rows(context);
+
+        struct compress_chunk chunk;
+        chunk.width = width;
+        chunk.denom = stream->denominator;
+        chunk.fixed = fixed_point;
+        if (fixed_point) {
+                chunk.color = fixed_color_new(stream->denominator);
+        }
+        chunk.table = (use_tables && !fixed_point) 
+                      ? context_table(context, stream->denominator) : NULL;
+        chunk.band = (context->threads == 1) ? 1 : BAND;
+        chunk.stride = stream->width;
+        /* raw rows with one byte per sample are converted straight from the
+           bytes, which are copied only if the input isn't mapped. Anything 
+           else is unpacked into Pnm_rgb's first */
+        chunk.bytes = !stream->plain && stream->denominator <= DENOM;
+        unsigned char *copies = NULL;
+        chunk.raw = NULL;
+        chunk.pixels = NULL;
+        if (chunk.bytes) {
+                context->raw = grow(context->raw, &context->raw_size, 
+                                    (size_t)HALF * max_rows * 
+                                    sizeof(*chunk.raw));
+                chunk.raw = context->raw;
+                if (!source_mapped(stream->input)) {
+                        context->bytes = grow(context->bytes, 
+                                              &context->bytes_size,
+                                              (size_t)HALF * max_rows * 
+                                              stream->row_bytes);
+                        copies = context->bytes;
+                }
+        } else {
+                context->pixels = grow(context->pixels, 
+                                       &context->pixels_size,
+                                       (size_t)HALF * max_rows * 
+                                       chunk.stride * sizeof(struct Pnm_rgb));
+                chunk.pixels = context->pixels;
+        }
+        context->codewords = grow(context->codewords, 
+                                  &context->codewords_size,
+                                  (size_t)max_rows * (width / HALF) * 
+                                  sizeof(uint32_t));
+        chunk.codewords = context->codewords;
+        chunk.scratch = context_scratch(context, width);
+
+        fprintf(output, "COMP40 Compressed image format 2\n%u %u\n", 
+                width, height);
+        for (unsigned row = 0; row < height / HALF; row += chunk.rows) {
+                chunk.rows = height / HALF - row;
+                if (chunk.rows > max_rows) {
+                        chunk.rows = max_rows;
+                }
+                read_chunk(stream, &chunk, copies);
+                workers_run(context->pool, 
+                            (chunk.rows + chunk.band - 1) / chunk.band,
+                            compress_band, &chunk);
+                /* the chunk's rows are done with */
+                source_release(stream->input);
+                write_codeword_row(chunk.codewords, 
+                                   (size_t)chunk.rows * (width / HALF), 
+                                   output);
+                if (ferror(output)) {
+                        return;         /* for the caller to report */
+                }
+        }
+}
+
+/********** read_chunk *****************************************************
+ *
+ * This function reads the rows of the next chunk of the ppm.
+ *
+ * Parameters:
+ *      ppm_stream stream               the ppm being read
+ *      struct compress_chunk *chunk    the chunk, with rows set
+ *      unsigned char *copies           where to copy raw rows to, or NULL
+ *                                      if the input is mapped
+ *
+ * Return: N/A
+ *
+ * Expects: stream and chunk are not NULL, the ppm has 2 * chunk->rows rows
+ *          left
+ *     
+ * Notes: could raise Pnm_Badformat (see ppmio.h). Raw rows from a mapped 
+ *        input are not copied at all, since pointers into the mapping stay 
+ *        good.
+ *      
+ ***********************************************************************/
+static void read_chunk(ppm_stream stream, struct compress_chunk *chunk, 
+                       unsigned char *copies)
+{
+        for (unsigned row = 0; row < HALF * chunk->rows; row++) {
+                if (!chunk->bytes) {
+                        ppm_stream_read_row(stream, chunk->pixels + 
+                                            (size_t)row * chunk->stride);
+                        continue;
+                }
+                const unsigned char *raw = ppm_stream_read_bytes(stream);
+                if (copies != NULL) {
+                        unsigned char *copy = copies + row * 
+                                              stream->row_bytes;
+                        memcpy(copy, raw, stream->row_bytes);
+                        raw = copy;
+                }
+                chunk->raw[row] = raw;
+        }
+}
+
+/********** compress_band **************************************************
+ *
+ * This function compresses one band of block-rows of a chunk. It is the job
+ * run by the workers (see workers.h).
+ *
+ * Parameters:
+ *      int band                which band of the chunk to compress
+ *      unsigned worker         which worker is running the job
+ *      void *cl                the struct compress_chunk
+ *
+ * Return: N/A
+ *
+ * Expects: cl is not NULL
+ *     
+ * Notes: only writes the band's codewords and the worker's scratch, so 
+ *        bands can run at the same time. Compression
+ *      
+ ***********************************************************************/
+static void compress_band(int band, unsigned worker, void *cl)
+{
+        struct compress_chunk *chunk = cl;
+        struct scratch *scratch = &chunk->scratch[worker];
+        unsigned blocks = chunk->width / HALF;
+        unsigned first = band * chunk->band;
+        unsigned last = first + chunk->band;
+        if (last > chunk->rows) {
+                last = chunk->rows;
+        }
+        for (unsigned row = first; row < last; row++) {
+                if (chunk->fixed) {
+                        row_to_fixed(chunk, HALF * row, scratch->fixed_top);
+                        row_to_fixed(chunk, HALF * row + 1, 
+                                     scratch->fixed_bottom);
+                        fixed_block_row_DCT(scratch->fixed_top, 
+                                            scratch->fixed_bottom, blocks, 
+                                            scratch->elems);
+                        uint32_t *codewords = chunk->codewords + 
+                                              (size_t)row * blocks;
+                        for (unsigned i = 0; i < blocks; i++) {
+                                codewords[i] = pack_codeword(
+                                               scratch->elems[i]);
+                        }
+                        continue;
+                }
+                row_to_comp(chunk, HALF * row, scratch->top);
+                row_to_comp(chunk, HALF * row + 1, scratch->bottom);
+                compress_row_pair(scratch->top, scratch->bottom, chunk->width,
+                                  scratch->elems, 
+                                  chunk->codewords + (size_t)row * blocks);
+        }
+}
+
+/********** row_to_comp ****************************************************
+ *
+ * This function converts the first width pixels of one row of a chunk to 
+ * comp video.
+ *
+ * Parameters:
+ *      struct compress_chunk *chunk    the chunk
+ *      unsigned row                    which of its rows to convert
+ *      comp_row comp                   where to put the comp video values
+ *
+ * Return: N/A
+ *
+ * Expects: chunk is not NULL, comp holds chunk->width pixels
+ *     
+ * Notes: Compression
+ *      
+ ***********************************************************************/
+static void row_to_comp(struct compress_chunk *chunk, unsigned row, 
+                        comp_row comp)
+{
+        if (chunk->table != NULL) {
+                if (chunk->bytes) {
+                        table_rgb8_row_to_comp(chunk->table, chunk->raw[row],
+                                               chunk->width, comp);
+                } else {
+                        table_row_to_comp(chunk->table, 
+                                          chunk->pixels + row * chunk->stride,
+                                          chunk->width, comp);
+                }
+        } else if (chunk->bytes) {
+                rgb8_row_to_comp(chunk->raw[row], chunk->width, chunk->denom,
+                                 comp);
+        } else {
+                rgb_row_to_comp(chunk->pixels + row * chunk->stride, 
+                                chunk->width, chunk->denom, comp);
+        }
+}
+
+/********** row_to_fixed ***************************************************
+ *
+ * This function converts the first width pixels of one row of a chunk to 
+ * fixed-point comp video.
+ *
+ * Parameters:
+ *      struct compress_chunk *chunk    the chunk
+ *      unsigned row                    which of its rows to convert
+ *      fixed_row comp                  where to put the comp video values
+ *
+ * Return: N/A
+ *
+ * Expects: chunk is not NULL, comp holds chunk->width pixels
+ *     
+ * Notes: Compression
+ *      
+ ***********************************************************************/
+static void row_to_fixed(struct compress_chunk *chunk, unsigned row, 
+                         fixed_row comp)
+{
+        if (chunk->bytes) {
+                fixed_rgb8_row_to_comp(chunk->raw[row], chunk->width, 
+                                       &chunk->color, comp);
+        } else {
+                fixed_rgb_row_to_comp(chunk->pixels + row * chunk->stride, 
+                                      chunk->width, &chunk->color, comp);
+        }
+}
+
+/********** compress_row_pair **********************************************
+ *
+ * This function compresses two rows of comp video pixels into one row of 
+ * codewords. The whole row of 2-by-2 blocks goes through the DCT, 
+ * quantization, and scaling at once (block_row_DCT), then each block's 
+ * codeword is packed.
+ *
+ * Parameters:
+ *      comp_row top            the upper row of pixels
+ *      comp_row bottom         the lower row of pixels
+ *      unsigned width          number of pixels to use from each row (even)
+ *      scaled_dct *elems       buffer for the row of scaled DCT values, must
+ *                              hold width / 2 of them
+ *      uint32_t *codewords     where to put the row of codewords, must hold
+ *                              width / 2 codewords
+ *
+ * Return: N/A
+ *
+ * Expects: elems and codewords are not NULL
+ *     
+ * Notes: Compression
+ *      
+ ***********************************************************************/
+static void compress_row_pair(comp_row top, comp_row bottom, unsigned width,
+                              scaled_dct *elems, uint32_t *codewords)
+{
+        unsigned blocks = width / HALF;
+        block_row_DCT(top, bottom, blocks, elems);
+        for (unsigned i = 0; i < blocks; i++) {
+                codewords[i] = pack_codeword(elems[i]);
+        }
 }
 
 /********** decompress40 ****************************************************
  *
- * This function handles decompression. It calls on functions in external 
- * helper files (int, float, and codewords), which read in a file containing 
- * binary codewords and turn it into a ppm with rgb values. Resulting 
- * decompressed file is printed to standard output.
+ * This function handles decompression. It wraps the input in a source and 
+ * hands it to decompress_source, which uses the per-codeword and per-block 
+ * helpers in external files (int, float, and codewords) to turn the binary 
+ * codewords into rgb values. Resulting decompressed file is printed to 
+ * standard output.
  *
  * Parameters:
  *      FILE *input             a file pointer to read the information from
@@ -93,8 +719,593 @@ extern void compress40(FILE *input)
  ***********************************************************************/
 extern void decompress40(FILE *input) 
 {
-        A2Methods_T methods = uarray2_methods_plain;
+        compress40_context context = compress40_context_new(threads);
+        if (staged_methods != NULL) {
+                decompress_staged(input, stdout, context);
+                compress40_context_free(&context);
+                return;
+        }
+
+        source src = source_new(input);
+
+        decompress_source(src, stdout, context);
+
+        compress40_context_free(&context);
+        source_free(&src);
+}
+
+/********** decompress40_file **********************************************
+ *
+ * This function decompresses the named compressed file to standard output. 
+ * See decompress40_path.
+ *
+ * Parameters:
+ *      const char *path        name of the compressed file
+ *
+ * Return: N/A
+ *
+ * Expects: path is not NULL and names a readable compressed file
+ *     
+ * Notes: uses the number of threads set by compress40_threads
+ *      
+ ***********************************************************************/
+extern void decompress40_file(const char *path)
+{
+        compress40_context context = compress40_context_new(threads);
+
+        decompress40_path(path, stdout, context);
+
+        compress40_context_free(&context);
+}
+
+/********** decompress40_path **********************************************
+ *
+ * This function decompresses the named compressed file. If the file can be 
+ * mapped into memory, the codewords are read straight from the mapping. 
+ * Otherwise the file is opened and read with stdio.
+ *
+ * Parameters:
+ *      const char *path                name of the compressed file
+ *      FILE *output                    where to write the decompressed ppm
+ *      compress40_context context      the workers and buffers to use
+ *
+ * Return: N/A
+ *
+ * Expects: path, output, and context are not NULL, and path names a readable
+ *          compressed file
+ *     
+ * Notes: see decompress40 and compress40_path
+ *      
+ ***********************************************************************/
+extern void decompress40_path(const char *path, FILE *output, 
+                              compress40_context context)
+{
+        assert(path != NULL);
+        if (staged_methods != NULL) {
+                FILE *fp = fopen(path, "r");
+                assert(fp != NULL);
+                decompress_staged(fp, output, context);
+                fclose(fp);
+                return;
+        }
+        source src = source_map(path);
+        FILE *fp = NULL;
+        if (src == NULL) {
+                fp = fopen(path, "r");
+                assert(fp != NULL);
+                src = source_new(fp);
+        }
+
+        decompress_source(src, output, context);
+
+        source_free(&src);
+        if (fp != NULL) {
+                fclose(fp);
+        }
+}
+
+/********** decompress_source **********************************************
+ *
+ * This function reads the header of a compressed image from the given source
+ * and hands the rest of it to decompress_rows.
+ *
+ * Parameters:
+ *      source input                    where to read the compressed image
+ *                                      from
+ *      FILE *output                    where to write the decompressed ppm
+ *      compress40_context context      the workers and buffers to use
+ *
+ * Return: N/A
+ *
+ * Expects: input and output are not NULL, input starts with a valid header
+ *     
+ * Notes: does not free input
+ *      
+ ***********************************************************************/
+static void decompress_source(source input, FILE *output, 
+                              compress40_context context)
+{
         /* getting header information from input */
+        const char *magic = "COMP40 Compressed image format 2";
+        for (size_t i = 0; i < strlen(magic); i++) {
+                int c = source_getc(input);
+                assert(c == magic[i]);
+        }
+        bool read_width, read_height;
+        unsigned width = source_read_unsigned(input, &read_width);
+        unsigned height = source_read_unsigned(input, &read_height);
+        assert(read_width && read_height);
+        int c = source_getc(input);
+        assert(c == '\n');
+
+        decompress_rows(input, width, height, output, context);
+}
+
+/********** decompress_rows ************************************************
+ *
+ * This function is the fused decompression pipeline. It reads the codewords
+ * a chunk of rows at a time and has the workers unpack each codeword, undo
+ * the scaling and the DCT for each row of blocks, and convert the resulting
+ * pixels to rgb values. Each row of codewords becomes two finished rows of 
+ * the ppm, and the chunk's rows are written out before the next chunk is 
+ * read.
+ *
+ * Parameters:
+ *      source input            where to read the codewords from, positioned
+ *                              just after the header
+ *      unsigned width          width of the image, from the header
+ *      unsigned height         height of the image, from the header
+ *      FILE *output            where to write the decompressed ppm
+ *      compress40_context context      the workers and buffers to use
+ *
+ * Return: N/A
+ *
+ * Expects: input, output, and context are not NULL
+ *     
+ * Notes: with one thread only two rows of pixels are ever held in memory, no
+ *        matter how big the image is; with n threads, n bands of BAND 
+ *        block-rows. Writes a raw ppm with a denominator of 255, the same 
+ *        as Pnm_ppmwrite would. Could raise File_Too_Short (see 
+ *        codewords.h). Stops at the first chunk that can't all be written,
+ *        leaving output's error flag set for the caller to report. Does the
+ *        same work as codewords_parent, float_parent, and int_parent.
+ *    -   The inverse DCT and the conversion to rgb each work on a whole row
+ *        at a time (see block_row_inverse_DCT in float.h and 
+ *        comp_row_to_rgb8 in int.h).
+ *      
+ ***********************************************************************/
+static void decompress_rows(source input, unsigned width, unsigned height,
+                            FILE *output, compress40_context context)
+{
+        assert(input != NULL);
+        assert(output != NULL);
+        assert(context != NULL);
+        width = width / HALF * HALF;
+        height = height / HALF * HALF;
+        unsigned max_rows = chunk_rows(context);
+        unsigned blocks = width / HALF;
+
+        struct decompress_chunk chunk;
+        chunk.width = width;
+        chunk.fixed = fixed_point;
+        chunk.table = NULL;
+        if (use_tables && !fixed_point) {
+                if (context->decoder == NULL) {
+                        context->decoder = block_table_new(DENOM);
+                }
+                chunk.table = context->decoder;
+        }
+        chunk.band = (context->threads == 1) ? 1 : BAND;
+        /* one byte per channel, since DENOM fits in a byte */
+        context->bytes = grow(context->bytes, &context->bytes_size, 
+                              (size_t)HALF * max_rows * 3 * width);
+        chunk.pixels = context->bytes;
+        context->codewords = grow(context->codewords, 
+                                  &context->codewords_size,
+                                  (size_t)max_rows * blocks * 
+                                  sizeof(uint32_t));
+        chunk.codewords = context->codewords;
+        chunk.scratch = context_scratch(context, width);
+
+        fprintf(output, "P6\n%u %u\n%u\n", width, height, DENOM);
+        for (unsigned row = 0; row < height / HALF; row += chunk.rows) {
+                chunk.rows = height / HALF - row;
+                if (chunk.rows > max_rows) {
+                        chunk.rows = max_rows;
+                }
+                read_codeword_row(chunk.codewords, 
+                                  (size_t)chunk.rows * blocks, input);
+                source_release(input);
+                workers_run(context->pool, 
+                            (chunk.rows + chunk.band - 1) / chunk.band,
+                            decompress_band, &chunk);
+                size_t bytes = (size_t)HALF * chunk.rows * 3 * width;
+                if (fwrite(chunk.pixels, 1, bytes, output) != bytes) {
+                        return;         /* output's error flag is set */
+                }
+        }
+}
+
+/********** decompress_band ************************************************
+ *
+ * This function decompresses one band of block-rows of a chunk. It is the 
+ * job run by the workers (see workers.h).
+ *
+ * Parameters:
+ *      int band                which band of the chunk to decompress
+ *      unsigned worker         which worker is running the job
+ *      void *cl                the struct decompress_chunk
+ *
+ * Return: N/A
+ *
+ * Expects: cl is not NULL
+ *     
+ * Notes: only writes the band's rows of pixels and the worker's scratch, so
+ *        bands can run at the same time. Decompression
+ *      
+ ***********************************************************************/
+static void decompress_band(int band, unsigned worker, void *cl)
+{
+        struct decompress_chunk *chunk = cl;
+        struct scratch *scratch = &chunk->scratch[worker];
+        unsigned blocks = chunk->width / HALF;
+        size_t row_bytes = 3 * (size_t)chunk->width;
+        unsigned first = band * chunk->band;
+        unsigned last = first + chunk->band;
+        if (last > chunk->rows) {
+                last = chunk->rows;
+        }
+        for (unsigned row = first; row < last; row++) {
+                const uint32_t *codewords = chunk->codewords + 
+                                            (size_t)row * blocks;
+                unsigned char *top = chunk->pixels + HALF * row * row_bytes;
+                if (chunk->table != NULL) {
+                        block_table_row(chunk->table, codewords, blocks, top,
+                                        top + row_bytes);
+                        continue;
+                }
+                for (unsigned i = 0; i < blocks; i++) {
+                        scratch->elems[i] = unpack_codeword(codewords[i]);
+                }
+                if (chunk->fixed) {
+                        fixed_block_row_inverse_DCT(scratch->elems, blocks, 
+                                                    scratch->fixed_top,
+                                                    scratch->fixed_bottom);
+                        fixed_comp_row_to_rgb8(scratch->fixed_top, 
+                                               chunk->width, top);
+                        fixed_comp_row_to_rgb8(scratch->fixed_bottom, 
+                                               chunk->width, 
+                                               top + row_bytes);
+                        continue;
+                }
+                block_row_inverse_DCT(scratch->elems, blocks, scratch->top,
+                                      scratch->bottom);
+                comp_row_to_rgb8(scratch->top, chunk->width, DENOM, top);
+                comp_row_to_rgb8(scratch->bottom, chunk->width, DENOM, 
+                                 top + row_bytes);
+        }
+}
+
+/********** compress40_context_new *****************************************
+ *
+ * This function makes a context for compressing or decompressing with the 
+ * given number of threads. Its buffers start out empty and grow to fit the
+ * images they are used for.
+ *
+ * Parameters:
+ *      unsigned n              number of threads
+ *
+ * Return: the new context
+ *
+ * Expects: n is at least 1
+ *     
+ * Notes: starts n - 1 threads (see workers.h). A context must only be used 
+ *        by one call at a time, and must be freed with 
+ *        compress40_context_free.
+ *      
+ ***********************************************************************/
+extern compress40_context compress40_context_new(unsigned n)
+{
+        assert(n >= 1);
+        compress40_context context;
+        NEW(context);
+        context->threads = n;
+        context->pool = workers_new(n);
+        context->scratch = NULL;
+        context->scratch_width = 0;
+        context->raw = NULL;
+        context->raw_size = 0;
+        context->bytes = NULL;
+        context->bytes_size = 0;
+        context->pixels = NULL;
+        context->pixels_size = 0;
+        context->codewords = NULL;
+        context->codewords_size = 0;
+        context->arena = job_arena_new();
+        context->table = NULL;
+        context->decoder = NULL;
+        return context;
+}
+
+/********** compress40_context_free ****************************************
+ *
+ * This function stops a context's threads and frees it and its buffers.
+ *
+ * Parameters:
+ *      compress40_context *context     pointer to the context to free
+ *
+ * Return: N/A
+ *
+ * Expects: context and *context are not NULL
+ *     
+ * Notes: sets *context to NULL
+ *      
+ ***********************************************************************/
+extern void compress40_context_free(compress40_context *context)
+{
+        assert(context != NULL && *context != NULL);
+        compress40_context c = *context;
+        workers_free(&c->pool);
+        if (c->scratch != NULL) {
+                scratch_free(&c->scratch, c->threads);
+        }
+        if (c->raw != NULL) {
+                FREE(c->raw);
+        }
+        if (c->bytes != NULL) {
+                FREE(c->bytes);
+        }
+        if (c->pixels != NULL) {
+                FREE(c->pixels);
+        }
+        if (c->codewords != NULL) {
+                FREE(c->codewords);
+        }
+        job_arena_free(&c->arena);
+        if (c->table != NULL) {
+                comp_table_free(&c->table);
+        }
+        if (c->decoder != NULL) {
+                block_table_free(&c->decoder);
+        }
+        FREE(*context);
+}
+
+/********** context_scratch ************************************************
+ *
+ * This function gives a context's per-thread scratch buffers, making new 
+ * ones if the current ones are too small for rows of the given width.
+ *
+ * Parameters:
+ *      compress40_context context      the context
+ *      unsigned width                  pixels in each row
+ *
+ * Return: an array with one scratch for each thread
+ *
+ * Expects: context is not NULL
+ *     
+ * Notes: 
+ *      
+ ***********************************************************************/
+static struct scratch *context_scratch(compress40_context context, 
+                                       unsigned width)
+{
+        if (context->scratch == NULL || width > context->scratch_width) {
+                if (context->scratch != NULL) {
+                        scratch_free(&context->scratch, context->threads);
+                }
+                context->scratch = scratch_new(context->threads, width);
+                context->scratch_width = width;
+        }
+        return context->scratch;
+}
+
+/********** context_table **************************************************
+ *
+ * This function returns a context's lookup tables for a denominator, 
+ * building them only if the context's tables are for another one.
+ *
+ * Parameters:
+ *      compress40_context context      the context
+ *      unsigned denom                  the denominator
+ *
+ * Return: the tables
+ *
+ * Expects: context is not NULL, denom is not 0
+ *     
+ * Notes: only the last denominator's tables are kept
+ *      
+ ***********************************************************************/
+static comp_table context_table(compress40_context context, unsigned denom)
+{
+        if (context->table != NULL && 
+            comp_table_denom(context->table) != denom) {
+                comp_table_free(&context->table);
+        }
+        if (context->table == NULL) {
+                context->table = comp_table_new(denom);
+        }
+        return context->table;
+}
+
+/********** grow ***********************************************************
+ *
+ * This function makes sure a buffer holds at least need bytes.
+ *
+ * Parameters:
+ *      void *buffer            the buffer, or NULL if there isn't one yet
+ *      size_t *size            the buffer's size in bytes, updated if the 
+ *                              buffer is replaced
+ *      size_t need             the number of bytes needed
+ *
+ * Return: the buffer to use from now on
+ *
+ * Expects: size is not NULL
+ *     
+ * Notes: the contents are not kept when the buffer is replaced. Always 
+ *        allocates at least one byte, since ALLOC doesn't allow 0.
+ *      
+ ***********************************************************************/
+static void *grow(void *buffer, size_t *size, size_t need)
+{
+        assert(size != NULL);
+        if (buffer != NULL && need <= *size) {
+                return buffer;
+        }
+        if (buffer != NULL) {
+                FREE(buffer);
+        }
+        *size = need + 1;
+        return ALLOC(*size);
+}
+
+/********** scratch_new ****************************************************
+ *
+ * This function allocates the buffers each worker needs to work on rows of
+ * the given width.
+ *
+ * Parameters:
+ *      unsigned count          number of workers
+ *      unsigned width          pixels in each row
+ *
+ * Return: an array of count scratch buffers
+ *
+ * Expects: count is at least 1
+ *     
+ * Notes: allocated here, on the calling thread, once for all the jobs, so
+ *        the workers never allocate. Must be freed with scratch_free.
+ *      
+ ***********************************************************************/
+static struct scratch *scratch_new(unsigned count, unsigned width)
+{
+        struct scratch *scratch = ALLOC(count * sizeof(struct scratch));
+        for (unsigned i = 0; i < count; i++) {
+                scratch[i].top = comp_row_new(width);
+                scratch[i].bottom = comp_row_new(width);
+                scratch[i].fixed_top = fixed_row_new(width);
+                scratch[i].fixed_bottom = fixed_row_new(width);
+                scratch[i].elems = ALLOC((width / HALF + 1) * 
+                                         sizeof(scaled_dct));
+        }
+        return scratch;
+}
+
+/********** scratch_free ***************************************************
+ *
+ * This function frees buffers made by scratch_new.
+ *
+ * Parameters:
+ *      struct scratch **scratch        pointer to the array of buffers
+ *      unsigned count                  number of workers
+ *
+ * Return: N/A
+ *
+ * Expects: scratch and *scratch are not NULL
+ *     
+ * Notes: sets *scratch to NULL
+ *      
+ ***********************************************************************/
+static void scratch_free(struct scratch **scratch, unsigned count)
+{
+        assert(scratch != NULL && *scratch != NULL);
+        for (unsigned i = 0; i < count; i++) {
+                comp_row_free(&(*scratch)[i].top);
+                comp_row_free(&(*scratch)[i].bottom);
+                fixed_row_free(&(*scratch)[i].fixed_top);
+                fixed_row_free(&(*scratch)[i].fixed_bottom);
+                FREE((*scratch)[i].elems);
+        }
+        FREE(*scratch);
+}
+
+/********** chunk_rows *****************************************************
+ *
+ * This function gives the most block-rows to read at a time.
+ *
+ * Parameters:
+ *      compress40_context context      the workers and buffers being used
+ *
+ * Return: 1 for a single thread, otherwise a band of BAND block-rows for 
+ *         each thread
+ *     
+ * Expects: N/A
+ *     
+ * Notes: 
+ *      
+ ***********************************************************************/
+static unsigned chunk_rows(compress40_context context)
+{
+        return (context->threads == 1) ? 1 : context->threads * BAND;
+}
+
+/********** compress_staged ************************************************
+ *
+ * This function is the staged compression pipeline. It reads the whole ppm
+ * into an array made by the methods set with compress40_methods, then runs 
+ * it through int_parent, float_parent, and codewords_parent, which prints 
+ * the codewords to output.
+ *
+ * Parameters:
+ *      FILE *input                     where to read the ppm from
+ *      FILE *output                    where to write the compressed image
+ *      compress40_context context      the arena to make the arrays in
+ *
+ * Return: N/A
+ *
+ * Expects: input, output, and context are not NULL, and staged_methods is
+ *          set
+ *     
+ * Notes: see compress40_methods. Every array, including the ppm's, is made 
+ *        in context's arena, which is reset once the image is done. The 
+ *        ppm is read with ppm_read, so 8-bit pixels stay packed.
+ *      
+ ***********************************************************************/
+static void compress_staged(FILE *input, FILE *output, 
+                            compress40_context context)
+{
+        assert(input != NULL && output != NULL && context != NULL);
+        assert(staged_methods != NULL);
+        job_arena_use(context->arena);
+        Pnm_ppm my_ppm = ppm_read(input, staged_methods);
+        comp_table table = use_tables 
+                           ? context_table(context, my_ppm->denominator) 
+                           : NULL;
+
+        my_ppm = int_parent(my_ppm, true, table);
+        my_ppm = float_parent(my_ppm, true);
+        my_ppm = codewords_parent(my_ppm, true, output);
+
+        Pnm_ppmfree(&my_ppm);
+        job_arena_use(NULL);
+        job_arena_reset(context->arena);
+}
+
+/********** decompress_staged **********************************************
+ *
+ * This function is the staged decompression pipeline. It reads the header,
+ * then has codewords_parent, float_parent, and int_parent turn the codewords
+ * into a ppm held in arrays made by the methods set with compress40_methods,
+ * and prints the ppm to output.
+ *
+ * Parameters:
+ *      FILE *input                     where to read the codewords from
+ *      FILE *output                    where to write the decompressed ppm
+ *      compress40_context context      the arena to make the arrays in
+ *
+ * Return: N/A
+ *
+ * Expects: input, output, and context are not NULL, staged_methods is set,
+ *          and input holds a compressed image
+ *     
+ * Notes: see compress_staged
+ *      
+ ***********************************************************************/
+static void decompress_staged(FILE *input, FILE *output, 
+                              compress40_context context)
+{
+        assert(input != NULL && output != NULL && context != NULL);
+        assert(staged_methods != NULL);
+        A2Methods_T methods = staged_methods;
         unsigned height, width;
         int read = fscanf(input, "COMP40 Compressed image format 2\n%u %u", 
                           &width, &height);
@@ -102,9 +1313,10 @@ extern void decompress40(FILE *input)
         int c = getc(input);
         assert(c == '\n');
 
-        /* intiialize ppm with empty array filled in decompression functions */
+        job_arena_use(context->arena);
+        /* initialize ppm with empty array filled in decompression functions */
         A2 new_array = methods->new(width / HALF, height / HALF, 
-                                    sizeof(uint64_t));
+                                    sizeof(uint32_t));
 
         Pnm_ppm my_ppm = ALLOC(sizeof(struct Pnm_ppm));
         my_ppm->width = width / HALF;
@@ -115,10 +1327,12 @@ extern void decompress40(FILE *input)
 
         my_ppm = codewords_parent(my_ppm, false, input);
         my_ppm = float_parent(my_ppm, false);
-        my_ppm = int_parent(my_ppm, false);
+        my_ppm = int_parent(my_ppm, false, NULL);
 
-        Pnm_ppmwrite(stdout, my_ppm);
+        ppm_write(output, my_ppm);
         Pnm_ppmfree(&my_ppm);
+        job_arena_use(NULL);
+        job_arena_reset(context->arena);
 }
 
 #undef A2
\ No newline at end of file
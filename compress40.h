@@ -11,7 +11,60 @@
  *
  *************************************************************************/
 
+#ifndef COMPRESS40_INCLUDED
+#define COMPRESS40_INCLUDED
 #include <stdio.h>
+#include <stdbool.h>
+#include "a2methods.h"
 
 extern void compress40  (FILE *input);  /* reads PPM, writes compressed image */
-extern void decompress40(FILE *input);  /* reads compressed image, writes PPM */
\ No newline at end of file
+extern void decompress40(FILE *input);  /* reads compressed image, writes PPM */
+
+/* same as above, but map the named file into memory when possible */
+extern void compress40_file  (const char *path);
+extern void decompress40_file(const char *path);
+
+/* use n threads (default 1) for all of the above; the output doesn't change */
+extern void compress40_threads(unsigned n);
+
+/* 
+ * run the whole image through int_parent, float_parent, and codewords_parent
+ * with arrays made by methods, instead of streaming it; NULL (the default) 
+ * goes back to streaming. Threads are not used by the staged pipeline, and
+ * its arrays are made in the context's arena, which is reset (not freed) 
+ * after every image.
+ */
+extern void compress40_methods(A2Methods_T methods);
+
+/* 
+ * stream with the fixed-point kernels (true) instead of floating point 
+ * (false, the default); fixed point makes the same codewords on every 
+ * machine and compiler. The staged pipeline always uses floating point.
+ */
+extern void compress40_fixed(bool on);
+
+/* 
+ * convert rgb to comp video, and streamed codewords to rgb, with lookup 
+ * tables built once per context and denominator (true) instead of doing 
+ * the arithmetic for every pixel (false, the default). Compressing, the 
+ * tables' results are exactly the arithmetic's; decompressing, rgb values 
+ * can differ by 1. Not used with fixed point.
+ */
+extern void compress40_tables(bool on);
+
+/* 
+ * The threads and buffers used for one image at a time. Keeping a context
+ * around lets many images be done without allocating for each one.
+ */
+typedef struct compress40_context *compress40_context;
+
+extern compress40_context compress40_context_new(unsigned threads);
+extern void compress40_context_free(compress40_context *context);
+
+/* same as the _file versions, but write to output using context */
+extern void compress40_path  (const char *path, FILE *output, 
+                              compress40_context context);
+extern void decompress40_path(const char *path, FILE *output, 
+                              compress40_context context);
+
+#endif
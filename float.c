@@ -14,20 +14,25 @@
  *************************************************************************/
 
 /* includes */
-#include "float.h"   jgfcvb
+#include "float.h"
 #include "a2methods.h"
 #include "uarray2.h"
+#include "uarray2rows.h"
 #include "a2plain.h"
 #include "a2blocked.h"
 #include "assert.h"
-#include "arith40.h"
+#include "chroma.h"
 #include <math.h>
 
+/* vector kernels are built for x86 and picked at runtime (see below) */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FLOAT_SIMD 1
+#include <immintrin.h>
+#endif
+
 typedef A2Methods_UArray2 A2;
-typedef struct comp_v comp_v;
 typedef struct array_methods array_methods;
 typedef struct dct_values dct_values;
-typedef struct scaled_dct scaled_dct;
 
 const float BLK = 4.0;
 const float HBLK = 2.0;
@@ -35,10 +40,15 @@ const int SFBCD = 50;
 const int SFA = 511;
 const float UPBND = .3;
 const float LWBND = -.3;
-
-struct comp_v {
-        float y, pB, pR;
-};
+/* SFA and SFBCD for fixed_mulhi on a sum of four values in units of 
+   1 / FIXED_ONE (511 * 4 and 50 * 4), and the largest scaled b, c, or d */
+const unsigned FIXED_SFA = 2044;
+const unsigned FIXED_SFBCD = 200;
+const int FIXED_BCD = 15;
+/* FIXED_ONE / SFA and FIXED_ONE / SFBCD for fixed_mulhrs on 16 * a and on 
+   128 * b, c, or d */
+const int UNSCALE_A = 16416;
+const int UNSCALE_BCD = 20972;
 
 /* structure used to pass second array and methods to apply functions */
 struct array_methods {
@@ -51,10 +61,24 @@ struct dct_values {
         unsigned pB, pR;
 };
 
-struct scaled_dct {
-        unsigned a, pB, pR;
-        signed b, c, d;
-};
+/* 
+ * DCT_planes keeps each field of dct_values in a plane of its own (see 
+ * UArray2_new_planes in uarray2rows.h), in this order; the fields are all 
+ * 4 bytes, so the planes share one array
+ */
+enum { DCT_A, DCT_B, DCT_C, DCT_D, DCT_PB, DCT_PR, DCT_PLANES };
+
+static dct_values block_values(comp_v e1, comp_v e2, comp_v e3, comp_v e4);
+static void apply_DCT(int col, int row, A2 array, void *elem, void *cl);
+static void apply_inverse_DCT(int col, int row, A2 array, void *elem, 
+                              void *cl);
+static scaled_dct scale_values(dct_values og_elem);
+static void DCT_plane_rows(A2 comp, A2 dct, int width, int height);
+static void scale_plane_rows(A2 dct, A2 scaled, int width, int height);
+static void inverse_DCT_plane_rows(A2 scaled, A2 comp, int width, 
+                                   int height);
+static void map_blocks(A2 array, A2Methods_T methods, A2Methods_applyfun apply,
+                       void *cl);
 
 /********** float_parent **************************************************
  *
@@ -76,14 +100,26 @@ struct scaled_dct {
  * Expects: my_ppm is not NULL
  *     
  * Notes:  
+ *      Every new array is made with the ppm's own methods, unless the 
+ *      arrays are planar: comp video planes (from to_comp_planes) go 
+ *      through DCT_planes and change_scale_planes, and scaled values in a 
+ *      row-major UArray2 are turned into comp video planes by 
+ *      inverse_DCT_planes.
  *      Because pB's and pR's within 2-by-2 blocks of pixels were averaged,
  *      the original pB and pR values cannot be recovered during decompression.
  *      
  ***********************************************************************/
 Pnm_ppm float_parent(Pnm_ppm my_ppm, bool compress)
 {
-        A2Methods_T methods = uarray2_methods_plain;
-        if (compress) {
+        A2Methods_T methods = my_ppm->methods;
+        bool plain = uarray2_methods_is_plain(methods);
+        if (compress && plain && UArray2_planes(my_ppm->pixels) > 0) {
+                my_ppm->pixels = DCT_planes(my_ppm, my_ppm->width, 
+                                            my_ppm->height);
+                my_ppm->height = my_ppm->height / HBLK;
+                my_ppm->width = my_ppm->width / HBLK;
+                my_ppm = change_scale_planes(my_ppm);
+        } else if (compress) {
                 my_ppm->pixels = DCT(my_ppm, methods, my_ppm->width, 
                                      my_ppm->height);
                 /* adjust struct members of my_ppm */
@@ -91,8 +127,15 @@ Pnm_ppm float_parent(Pnm_ppm my_ppm, bool compress)
                 my_ppm->width = my_ppm->width / HBLK;
                 my_ppm = change_scale(my_ppm, methods);
         } else {
-                my_ppm->pixels = inverse_DCT(my_ppm, methods, my_ppm->width, 
-                                          my_ppm->height);
+                if (plain && UArray2_row_major(my_ppm->pixels)) {
+                        my_ppm->pixels = inverse_DCT_planes(my_ppm, 
+                                                            my_ppm->width,
+                                                            my_ppm->height);
+                } else {
+                        my_ppm->pixels = inverse_DCT(my_ppm, methods, 
+                                                     my_ppm->width, 
+                                                     my_ppm->height);
+                }
                 my_ppm->width = my_ppm->width * HBLK;
                 my_ppm->height = my_ppm->height * HBLK;
         }
@@ -119,6 +162,9 @@ Pnm_ppm float_parent(Pnm_ppm my_ppm, bool compress)
  * Notes:  
  *      Because pB's and pR's within 2-by-2 blocks of pixels were averaged,
  *      the original pB and pR values cannot be recovered during decompression.
+ *      Maps over the new array in block-major order (see map_blocks), so 
+ *      the pixels each step reads are next to the ones the step before 
+ *      read.
  *      
  ***********************************************************************/
 A2 DCT(Pnm_ppm my_ppm, A2Methods_T methods, int width, int height)
@@ -129,36 +175,51 @@ A2 DCT(Pnm_ppm my_ppm, A2Methods_T methods, int width, int height)
         A2 array = my_ppm->pixels;
         A2 *new_array = methods->new(width / HBLK, height / HBLK, 
                                      sizeof(struct dct_values));
-        float avg_pB, avg_pR;
-        for (int row = 0; row < height; row += HBLK) {
-                for (int col = 0; col < width; col += HBLK) {
-                        comp_v *e1, *e2, *e3, *e4;
-                        /* getting 2-by-2 block of pixels */
-                        e1 = methods->at(array, col, row);
-                        e2 = methods->at(array, col + 1, row);
-                        e3 = methods->at(array, col, row + 1);
-                        e4 = methods->at(array, col + 1, row + 1);
-                        
-                        avg_pB = (float)((e1->pB + e2->pB + e3->pB + e4->pB) 
-                                          / BLK);
-                        avg_pR = (float)((e1->pR + e2->pR + e3->pR + e4->pR) 
-                                          / BLK); 
-                        dct_values el;
-                        el.a = (float)((e4->y + e3->y + e2->y + e1->y) / BLK);
-                        el.b = (float)((e4->y + e3->y - e2->y - e1->y) / BLK);
-                        el.c = (float)((e4->y - e3->y + e2->y - e1->y) / BLK);
-                        el.d = (float)((e4->y - e3->y - e2->y + e1->y) / BLK);
-                        el.pB = Arith40_index_of_chroma(avg_pB);
-                        el.pR = Arith40_index_of_chroma(avg_pR);
-                        
-                        *(dct_values *)methods->at(new_array, (col / 2), 
-                                                         (row / 2)) = el;
-                }
-        }
+        array_methods a_m;
+        a_m.array = array;
+        a_m.methods = methods;
+        map_blocks(new_array, methods, apply_DCT, &a_m);
         methods->free(&array);
         return new_array;
 }
 
+/********** apply_DCT *****************************************************
+ *
+ * This is the apply function for DCT. It finds the DCT values of the 
+ * 2-by-2 block of pixels that the current element stands for.
+ *
+ * Parameters:
+ *      int col                 the current element's column
+ *      int row                 the current element's row
+ *      A2 array                the array of DCT values
+ *      void *elem              the current element, where the values go
+ *      void *cl                array_methods with the comp video array
+ *
+ * Return: N/A
+ *
+ * Expects: cl not NULL, the comp video array is twice as wide and high
+ *     
+ * Notes: Compression
+ *      
+ ***********************************************************************/
+static void apply_DCT(int col, int row, A2 array, void *elem, void *cl)
+{
+        (void) array;
+        array_methods *a_m = cl;
+        A2 comp = a_m->array;
+        A2Methods_T methods = a_m->methods;
+        int x = col * HBLK;
+        int y = row * HBLK;
+
+        /* getting 2-by-2 block of pixels */
+        comp_v *e1 = methods->at(comp, x, y);
+        comp_v *e2 = methods->at(comp, x + 1, y);
+        comp_v *e3 = methods->at(comp, x, y + 1);
+        comp_v *e4 = methods->at(comp, x + 1, y + 1);
+
+        *(dct_values *)elem = block_values(*e1, *e2, *e3, *e4);
+}
+
 /********** change_scale **************************************************
  *
  * This function scales the DCT values in a provided ppm pixels array. a's 
@@ -224,17 +285,11 @@ Pnm_ppm change_scale(Pnm_ppm my_ppm, A2Methods_T methods)
 void apply_scale(int col, int row, A2 array, void *elem, void *cl)
 {
         dct_values *og_elem = elem;
-        scaled_dct new_elem;
         array_methods *a_m = cl;
         A2 new_array = a_m->array;
         A2Methods_T methods = a_m->methods;
-        
-        new_elem.a = (unsigned)(floorf(og_elem->a * SFA));
-        new_elem.b = scale_helper(og_elem->b);
-        new_elem.c = scale_helper(og_elem->c);
-        new_elem.d = scale_helper(og_elem->d);
-        new_elem.pB = og_elem->pB;
-        new_elem.pR = og_elem->pR;
+
+        scaled_dct new_elem = scale_values(*og_elem);
 
         *(scaled_dct *)methods->at(new_array, col, row) = new_elem;
         (void) array;
@@ -284,7 +339,8 @@ signed scale_helper(float num)
  *
  * Expects: my_ppm and methods not NULL
  *     
- * Notes:  
+ * Notes: Maps over the scaled DCT values in block-major order (see 
+ *        map_blocks).
  *      
  ***********************************************************************/
 A2 inverse_DCT(Pnm_ppm my_ppm, A2Methods_T methods, int width, int height)
@@ -293,41 +349,1276 @@ A2 inverse_DCT(Pnm_ppm my_ppm, A2Methods_T methods, int width, int height)
         assert(methods != NULL);
         A2 array = my_ppm->pixels;
         A2 *new_a = methods->new(width * HBLK, height * HBLK, sizeof(struct comp_v));
-        float y1, y2, y3, y4, a, b, c, d;
-        unsigned pB, pR;
-        for (int i = 0; i < width; i++) {
-                for (int j = 0; j < height; j++) {
-                        scaled_dct *og_elem = methods->at(array, i, j);
-                        a = (float)((double)og_elem->a / (double)SFA);
-                        b = (float)((double)og_elem->b / (double)SFBCD);
-                        c = (float)((double)og_elem->c / (double)SFBCD);
-                        d = (float)((double)og_elem->d / (double)SFBCD);
-                        pB = og_elem->pB;
-                        pR = og_elem->pR;  
-
-                        y1 = a - b - c + d;
-                        y2 = a - b + c - d;
-                        y3 = a + b - c - d;
-                        y4 = a + b + c + d;  
-
-                        float new_pB = Arith40_chroma_of_index(pB);
-                        float new_pR = Arith40_chroma_of_index(pR);
-
-                        comp_v e1 = {y1, new_pB, new_pR};
-                        comp_v e2 = {y2, new_pB, new_pR};
-                        comp_v e3 = {y3, new_pB, new_pR};
-                        comp_v e4 = {y4, new_pB, new_pR};
-
-                        *(comp_v *)methods->at(new_a, i * HBLK, j * HBLK) = e1;
-                        *(comp_v *)methods->at(new_a, (i * HBLK) + 1, 
-                                               j * HBLK) = e2;
-                        *(comp_v *)methods->at(new_a, i * HBLK, 
-                                              (j * HBLK) + 1) = e3;
-                        *(comp_v *)methods->at(new_a, (i * HBLK) + 1, 
-                                              (j * HBLK) + 1) = e4;
+        array_methods a_m;
+        a_m.array = new_a;
+        a_m.methods = methods;
+        map_blocks(array, methods, apply_inverse_DCT, &a_m);
+        methods->free(&array);
+        return new_a;
+}
+
+/********** apply_inverse_DCT *********************************************
+ *
+ * This is the apply function for inverse_DCT. It turns the current 
+ * element's scaled DCT values back into the 2-by-2 block of pixels it 
+ * stands for.
+ *
+ * Parameters:
+ *      int col                 the current element's column
+ *      int row                 the current element's row
+ *      A2 array                the array of scaled DCT values
+ *      void *elem              the current element
+ *      void *cl                array_methods with the comp video array
+ *
+ * Return: N/A
+ *
+ * Expects: cl not NULL, the comp video array is twice as wide and high
+ *     
+ * Notes: Decompression
+ *      
+ ***********************************************************************/
+static void apply_inverse_DCT(int col, int row, A2 array, void *elem, 
+                              void *cl)
+{
+        (void) array;
+        array_methods *a_m = cl;
+        A2 comp = a_m->array;
+        A2Methods_T methods = a_m->methods;
+        int x = col * HBLK;
+        int y = row * HBLK;
+        comp_v block[4];
+
+        block_inverse_DCT(*(scaled_dct *)elem, block);
+        *(comp_v *)methods->at(comp, x, y) = block[0];
+        *(comp_v *)methods->at(comp, x + 1, y) = block[1];
+        *(comp_v *)methods->at(comp, x, y + 1) = block[2];
+        *(comp_v *)methods->at(comp, x + 1, y + 1) = block[3];
+}
+
+/********** DCT_planes ****************************************************
+ *
+ * This function is the planar version of DCT: it converts comp video planes
+ * into DCT value planes 1/4 the size.
+ *
+ * Parameters:
+ *      Pnm_ppm my_ppm          the Pnm_ppm, whose pixels are comp video 
+ *                              planes (see to_comp_planes)
+ *      int width               the width of the comp video image
+ *      int height              the height of the comp video image
+ *
+ * Return: DCT_PLANES planes of 4-byte values made by UArray2_new_planes, 
+ *         one for each field of dct_values
+ *
+ * Expects: my_ppm is not NULL, its pixels were made by UArray2_new_planes 
+ *          with COMP_PLANES planes
+ *     
+ * Notes: frees the comp video planes. Compression
+ *      
+ ***********************************************************************/
+A2 DCT_planes(Pnm_ppm my_ppm, int width, int height)
+{
+        assert(my_ppm != NULL);
+        A2 comp = my_ppm->pixels;
+        assert(UArray2_planes(comp) == COMP_PLANES);
+        A2 dct = UArray2_new_planes(width / HBLK, height / HBLK, DCT_PLANES, 
+                                    sizeof(float));
+        DCT_plane_rows(comp, dct, width / HBLK, height / HBLK);
+        UArray2_free((UArray2_T *)&comp);
+        return dct;
+}
+
+/********** change_scale_planes *******************************************
+ *
+ * This function is the planar version of change_scale: it scales the DCT 
+ * values in the planes made by DCT_planes.
+ *
+ * Parameters:
+ *      Pnm_ppm my_ppm          the Pnm_ppm, whose pixels are DCT planes
+ *
+ * Return: the same ppm, whose pixels are now a row-major UArray2 of 
+ *         scaled_dct's
+ *
+ * Expects: my_ppm is not NULL, its pixels were made by DCT_planes
+ *     
+ * Notes: frees the DCT planes. The new array is row major whatever the 
+ *        ppm's methods, so that it can be written a row at a time; it can
+ *        be used through either plain suite. Compression
+ *      
+ ***********************************************************************/
+Pnm_ppm change_scale_planes(Pnm_ppm my_ppm)
+{
+        assert(my_ppm != NULL);
+        A2 dct = my_ppm->pixels;
+        assert(UArray2_planes(dct) == DCT_PLANES);
+        A2 scaled = UArray2_new_row_major(my_ppm->width, my_ppm->height, 
+                                          sizeof(struct scaled_dct));
+        scale_plane_rows(dct, scaled, my_ppm->width, my_ppm->height);
+        UArray2_free((UArray2_T *)&dct);
+        my_ppm->pixels = scaled;
+        return my_ppm;
+}
+
+/********** inverse_DCT_planes ********************************************
+ *
+ * This function is the planar version of inverse_DCT: it turns scaled DCT 
+ * values into comp video planes.
+ *
+ * Parameters:
+ *      Pnm_ppm my_ppm          the Pnm_ppm, whose pixels are a row-major 
+ *                              UArray2 of scaled_dct's
+ *      int width               the width of the array, in blocks
+ *      int height              the height of the array, in blocks
+ *
+ * Return: COMP_PLANES planes of floats made by UArray2_new_planes (see 
+ *         comp_planes_row)
+ *
+ * Expects: my_ppm is not NULL, its pixels are a row-major UArray2
+ *     
+ * Notes: frees the scaled DCT values. Decompression
+ *      
+ ***********************************************************************/
+A2 inverse_DCT_planes(Pnm_ppm my_ppm, int width, int height)
+{
+        assert(my_ppm != NULL);
+        A2 scaled = my_ppm->pixels;
+        assert(UArray2_row_major(scaled));
+        A2 comp = UArray2_new_planes(width * HBLK, height * HBLK, 
+                                     COMP_PLANES, sizeof(float));
+        inverse_DCT_plane_rows(scaled, comp, width, height);
+        UArray2_free((UArray2_T *)&scaled);
+        return comp;
+}
+
+/********** DCT_plane_rows ************************************************
+ *
+ * This function is DCT_planes' mapping: it finds the DCT values of every 
+ * 2-by-2 block of comp video pixels, two rows of pixels at a time, putting
+ * each field in its own plane.
+ *
+ * Parameters:
+ *      A2 comp                 the comp video planes (see to_comp_planes)
+ *      A2 dct                  DCT_PLANES planes of 4-byte values
+ *      int width               width of the DCT planes, in blocks
+ *      int height              height of the DCT planes, in blocks
+ *
+ * Return: N/A
+ *
+ * Expects: comp is twice as wide and high as dct
+ *     
+ * Notes: each loop reads and writes only contiguous rows of one type, in 
+ *        the same order of operations as block_values, so the results are 
+ *        the same. Compression
+ *      
+ ***********************************************************************/
+static void DCT_plane_rows(A2 comp, A2 dct, int width, int height)
+{
+        for (int row = 0; row < height; row++) {
+                comp_row top = comp_planes_row(comp, row * HBLK);
+                comp_row bottom = comp_planes_row(comp, row * HBLK + 1);
+                float *a = UArray2_plane_row(dct, DCT_A, row);
+                float *b = UArray2_plane_row(dct, DCT_B, row);
+                float *c = UArray2_plane_row(dct, DCT_C, row);
+                float *d = UArray2_plane_row(dct, DCT_D, row);
+                unsigned *pB = UArray2_plane_row(dct, DCT_PB, row);
+                unsigned *pR = UArray2_plane_row(dct, DCT_PR, row);
+
+                for (int i = 0; i < width; i++) {
+                        float y1 = top.y[2 * i], y2 = top.y[2 * i + 1];
+                        float y3 = bottom.y[2 * i], y4 = bottom.y[2 * i + 1];
+                        a[i] = (float)((y4 + y3 + y2 + y1) / BLK);
+                        b[i] = (float)((y4 + y3 - y2 - y1) / BLK);
+                        c[i] = (float)((y4 - y3 + y2 - y1) / BLK);
+                        d[i] = (float)((y4 - y3 - y2 + y1) / BLK);
+                }
+                for (int i = 0; i < width; i++) {
+                        float avg_pB = (float)((top.pB[2 * i] + 
+                                                top.pB[2 * i + 1] + 
+                                                bottom.pB[2 * i] + 
+                                                bottom.pB[2 * i + 1]) / BLK);
+                        float avg_pR = (float)((top.pR[2 * i] + 
+                                                top.pR[2 * i + 1] + 
+                                                bottom.pR[2 * i] + 
+                                                bottom.pR[2 * i + 1]) / BLK);
+                        pB[i] = chroma_index(avg_pB);
+                        pR[i] = chroma_index(avg_pR);
                 }
         }
-        methods->free(&array);
-        return new_arr;
+}
+
+/********** scale_plane_rows **********************************************
+ *
+ * This function is change_scale_planes' mapping: it scales the DCT values 
+ * in the planes made by DCT_planes, a row at a time.
+ *
+ * Parameters:
+ *      A2 dct                  the DCT planes
+ *      A2 scaled               row-major array of scaled_dct, where the 
+ *                              scaled values go
+ *      int width               width of both, in blocks
+ *      int height              height of both, in blocks
+ *
+ * Return: N/A
+ *
+ * Expects: both are width by height
+ *     
+ * Notes: Compression
+ *      
+ ***********************************************************************/
+static void scale_plane_rows(A2 dct, A2 scaled, int width, int height)
+{
+        for (int row = 0; row < height; row++) {
+                const float *a = UArray2_plane_row(dct, DCT_A, row);
+                const float *b = UArray2_plane_row(dct, DCT_B, row);
+                const float *c = UArray2_plane_row(dct, DCT_C, row);
+                const float *d = UArray2_plane_row(dct, DCT_D, row);
+                const unsigned *pB = UArray2_plane_row(dct, DCT_PB, row);
+                const unsigned *pR = UArray2_plane_row(dct, DCT_PR, row);
+                scaled_dct *elems = UArray2_at(scaled, 0, row);
+
+                for (int i = 0; i < width; i++) {
+                        dct_values el = { a[i], b[i], c[i], d[i], 
+                                          pB[i], pR[i] };
+                        elems[i] = scale_values(el);
+                }
+        }
+}
+
+/********** inverse_DCT_plane_rows ****************************************
+ *
+ * This function is inverse_DCT_planes' mapping: it turns each row of scaled
+ * DCT values back into two rows of comp video planes with 
+ * block_row_inverse_DCT.
+ *
+ * Parameters:
+ *      A2 scaled               row-major array of scaled_dct
+ *      A2 comp                 the comp video planes (see to_comp_planes)
+ *      int width               width of scaled, in blocks
+ *      int height              height of scaled, in blocks
+ *
+ * Return: N/A
+ *
+ * Expects: comp is twice as wide and high as scaled
+ *     
+ * Notes: Decompression
+ *      
+ ***********************************************************************/
+static void inverse_DCT_plane_rows(A2 scaled, A2 comp, int width, 
+                                   int height)
+{
+        for (int row = 0; row < height; row++) {
+                block_row_inverse_DCT(UArray2_at(scaled, 0, row), width, 
+                                      comp_planes_row(comp, row * HBLK), 
+                                      comp_planes_row(comp, row * HBLK + 1));
+        }
+}
+
+/********** map_blocks ****************************************************
+ *
+ * This function maps over an array in block-major order if its methods 
+ * have one, and in their default order if not.
+ *
+ * Parameters:
+ *      A2 array                the array
+ *      A2Methods_T methods     its methods
+ *      apply                   the apply function
+ *      void *cl                closure, passed to apply
+ *
+ * Return: N/A
+ *
+ * Expects: array and methods are not NULL
+ *     
+ * Notes: for the plain suites this visits square tiles of the array (see 
+ *        map_block_major in a2plain.c), and for the blocked suite it is the
+ *        default order anyway. Each element of a DCT step reads or writes 
+ *        a 2-by-2 block of pixels, so with a plain array stored column by 
+ *        column a tile keeps the columns of those blocks in the cache.
+ *      
+ ***********************************************************************/
+static void map_blocks(A2 array, A2Methods_T methods, A2Methods_applyfun apply,
+                       void *cl)
+{
+        assert(array != NULL);
+        assert(methods != NULL);
+        if (methods->map_block_major != NULL) {
+                methods->map_block_major(array, apply, cl);
+        } else {
+                methods->map_default(array, apply, cl);
+        }
+}
+
+/********** block_values **************************************************
+ *
+ * This function computes the unscaled DCT values of one 2-by-2 block of 
+ * pixels: a, b, c, and d from the four Y's and quantized averages of the four
+ * pB's and pR's (quantized with the tables in chroma.h).
+ *
+ * Parameters:
+ *      comp_v e1               the top left pixel of the block
+ *      comp_v e2               the top right pixel of the block
+ *      comp_v e3               the bottom left pixel of the block
+ *      comp_v e4               the bottom right pixel of the block
+ *
+ * Return: the DCT values of the block
+ *
+ * Expects: N/A
+ *     
+ * Notes: Compression
+ *      
+ ***********************************************************************/
+static dct_values block_values(comp_v e1, comp_v e2, comp_v e3, comp_v e4)
+{
+        float avg_pB = (float)((e1.pB + e2.pB + e3.pB + e4.pB) / BLK);
+        float avg_pR = (float)((e1.pR + e2.pR + e3.pR + e4.pR) / BLK);
+        dct_values el;
+        el.a = (float)((e4.y + e3.y + e2.y + e1.y) / BLK);
+        el.b = (float)((e4.y + e3.y - e2.y - e1.y) / BLK);
+        el.c = (float)((e4.y - e3.y + e2.y - e1.y) / BLK);
+        el.d = (float)((e4.y - e3.y - e2.y + e1.y) / BLK);
+        el.pB = chroma_index(avg_pB);
+        el.pR = chroma_index(avg_pR);
+        return el;
+}
+
+/********** scale_values **************************************************
+ *
+ * This function scales one block's DCT values: a goes from [0, 1] to 
+ * [0, 511] and b, c, and d go from [-0.3, 0.3] to [-15, 15].
+ *
+ * Parameters:
+ *      dct_values og_elem      the unscaled DCT values
+ *
+ * Return: the scaled DCT values
+ *
+ * Expects: N/A
+ *     
+ * Notes: calls scale_helper function, a goes from float to unsigned
+ *      
+ ***********************************************************************/
+static scaled_dct scale_values(dct_values og_elem)
+{
+        scaled_dct new_elem;
+        new_elem.a = (unsigned)(floorf(og_elem.a * SFA));
+        new_elem.b = scale_helper(og_elem.b);
+        new_elem.c = scale_helper(og_elem.c);
+        new_elem.d = scale_helper(og_elem.d);
+        new_elem.pB = og_elem.pB;
+        new_elem.pR = og_elem.pR;
+        return new_elem;
+}
+
+/********** block_DCT **************************************************
+ *
+ * This function takes one 2-by-2 block of comp video pixels all the way to 
+ * its scaled DCT values, doing the work of DCT and change_scale for a single
+ * block without building any arrays.
+ *
+ * Parameters:
+ *      comp_v e1               the top left pixel of the block
+ *      comp_v e2               the top right pixel of the block
+ *      comp_v e3               the bottom left pixel of the block
+ *      comp_v e4               the bottom right pixel of the block
+ *
+ * Return: the scaled DCT values of the block
+ *
+ * Expects: N/A
+ *     
+ * Notes: used by the fused pipeline, Compression
+ *      
+ ***********************************************************************/
+scaled_dct block_DCT(comp_v e1, comp_v e2, comp_v e3, comp_v e4)
+{
+        return scale_values(block_values(e1, e2, e3, e4));
+}
+
+/********** block_inverse_DCT *********************************************
+ *
+ * This function undoes the scaling and the DCT for a single block, turning 
+ * one set of scaled DCT values back into four comp video pixels. pB and pR
+ * are unquantized (looked up in the table in chroma.h) and shared by all 
+ * four pixels.
+ *
+ * Parameters:
+ *      scaled_dct elem         the scaled DCT values of the block
+ *      comp_v block[4]         where to put the pixels, in the order top 
+ *                              left, top right, bottom left, bottom right
+ *
+ * Return: N/A
+ *
+ * Expects: block is not NULL
+ *     
+ * Notes: Decompression
+ *      
+ ***********************************************************************/
+void block_inverse_DCT(scaled_dct elem, comp_v block[4])
+{
+        assert(block != NULL);
+        float a = (float)((double)elem.a / (double)SFA);
+        float b = (float)((double)elem.b / (double)SFBCD);
+        float c = (float)((double)elem.c / (double)SFBCD);
+        float d = (float)((double)elem.d / (double)SFBCD);
+
+        float new_pB = chroma_level(elem.pB);
+        float new_pR = chroma_level(elem.pR);
+
+        block[0] = (comp_v){a - b - c + d, new_pB, new_pR};
+        block[1] = (comp_v){a - b + c - d, new_pB, new_pR};
+        block[2] = (comp_v){a + b - c - d, new_pB, new_pR};
+        block[3] = (comp_v){a + b + c + d, new_pB, new_pR};
+}
+
+/********** block_row_DCT_scalar ******************************************
+ *
+ * This function runs block_DCT on each block of two planar rows of pixels.
+ *
+ * Parameters:
+ *      comp_row top            the upper row of pixels
+ *      comp_row bottom         the lower row of pixels
+ *      int n                   number of blocks (2n pixels from each row)
+ *      scaled_dct *elems       where to put the n scaled DCT values
+ *
+ * Return: N/A
+ *
+ * Expects: elems is not NULL, both rows hold 2n pixels
+ *     
+ * Notes: the fallback when the CPU has no vector unit we can use, and used
+ *        for the blocks left over by the vector loops. Compression
+ *      
+ ***********************************************************************/
+static void block_row_DCT_scalar(comp_row top, comp_row bottom, int n, 
+                                 scaled_dct *elems)
+{
+        for (int i = 0; i < n; i++) {
+                int col = 2 * i;
+                comp_v e1 = { top.y[col], top.pB[col], top.pR[col] };
+                comp_v e2 = { top.y[col + 1], top.pB[col + 1], 
+                              top.pR[col + 1] };
+                comp_v e3 = { bottom.y[col], bottom.pB[col], 
+                              bottom.pR[col] };
+                comp_v e4 = { bottom.y[col + 1], bottom.pB[col + 1], 
+                              bottom.pR[col + 1] };
+                elems[i] = block_DCT(e1, e2, e3, e4);
+        }
+}
+
+/********** block_row_inverse_DCT_scalar **********************************
+ *
+ * This function runs block_inverse_DCT on each of a row of scaled DCT values
+ * and puts the pixels into two planar rows.
+ *
+ * Parameters:
+ *      const scaled_dct *elems the n scaled DCT values
+ *      int n                   number of blocks (2n pixels to each row)
+ *      comp_row top            where to put the upper row of pixels
+ *      comp_row bottom         where to put the lower row of pixels
+ *
+ * Return: N/A
+ *
+ * Expects: elems is not NULL, both rows hold 2n pixels
+ *     
+ * Notes: the fallback when the CPU has no vector unit we can use, and used
+ *        for the blocks left over by the vector loops. Decompression
+ *      
+ ***********************************************************************/
+static void block_row_inverse_DCT_scalar(const scaled_dct *elems, int n, 
+                                         comp_row top, comp_row bottom)
+{
+        comp_v block[4];
+        for (int i = 0; i < n; i++) {
+                block_inverse_DCT(elems[i], block);
+                for (int j = 0; j < 4; j++) {
+                        comp_row dest = (j < HBLK) ? top : bottom;
+                        int col = 2 * i + j % 2;
+                        dest.y[col] = block[j].y;
+                        dest.pB[col] = block[j].pB;
+                        dest.pR[col] = block[j].pR;
+                }
+        }
+}
+
+/********** row_offset ****************************************************
+ *
+ * This function returns the part of a planar row that starts at pixel i.
+ *
+ * Parameters:
+ *      comp_row row            the row
+ *      int i                   the first pixel of the new row
+ *
+ * Return: the row starting at pixel i
+ *
+ * Expects: N/A
+ *     
+ * Notes: used to hand the leftover blocks of a vector loop to the scalar one
+ *      
+ ***********************************************************************/
+static inline comp_row row_offset(comp_row row, int i)
+{
+        row.y += i;
+        row.pB += i;
+        row.pR += i;
+        return row;
+}
+
+/********** finish_blocks *************************************************
+ *
+ * This function stores the scaled DCT values of up to 8 blocks worked out 
+ * by a vector kernel, quantizing the averaged pB's and pR's on the way.
+ *
+ * Parameters:
+ *      const int *q            the scaled a's, b's, c's, and d's, in that 
+ *                              order, 8 of each
+ *      const float *avg        the averaged pB's and then pR's, 8 of each
+ *      int n                   number of blocks to store
+ *      scaled_dct *elems       where to store them
+ *
+ * Return: N/A
+ *
+ * Expects: all pointers are not NULL
+ *     
+ * Notes: Compression
+ *      
+ ***********************************************************************/
+static inline void finish_blocks(const int *q, const float *avg, int n,
+                                 scaled_dct *elems)
+{
+        unsigned index[16];
+        chroma_index_many(avg, n, index);
+        chroma_index_many(avg + 8, n, index + 8);
+        for (int i = 0; i < n; i++) {
+                elems[i].a = (unsigned)q[i];
+                elems[i].b = q[8 + i];
+                elems[i].c = q[16 + i];
+                elems[i].d = q[24 + i];
+                elems[i].pB = index[i];
+                elems[i].pR = index[8 + i];
+        }
+}
+
+/********** start_blocks **************************************************
+ *
+ * This function gathers the scaled DCT values of up to 8 blocks into one 
+ * array for a vector kernel, unquantizing pB and pR on the way.
+ *
+ * Parameters:
+ *      const scaled_dct *elems the scaled DCT values
+ *      int n                   number of blocks to gather
+ *      int *q                  where to put the a's, b's, c's, and d's, in
+ *                              that order, 8 of each
+ *      float *chroma           where to put the pB's and then pR's, 8 of 
+ *                              each
+ *
+ * Return: N/A
+ *
+ * Expects: all pointers are not NULL
+ *     
+ * Notes: Decompression
+ *      
+ ***********************************************************************/
+static inline void start_blocks(const scaled_dct *elems, int n, int *q, 
+                                float *chroma)
+{
+        for (int i = 0; i < n; i++) {
+                q[i] = elems[i].a;
+                q[8 + i] = elems[i].b;
+                q[16 + i] = elems[i].c;
+                q[24 + i] = elems[i].d;
+                chroma[i] = chroma_level(elems[i].pB);
+                chroma[8 + i] = chroma_level(elems[i].pR);
+        }
+}
+
+#ifdef FLOAT_SIMD
+
+/*
+ * The vector kernels do the same float operations in the same order as 
+ * block_values, scale_values, and block_inverse_DCT, so their results are 
+ * bit for bit the same. Dividing by 4 is done by multiplying by 0.25, which
+ * is exact. Clamping b, c, and d to [-0.3, 0.3] before scaling gives the same
+ * 15 and -15 that scale_helper's branches do.
+ */
+
+/********** block_row_DCT_sse *********************************************
+ *
+ * SSE4.1 version of block_row_DCT, 4 blocks at a time.
+ *
+ * Parameters: see block_row_DCT
+ *
+ * Return: N/A
+ *
+ * Expects: see block_row_DCT
+ *     
+ * Notes: leftover blocks go through block_row_DCT_scalar
+ *      
+ ***********************************************************************/
+__attribute__((target("sse4.1")))
+static void block_row_DCT_sse(comp_row top, comp_row bottom, int n, 
+                              scaled_dct *elems)
+{
+        const __m128 quarter = _mm_set1_ps(1 / BLK);
+        const __m128 upper = _mm_set1_ps(UPBND);
+        const __m128 lower = _mm_set1_ps(LWBND);
+        int q[32];
+        float avg[16];
+        int i = 0;
+        for (; i + 4 <= n; i += 4) {
+                const float *plane[3][2] = {
+                        { top.y + 2 * i, bottom.y + 2 * i },
+                        { top.pB + 2 * i, bottom.pB + 2 * i },
+                        { top.pR + 2 * i, bottom.pR + 2 * i }
+                };
+                __m128 e[3][4];
+                for (int p = 0; p < 3; p++) {
+                        for (int r = 0; r < 2; r++) {
+                                __m128 lo = _mm_loadu_ps(plane[p][r]);
+                                __m128 hi = _mm_loadu_ps(plane[p][r] + 4);
+                                e[p][2 * r] = _mm_shuffle_ps(lo, hi, 
+                                                  _MM_SHUFFLE(2, 0, 2, 0));
+                                e[p][2 * r + 1] = _mm_shuffle_ps(lo, hi, 
+                                                  _MM_SHUFFLE(3, 1, 3, 1));
+                        }
+                }
+                __m128 *y = e[0];
+                __m128 s43 = _mm_add_ps(y[3], y[2]);
+                __m128 d43 = _mm_sub_ps(y[3], y[2]);
+                __m128 a = _mm_mul_ps(_mm_add_ps(_mm_add_ps(s43, y[1]), 
+                                                 y[0]), quarter);
+                __m128 b = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(s43, y[1]), 
+                                                 y[0]), quarter);
+                __m128 c = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(d43, y[1]), 
+                                                 y[0]), quarter);
+                __m128 d = _mm_mul_ps(_mm_add_ps(_mm_sub_ps(d43, y[1]), 
+                                                 y[0]), quarter);
+                _mm_storeu_si128((__m128i *)q, _mm_cvttps_epi32(
+                                 _mm_floor_ps(_mm_mul_ps(a, 
+                                 _mm_set1_ps(SFA)))));
+                __m128 bcd[3] = { b, c, d };
+                for (int k = 0; k < 3; k++) {
+                        __m128 v = _mm_min_ps(_mm_max_ps(bcd[k], lower), 
+                                              upper);
+                        _mm_storeu_si128((__m128i *)(q + 8 * (k + 1)), 
+                                         _mm_cvttps_epi32(_mm_mul_ps(v, 
+                                         _mm_set1_ps(SFBCD))));
+                }
+                for (int p = 1; p < 3; p++) {
+                        __m128 sum = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+                                     e[p][0], e[p][1]), e[p][2]), e[p][3]);
+                        _mm_storeu_ps(avg + 8 * (p - 1), 
+                                      _mm_mul_ps(sum, quarter));
+                }
+                finish_blocks(q, avg, 4, elems + i);
+        }
+        block_row_DCT_scalar(row_offset(top, 2 * i), row_offset(bottom, 2 * i),
+                             n - i, elems + i);
+}
+
+/********** block_row_DCT_avx2 ********************************************
+ *
+ * AVX2 version of block_row_DCT, 8 blocks at a time.
+ *
+ * Parameters: see block_row_DCT
+ *
+ * Return: N/A
+ *
+ * Expects: see block_row_DCT
+ *     
+ * Notes: leftover blocks go through block_row_DCT_scalar
+ *      
+ ***********************************************************************/
+__attribute__((target("avx2")))
+static void block_row_DCT_avx2(comp_row top, comp_row bottom, int n, 
+                               scaled_dct *elems)
+{
+        const __m256 quarter = _mm256_set1_ps(1 / BLK);
+        const __m256 upper = _mm256_set1_ps(UPBND);
+        const __m256 lower = _mm256_set1_ps(LWBND);
+        int q[32];
+        float avg[16];
+        int i = 0;
+        for (; i + 8 <= n; i += 8) {
+                const float *plane[3][2] = {
+                        { top.y + 2 * i, bottom.y + 2 * i },
+                        { top.pB + 2 * i, bottom.pB + 2 * i },
+                        { top.pR + 2 * i, bottom.pR + 2 * i }
+                };
+                __m256 e[3][4];
+                for (int p = 0; p < 3; p++) {
+                        for (int r = 0; r < 2; r++) {
+                                __m256 lo = _mm256_loadu_ps(plane[p][r]);
+                                __m256 hi = _mm256_loadu_ps(plane[p][r] + 8);
+                                /* shuffle_ps works within 128-bit lanes, so
+                                   put the 64-bit pieces back in order */
+                                __m256 ev = _mm256_shuffle_ps(lo, hi, 
+                                                _MM_SHUFFLE(2, 0, 2, 0));
+                                __m256 od = _mm256_shuffle_ps(lo, hi, 
+                                                _MM_SHUFFLE(3, 1, 3, 1));
+                                e[p][2 * r] = _mm256_castpd_ps(
+                                        _mm256_permute4x64_pd(
+                                        _mm256_castps_pd(ev), 
+                                        _MM_SHUFFLE(3, 1, 2, 0)));
+                                e[p][2 * r + 1] = _mm256_castpd_ps(
+                                        _mm256_permute4x64_pd(
+                                        _mm256_castps_pd(od), 
+                                        _MM_SHUFFLE(3, 1, 2, 0)));
+                        }
+                }
+                __m256 *y = e[0];
+                __m256 s43 = _mm256_add_ps(y[3], y[2]);
+                __m256 d43 = _mm256_sub_ps(y[3], y[2]);
+                __m256 a = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(s43, 
+                                         y[1]), y[0]), quarter);
+                __m256 b = _mm256_mul_ps(_mm256_sub_ps(_mm256_sub_ps(s43, 
+                                         y[1]), y[0]), quarter);
+                __m256 c = _mm256_mul_ps(_mm256_sub_ps(_mm256_add_ps(d43, 
+                                         y[1]), y[0]), quarter);
+                __m256 d = _mm256_mul_ps(_mm256_add_ps(_mm256_sub_ps(d43, 
+                                         y[1]), y[0]), quarter);
+                _mm256_storeu_si256((__m256i *)q, _mm256_cvttps_epi32(
+                                    _mm256_floor_ps(_mm256_mul_ps(a, 
+                                    _mm256_set1_ps(SFA)))));
+                __m256 bcd[3] = { b, c, d };
+                for (int k = 0; k < 3; k++) {
+                        __m256 v = _mm256_min_ps(_mm256_max_ps(bcd[k], 
+                                                 lower), upper);
+                        _mm256_storeu_si256((__m256i *)(q + 8 * (k + 1)), 
+                                            _mm256_cvttps_epi32(
+                                            _mm256_mul_ps(v, 
+                                            _mm256_set1_ps(SFBCD))));
+                }
+                for (int p = 1; p < 3; p++) {
+                        __m256 sum = _mm256_add_ps(_mm256_add_ps(
+                                     _mm256_add_ps(e[p][0], e[p][1]), 
+                                     e[p][2]), e[p][3]);
+                        _mm256_storeu_ps(avg + 8 * (p - 1), 
+                                         _mm256_mul_ps(sum, quarter));
+                }
+                finish_blocks(q, avg, 8, elems + i);
+        }
+        block_row_DCT_scalar(row_offset(top, 2 * i), row_offset(bottom, 2 * i),
+                             n - i, elems + i);
+}
+
+/********** block_row_inverse_DCT_sse *************************************
+ *
+ * SSE4.1 version of block_row_inverse_DCT, 4 blocks at a time.
+ *
+ * Parameters: see block_row_inverse_DCT
+ *
+ * Return: N/A
+ *
+ * Expects: see block_row_inverse_DCT
+ *     
+ * Notes: leftover blocks go through block_row_inverse_DCT_scalar
+ *      
+ ***********************************************************************/
+__attribute__((target("sse4.1")))
+static void block_row_inverse_DCT_sse(const scaled_dct *elems, int n, 
+                                      comp_row top, comp_row bottom)
+{
+        int q[32];
+        float chroma[16];
+        int i = 0;
+        for (; i + 4 <= n; i += 4) {
+                start_blocks(elems + i, 4, q, chroma);
+                __m128 a = _mm_div_ps(_mm_cvtepi32_ps(_mm_loadu_si128(
+                                      (const __m128i *)q)), _mm_set1_ps(SFA));
+                __m128 bcd[3];
+                for (int k = 0; k < 3; k++) {
+                        bcd[k] = _mm_div_ps(_mm_cvtepi32_ps(_mm_loadu_si128(
+                                            (const __m128i *)(q + 8 * 
+                                                              (k + 1)))),
+                                            _mm_set1_ps(SFBCD));
+                }
+                __m128 amb = _mm_sub_ps(a, bcd[0]);
+                __m128 apb = _mm_add_ps(a, bcd[0]);
+                __m128 y[4] = {
+                        _mm_add_ps(_mm_sub_ps(amb, bcd[1]), bcd[2]),
+                        _mm_sub_ps(_mm_add_ps(amb, bcd[1]), bcd[2]),
+                        _mm_sub_ps(_mm_sub_ps(apb, bcd[1]), bcd[2]),
+                        _mm_add_ps(_mm_add_ps(apb, bcd[1]), bcd[2])
+                };
+                __m128 pB = _mm_loadu_ps(chroma);
+                __m128 pR = _mm_loadu_ps(chroma + 8);
+                comp_row rows[2] = { row_offset(top, 2 * i), 
+                                     row_offset(bottom, 2 * i) };
+                for (int r = 0; r < 2; r++) {
+                        __m128 y0 = y[2 * r], y1 = y[2 * r + 1];
+                        _mm_storeu_ps(rows[r].y, _mm_unpacklo_ps(y0, y1));
+                        _mm_storeu_ps(rows[r].y + 4, _mm_unpackhi_ps(y0, y1));
+                        _mm_storeu_ps(rows[r].pB, _mm_unpacklo_ps(pB, pB));
+                        _mm_storeu_ps(rows[r].pB + 4, _mm_unpackhi_ps(pB, pB));
+                        _mm_storeu_ps(rows[r].pR, _mm_unpacklo_ps(pR, pR));
+                        _mm_storeu_ps(rows[r].pR + 4, _mm_unpackhi_ps(pR, pR));
+                }
+        }
+        block_row_inverse_DCT_scalar(elems + i, n - i, row_offset(top, 2 * i),
+                                     row_offset(bottom, 2 * i));
+}
+
+/********** store_pairs_avx2 **********************************************
+ *
+ * This function interleaves two vectors of 8 floats and stores the 16 
+ * results: x0, y0, x1, y1, and so on.
+ *
+ * Parameters:
+ *      float *dest             where to store the floats
+ *      __m256 x, y             the floats to interleave
+ *
+ * Return: N/A
+ *
+ * Expects: 16 floats can be written to dest
+ *     
+ * Notes: unpacklo and unpackhi work within 128-bit lanes, so the lanes are
+ *        put back in order with permute2f128
+ *      
+ ***********************************************************************/
+__attribute__((target("avx2")))
+static inline void store_pairs_avx2(float *dest, __m256 x, __m256 y)
+{
+        __m256 lo = _mm256_unpacklo_ps(x, y);
+        __m256 hi = _mm256_unpackhi_ps(x, y);
+        _mm256_storeu_ps(dest, _mm256_permute2f128_ps(lo, hi, 0x20));
+        _mm256_storeu_ps(dest + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+}
+
+/********** block_row_inverse_DCT_avx2 ************************************
+ *
+ * AVX2 version of block_row_inverse_DCT, 8 blocks at a time.
+ *
+ * Parameters: see block_row_inverse_DCT
+ *
+ * Return: N/A
+ *
+ * Expects: see block_row_inverse_DCT
+ *     
+ * Notes: leftover blocks go through block_row_inverse_DCT_scalar
+ *      
+ ***********************************************************************/
+__attribute__((target("avx2")))
+static void block_row_inverse_DCT_avx2(const scaled_dct *elems, int n, 
+                                       comp_row top, comp_row bottom)
+{
+        int q[32];
+        float chroma[16];
+        int i = 0;
+        for (; i + 8 <= n; i += 8) {
+                start_blocks(elems + i, 8, q, chroma);
+                __m256 a = _mm256_div_ps(_mm256_cvtepi32_ps(
+                                         _mm256_loadu_si256((const __m256i *)
+                                                            q)), 
+                                         _mm256_set1_ps(SFA));
+                __m256 bcd[3];
+                for (int k = 0; k < 3; k++) {
+                        bcd[k] = _mm256_div_ps(_mm256_cvtepi32_ps(
+                                               _mm256_loadu_si256(
+                                               (const __m256i *)(q + 8 * 
+                                                                 (k + 1)))),
+                                               _mm256_set1_ps(SFBCD));
+                }
+                __m256 amb = _mm256_sub_ps(a, bcd[0]);
+                __m256 apb = _mm256_add_ps(a, bcd[0]);
+                __m256 y[4] = {
+                        _mm256_add_ps(_mm256_sub_ps(amb, bcd[1]), bcd[2]),
+                        _mm256_sub_ps(_mm256_add_ps(amb, bcd[1]), bcd[2]),
+                        _mm256_sub_ps(_mm256_sub_ps(apb, bcd[1]), bcd[2]),
+                        _mm256_add_ps(_mm256_add_ps(apb, bcd[1]), bcd[2])
+                };
+                __m256 pB = _mm256_loadu_ps(chroma);
+                __m256 pR = _mm256_loadu_ps(chroma + 8);
+                comp_row rows[2] = { row_offset(top, 2 * i), 
+                                     row_offset(bottom, 2 * i) };
+                for (int r = 0; r < 2; r++) {
+                        store_pairs_avx2(rows[r].y, y[2 * r], y[2 * r + 1]);
+                        store_pairs_avx2(rows[r].pB, pB, pB);
+                        store_pairs_avx2(rows[r].pR, pR, pR);
+                }
+        }
+        block_row_inverse_DCT_scalar(elems + i, n - i, row_offset(top, 2 * i),
+                                     row_offset(bottom, 2 * i));
+}
+
+#endif
+
+/********** block_row_DCT *************************************************
+ *
+ * This function takes a row of 2-by-2 blocks, given as two planar rows of 
+ * comp video pixels, to their scaled DCT values. It uses the widest vector 
+ * unit the CPU has (AVX2, then SSE4.1), falling back to block_DCT one block
+ * at a time.
+ *
+ * Parameters:
+ *      comp_row top            the upper row of pixels
+ *      comp_row bottom         the lower row of pixels
+ *      int n                   number of blocks (2n pixels from each row)
+ *      scaled_dct *elems       where to put the n scaled DCT values
+ *
+ * Return: N/A
+ *
+ * Expects: elems is not NULL, both rows hold 2n pixels
+ *     
+ * Notes: same results as block_DCT. Compression
+ *      
+ ***********************************************************************/
+void block_row_DCT(comp_row top, comp_row bottom, int n, scaled_dct *elems)
+{
+        assert(elems != NULL);
+#ifdef FLOAT_SIMD
+        if (__builtin_cpu_supports("avx2")) {
+                block_row_DCT_avx2(top, bottom, n, elems);
+                return;
+        }
+        if (__builtin_cpu_supports("sse4.1")) {
+                block_row_DCT_sse(top, bottom, n, elems);
+                return;
+        }
+#endif
+        block_row_DCT_scalar(top, bottom, n, elems);
+}
+
+/********** block_row_inverse_DCT *****************************************
+ *
+ * This function turns a row of scaled DCT values back into two planar rows
+ * of comp video pixels. It uses the widest vector unit the CPU has (AVX2, 
+ * then SSE4.1), falling back to block_inverse_DCT one block at a time.
+ *
+ * Parameters:
+ *      const scaled_dct *elems the n scaled DCT values
+ *      int n                   number of blocks (2n pixels to each row)
+ *      comp_row top            where to put the upper row of pixels
+ *      comp_row bottom         where to put the lower row of pixels
+ *
+ * Return: N/A
+ *
+ * Expects: elems is not NULL, both rows hold 2n pixels
+ *     
+ * Notes: same results as block_inverse_DCT. Decompression
+ *      
+ ***********************************************************************/
+void block_row_inverse_DCT(const scaled_dct *elems, int n, comp_row top, 
+                           comp_row bottom)
+{
+        assert(elems != NULL);
+#ifdef FLOAT_SIMD
+        if (__builtin_cpu_supports("avx2")) {
+                block_row_inverse_DCT_avx2(elems, n, top, bottom);
+                return;
+        }
+        if (__builtin_cpu_supports("sse4.1")) {
+                block_row_inverse_DCT_sse(elems, n, top, bottom);
+                return;
+        }
+#endif
+        block_row_inverse_DCT_scalar(elems, n, top, bottom);
+}
+
+/********** fixed_scale ***************************************************
+ *
+ * This function is the fixed-point scale_helper: it scales a difference of
+ * four Y's (four times b, c, or d, in units of 1 / FIXED_ONE) to [-15, 15].
+ *
+ * Parameters:
+ *      int x                   the difference
+ *
+ * Return: the scaled value
+ *
+ * Expects: x is in [-2 * FIXED_ONE, 2 * FIXED_ONE]
+ *     
+ * Notes: like scale_helper, truncates towards 0 and treats everything past
+ *        0.3 as 0.3. Compression
+ *      
+ ***********************************************************************/
+static inline int fixed_scale(int x)
+{
+        int scaled = fixed_mulhi(x < 0 ? -x : x, FIXED_SFBCD);
+        if (scaled > FIXED_BCD) {
+                scaled = FIXED_BCD;
+        }
+        return x < 0 ? -scaled : scaled;
+}
+
+/********** fixed_block_row_DCT_scalar ************************************
+ *
+ * This function turns two rows of fixed-point comp video pixels into a row
+ * of scaled DCT values one block at a time.
+ *
+ * Parameters: see fixed_block_row_DCT
+ *
+ * Return: N/A
+ *
+ * Expects: see fixed_block_row_DCT
+ *     
+ * Notes: the fallback when the CPU has no AVX2, and used for the blocks 
+ *        left over by the vector loop. Compression
+ *      
+ ***********************************************************************/
+static void fixed_block_row_DCT_scalar(fixed_row top, fixed_row bottom, 
+                                       int n, scaled_dct *elems)
+{
+        for (int i = 0; i < n; i++) {
+                int col = 2 * i;
+                int y1 = top.y[col], y2 = top.y[col + 1];
+                int y3 = bottom.y[col], y4 = bottom.y[col + 1];
+                scaled_dct el;
+                el.a = fixed_mulhi(y4 + y3 + y2 + y1, FIXED_SFA);
+                el.b = fixed_scale(y4 + y3 - y2 - y1);
+                el.c = fixed_scale(y4 - y3 + y2 - y1);
+                el.d = fixed_scale(y4 - y3 - y2 + y1);
+                el.pB = chroma_index_fixed(top.pB[col] + top.pB[col + 1] + 
+                                           bottom.pB[col] + 
+                                           bottom.pB[col + 1]);
+                el.pR = chroma_index_fixed(top.pR[col] + top.pR[col + 1] + 
+                                           bottom.pR[col] + 
+                                           bottom.pR[col + 1]);
+                elems[i] = el;
+        }
+}
+
+#ifdef FLOAT_SIMD
+
+/********** fixed_pair_avx2 ***********************************************
+ *
+ * This function adds and subtracts the pairs of neighbouring values in 32 
+ * int16_t's, one pair per block.
+ *
+ * Parameters:
+ *      const int16_t *row      the 32 values
+ *      __m256i *sum            where to put the 16 left + right's
+ *      __m256i *diff           where to put the 16 left - right's, or NULL
+ *
+ * Return: N/A
+ *
+ * Expects: 32 values can be read from row
+ *     
+ * Notes: hadd and hsub work within each 128-bit lane, so the results are 
+ *        put back in order with a permute. Compression
+ *      
+ ***********************************************************************/
+__attribute__((target("avx2")))
+static inline void fixed_pair_avx2(const int16_t *row, __m256i *sum, 
+                                   __m256i *diff)
+{
+        __m256i lo = _mm256_loadu_si256((const __m256i *)row);
+        __m256i hi = _mm256_loadu_si256((const __m256i *)(row + 16));
+        *sum = _mm256_permute4x64_epi64(_mm256_hadd_epi16(lo, hi), 0xd8);
+        if (diff != NULL) {
+                *diff = _mm256_permute4x64_epi64(_mm256_hsub_epi16(lo, hi), 
+                                                 0xd8);
+        }
+}
+
+/********** fixed_scale_avx2 **********************************************
+ *
+ * This function is fixed_scale for 16 differences at a time.
+ *
+ * Parameters:
+ *      __m256i x               the differences
+ *
+ * Return: the scaled values
+ *
+ * Expects: see fixed_scale
+ *     
+ * Notes: Compression
+ *      
+ ***********************************************************************/
+__attribute__((target("avx2")))
+static inline __m256i fixed_scale_avx2(__m256i x)
+{
+        __m256i scaled = _mm256_mulhi_epu16(_mm256_abs_epi16(x), 
+                                            _mm256_set1_epi16(FIXED_SFBCD));
+        scaled = _mm256_min_epi16(scaled, _mm256_set1_epi16(FIXED_BCD));
+        return _mm256_sign_epi16(scaled, x);
+}
+
+/********** fixed_index_avx2 **********************************************
+ *
+ * This function is chroma_index_fixed for 16 chroma values at a time.
+ *
+ * Parameters:
+ *      __m256i chroma                  the values
+ *      const int16_t thresholds[]      from chroma_fixed_thresholds
+ *
+ * Return: the indices
+ *
+ * Expects: N/A
+ *     
+ * Notes: counts the thresholds each value is at or above. Compression
+ *      
+ ***********************************************************************/
+__attribute__((target("avx2")))
+static inline __m256i fixed_index_avx2(__m256i chroma, 
+                                       const int16_t thresholds[])
+{
+        __m256i count = _mm256_setzero_si256();
+        for (int t = 0; t < CHROMA_LEVELS - 1; t++) {
+                __m256i below = _mm256_set1_epi16(thresholds[t] - 1);
+                count = _mm256_sub_epi16(count, 
+                                         _mm256_cmpgt_epi16(chroma, below));
+        }
+        return count;
+}
+
+/********** fixed_block_row_DCT_avx2 **************************************
+ *
+ * AVX2 version of fixed_block_row_DCT, 16 blocks at a time in 16-bit 
+ * lanes.
+ *
+ * Parameters: see fixed_block_row_DCT
+ *
+ * Return: N/A
+ *
+ * Expects: see fixed_block_row_DCT
+ *     
+ * Notes: builds each block's 8-byte scaled_dct in a 64-bit lane, so relies
+ *        on its fields being laid out in order with no gaps. Leftover blocks
+ *        go through fixed_block_row_DCT_scalar
+ *      
+ ***********************************************************************/
+__attribute__((target("avx2")))
+static void fixed_block_row_DCT_avx2(fixed_row top, fixed_row bottom, int n,
+                                     scaled_dct *elems)
+{
+        int16_t thresholds[CHROMA_LEVELS - 1];
+        chroma_fixed_thresholds(thresholds);
+        __m256i low_byte = _mm256_set1_epi16(0xff);
+        int i = 0;
+        for (; i + 16 <= n; i += 16) {
+                int col = 2 * i;
+                __m256i top_sum, top_diff, bottom_sum, bottom_diff;
+                fixed_pair_avx2(top.y + col, &top_sum, &top_diff);
+                fixed_pair_avx2(bottom.y + col, &bottom_sum, &bottom_diff);
+                /* with y1 y2 over y3 y4, the diffs are y1 - y2 and y3 - y4 */
+                __m256i a = _mm256_mulhi_epu16(_mm256_add_epi16(top_sum, 
+                                                               bottom_sum),
+                                               _mm256_set1_epi16(FIXED_SFA));
+                __m256i b = fixed_scale_avx2(_mm256_sub_epi16(bottom_sum, 
+                                                              top_sum));
+                __m256i c = fixed_scale_avx2(_mm256_sub_epi16(
+                                             _mm256_setzero_si256(),
+                                             _mm256_add_epi16(top_diff, 
+                                                              bottom_diff)));
+                __m256i d = fixed_scale_avx2(_mm256_sub_epi16(top_diff, 
+                                                              bottom_diff));
+                __m256i pB_top, pB_bottom, pR_top, pR_bottom;
+                fixed_pair_avx2(top.pB + col, &pB_top, NULL);
+                fixed_pair_avx2(bottom.pB + col, &pB_bottom, NULL);
+                fixed_pair_avx2(top.pR + col, &pR_top, NULL);
+                fixed_pair_avx2(bottom.pR + col, &pR_bottom, NULL);
+                __m256i pB = fixed_index_avx2(_mm256_add_epi16(pB_top, 
+                                                               pB_bottom),
+                                              thresholds);
+                __m256i pR = fixed_index_avx2(_mm256_add_epi16(pR_top, 
+                                                               pR_bottom),
+                                              thresholds);
+
+                /* the four 16-bit words of each scaled_dct */
+                __m256i w1 = _mm256_or_si256(pB, _mm256_slli_epi16(pR, 8));
+                __m256i w2 = _mm256_or_si256(_mm256_and_si256(b, low_byte),
+                                             _mm256_slli_epi16(c, 8));
+                __m256i w3 = _mm256_and_si256(d, low_byte);
+                __m256i lo01 = _mm256_unpacklo_epi16(a, w1);
+                __m256i hi01 = _mm256_unpackhi_epi16(a, w1);
+                __m256i lo23 = _mm256_unpacklo_epi16(w2, w3);
+                __m256i hi23 = _mm256_unpackhi_epi16(w2, w3);
+                /* blocks 0 1 | 8 9, 2 3 | 10 11, 4 5 | 12 13, 6 7 | 14 15 */
+                __m256i e0 = _mm256_unpacklo_epi32(lo01, lo23);
+                __m256i e1 = _mm256_unpackhi_epi32(lo01, lo23);
+                __m256i e2 = _mm256_unpacklo_epi32(hi01, hi23);
+                __m256i e3 = _mm256_unpackhi_epi32(hi01, hi23);
+                __m256i *out = (__m256i *)(elems + i);
+                _mm256_storeu_si256(out, _mm256_permute2x128_si256(e0, e1, 
+                                                                   0x20));
+                _mm256_storeu_si256(out + 1, _mm256_permute2x128_si256(e2, 
+                                                                 e3, 0x20));
+                _mm256_storeu_si256(out + 2, _mm256_permute2x128_si256(e0, 
+                                                                 e1, 0x31));
+                _mm256_storeu_si256(out + 3, _mm256_permute2x128_si256(e2, 
+                                                                 e3, 0x31));
+        }
+        fixed_block_row_DCT_scalar(fixed_row_offset(top, 2 * i), 
+                                   fixed_row_offset(bottom, 2 * i), n - i, 
+                                   elems + i);
+}
+
+#endif
+
+/********** fixed_block_row_DCT *******************************************
+ *
+ * This function is the fixed-point block_row_DCT: it turns two rows of 
+ * fixed-point comp video pixels into a row of scaled DCT values. It uses 
+ * AVX2 when the CPU has it, falling back to one block at a time.
+ *
+ * Parameters:
+ *      fixed_row top           the upper row of pixels
+ *      fixed_row bottom        the lower row of pixels
+ *      int n                   number of blocks (2n pixels from each row)
+ *      scaled_dct *elems       where to put the n scaled DCT values
+ *
+ * Return: N/A
+ *
+ * Expects: elems is not NULL, both rows hold 2n pixels, as made by 
+ *          fixed_rgb8_row_to_comp or fixed_rgb_row_to_comp
+ *     
+ * Notes: only integer math, with the same results either way. A sum of 
+ *        four values in units of 1 / FIXED_ONE is their average in units of
+ *        1 / (4 * FIXED_ONE), which is what chroma_index_fixed takes, and 
+ *        what FIXED_SFA and FIXED_SFBCD scale from. Compression
+ *      
+ ***********************************************************************/
+void fixed_block_row_DCT(fixed_row top, fixed_row bottom, int n, 
+                         scaled_dct *elems)
+{
+        assert(elems != NULL);
+        assert(CHROMA_FIXED_ONE == 4 * FIXED_ONE);
+#ifdef FLOAT_SIMD
+        if (sizeof(scaled_dct) == 8 && __builtin_cpu_supports("avx2")) {
+                fixed_block_row_DCT_avx2(top, bottom, n, elems);
+                return;
+        }
+#endif
+        fixed_block_row_DCT_scalar(top, bottom, n, elems);
+}
+
+/********** fixed_block_row_inverse_DCT ***********************************
+ *
+ * This function is the fixed-point block_row_inverse_DCT: it turns a row of 
+ * scaled DCT values back into two rows of fixed-point comp video pixels.
+ *
+ * Parameters:
+ *      const scaled_dct *elems the n scaled DCT values
+ *      int n                   number of blocks (2n pixels to each row)
+ *      fixed_row top           where to put the upper row of pixels
+ *      fixed_row bottom        where to put the lower row of pixels
+ *
+ * Return: N/A
+ *
+ * Expects: elems is not NULL, both rows hold 2n pixels
+ *     
+ * Notes: only integer math; every value stays well inside an int16_t, even
+ *        for a codeword with b, c, and d of -16. Decompression
+ *      
+ ***********************************************************************/
+void fixed_block_row_inverse_DCT(const scaled_dct *elems, int n, 
+                                 fixed_row top, fixed_row bottom)
+{
+        assert(elems != NULL);
+        int levels[CHROMA_LEVELS];
+        for (unsigned i = 0; i < CHROMA_LEVELS; i++) {
+                /* from units of 1 / CHROMA_FIXED_ONE, rounded */
+                levels[i] = (chroma_level_fixed(i) + 2) >> 2;
+        }
+        for (int i = 0; i < n; i++) {
+                int col = 2 * i;
+                scaled_dct el = elems[i];
+                int a = fixed_mulhrs(el.a * 16, UNSCALE_A);
+                int b = fixed_mulhrs(el.b * 128, UNSCALE_BCD);
+                int c = fixed_mulhrs(el.c * 128, UNSCALE_BCD);
+                int d = fixed_mulhrs(el.d * 128, UNSCALE_BCD);
+                top.y[col] = a - b - c + d;
+                top.y[col + 1] = a - b + c - d;
+                bottom.y[col] = a + b - c - d;
+                bottom.y[col + 1] = a + b + c + d;
+                top.pB[col] = top.pB[col + 1] = levels[el.pB];
+                bottom.pB[col] = bottom.pB[col + 1] = levels[el.pB];
+                top.pR[col] = top.pR[col + 1] = levels[el.pR];
+                bottom.pR[col] = bottom.pR[col + 1] = levels[el.pR];
+        }
 }
 #undef A2
\ No newline at end of file
@@ -10,9 +10,23 @@
  *
  *************************************************************************/
 
+#ifndef FLOAT_INCLUDED
+#define FLOAT_INCLUDED
 #include "pnm.h"
 #include <stdbool.h>
+#include <stdint.h>
+#include "int.h"
 
+/* 
+ * scaled DCT values of a single 2-by-2 block of pixels, each in the 
+ * smallest type that holds its field of a codeword (see CODEWORD_FIELDS in
+ * codewords.h), so that a block takes 8 bytes
+ */
+typedef struct scaled_dct {
+        uint16_t a;
+        uint8_t pB, pR;
+        int8_t b, c, d;
+} scaled_dct;
 
 Pnm_ppm float_parent(Pnm_ppm my_ppm, bool compress);
 
@@ -24,8 +38,34 @@ A2Methods_UArray2 DCT(Pnm_ppm my_ppm, A2Methods_T methods, int width,
 A2Methods_UArray2 inverse_DCT(Pnm_ppm my_ppm, A2Methods_T methods, int width, 
                               int height);
 
+/* The same steps on planar images (see UArray2_new_planes in uarray2rows.h) */
+A2Methods_UArray2 DCT_planes(Pnm_ppm my_ppm, int width, int height);
+Pnm_ppm change_scale_planes(Pnm_ppm my_ppm);
+A2Methods_UArray2 inverse_DCT_planes(Pnm_ppm my_ppm, int width, int height);
+
 /* Helper Functions */
 void apply_scale(int col, int row, A2Methods_UArray2 array, void *elem, 
                  void *cl);
 Pnm_ppm change_scale(Pnm_ppm my_ppm, A2Methods_T methods);
-signed scale_helper(float num);
\ No newline at end of file
+signed scale_helper(float num);
+
+/* Per-block transforms shared with the fused pipeline in compress40.c */
+scaled_dct block_DCT(comp_v e1, comp_v e2, comp_v e3, comp_v e4);
+void block_inverse_DCT(scaled_dct elem, comp_v block[4]);
+
+/*
+ * Whole-row transforms used by the fused pipeline: n blocks from two planar
+ * rows of 2n pixels. They use SSE4.1 or AVX2 when the CPU has them and give
+ * exactly the same results as block_DCT and block_inverse_DCT.
+ */
+void block_row_DCT(comp_row top, comp_row bottom, int n, scaled_dct *elems);
+void block_row_inverse_DCT(const scaled_dct *elems, int n, comp_row top, 
+                           comp_row bottom);
+
+/* Fixed-point versions of the above, for the integer pipeline (see int.h) */
+void fixed_block_row_DCT(fixed_row top, fixed_row bottom, int n, 
+                         scaled_dct *elems);
+void fixed_block_row_inverse_DCT(const scaled_dct *elems, int n, 
+                                 fixed_row top, fixed_row bottom);
+
+#endif
\ No newline at end of file
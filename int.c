@@ -13,11 +13,19 @@
 #include "int.h"
 #include "a2methods.h"
 #include "uarray2.h"
-#include "a2plain.h"
+#include "uarray2rows.h"
 #include "a2blocked.h"
+#include "ppmio.h"
 #include "assert.h"
 #include "mem.h"
 
+/* vector kernels are built for x86 and picked at runtime (see below) */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define INT_SIMD 1
+#include <immintrin.h>
+#include "rgb8simd.h"
+#endif
+
 typedef A2Methods_UArray2 A2;
 
 typedef struct array_methods {
@@ -27,13 +35,29 @@ typedef struct array_methods {
         A2Methods_T methods;
         /* the dimension, not used all the time */
         int value;
+        /* the part of the source array to use, from (0, 0); the rest was 
+           trimmed off by trim_ppm */
+        int width, height;
+        /* whether the rgb pixels are ppm_rgb8's (see ppmio.h) rather than 
+           struct Pnm_rgb's */
+        bool bytes;
+        /* tables for converting to comp video, or NULL to do the 
+           arithmetic */
+        comp_table table;
 } array_methods;
 
-typedef struct comp_v {
-        /* float values */
-        float y, pB, pR;
-} comp_v;
+static struct Pnm_rgb get_rgb(const void *pixel, bool bytes);
+static void put_rgb(void *pixel, struct Pnm_rgb rgb, bool bytes);
 
+static void comp_vid_row(int row, UArray2_T array, void *span, int n, 
+                         void *cl);
+static void to_rgb_row(int row, UArray2_T array, void *span, int n, void *cl);
+static bool y_in_range(const float *y, int n);
+static void rgb8_row_to_comp_scalar(const unsigned char *rgb, int n, 
+                                    float denom, comp_row comp);
+static void comp_row_to_rgb8_scalar(comp_row comp, int n, float denom, 
+                                    unsigned char *rgb);
+static inline float clamp_unit(float num);
 
 /********** int_parent **************************************************
  *
@@ -46,22 +70,37 @@ typedef struct comp_v {
  * Parameters:
  *      Pnm_ppm my_ppm          the Pnm_ppm
  *      bool compress           if we are compressing or not
+ *      comp_table table        tables to convert pixels to comp video with,
+ *                              or NULL to do the arithmetic; not used when
+ *                              decompressing
  *
  * Return: a Pnm_ppm with the new values in the array
  *
- * Expects: my_ppm is not NULL
+ * Expects: my_ppm is not NULL, table is NULL or made for the ppm's 
+ *          denominator
  *     
- * Notes:  
+ * Notes: Every new array is made with the ppm's own methods. The layout 
+ *        is chosen by the arrays, not by which suite the methods are: 
+ *        pixels in a row-major UArray2 become comp video planes 
+ *        (to_comp_planes), and comp video planes (made by 
+ *        inverse_DCT_planes) become pixels with planes_to_rgb.
  *      
  ***********************************************************************/
-Pnm_ppm int_parent(Pnm_ppm my_ppm, bool compress)
+Pnm_ppm int_parent(Pnm_ppm my_ppm, bool compress, comp_table table)
 {        
         assert(my_ppm != NULL);
-        A2Methods_T methods = uarray2_methods_plain;
+        A2Methods_T methods = my_ppm->methods;
         assert(methods != NULL);
+        bool plain = uarray2_methods_is_plain(methods);
         if (compress) {
                 my_ppm = trim_ppm(my_ppm, methods);
-                my_ppm = to_comp_video(my_ppm, methods);
+                if (plain && UArray2_row_major(my_ppm->pixels)) {
+                        my_ppm = to_comp_planes(my_ppm, table);
+                } else {
+                        my_ppm = to_comp_video(my_ppm, methods, table);
+                }
+        } else if (plain && UArray2_planes(my_ppm->pixels) > 0) {
+                my_ppm = planes_to_rgb(my_ppm);
         } else {
                 my_ppm = to_rgb(my_ppm, methods);
         }
@@ -72,146 +111,64 @@ Pnm_ppm int_parent(Pnm_ppm my_ppm, bool compress)
 /********** trim_ppm ****************************************************
  *
  * This function checks the width and the height of the image and if they are
- * not even, it trims it by one. It creates a new array and calls on a mapping
- * function and places all the values from the old array into the new trimmed
- * array and then returns the Pnm_ppm with the new array.
+ * not even, it trims it by one. Nothing is copied: only the ppm's width and 
+ * height change, and the pixels array is left as it was, so the last column 
+ * or row is still in it but is no longer part of the image.
  *
  * Parameters:
  *      Pnm_ppm my_ppm          the Pnm_ppm
  *      A2Methods_T methods     methods given
  *
- * Return: a Pnm_ppm with trimmed array
+ * Return: a Pnm_ppm with an even width and height
  *
- * Expects: my_ppm is not NULL
+ * Expects: my_ppm is not NULL, and its width and height are not 1
  *     
- * Notes: if the image needs to be trimmed then we create a new array and free
- *        the old one, compression
+ * Notes: afterwards the pixels array can be one wider or taller than the 
+ *        ppm says; to_comp_video reads only the ppm's width and height of 
+ *        it, and replaces it with an array of that size. Compression
  *      
  ***********************************************************************/
 Pnm_ppm trim_ppm(Pnm_ppm my_ppm, A2Methods_T methods)
 {
+        assert(my_ppm != NULL);
         assert(my_ppm->height - 1 != 0 && my_ppm->width - 1 != 0);
-        if (my_ppm->height % 2 != 0) {
-                my_ppm->height = my_ppm->height - 1;
-                A2 array = my_ppm->pixels;
-                A2 trimmed_array = methods->new(my_ppm->width, my_ppm->height, 
-                                                sizeof(struct Pnm_rgb));
-                array_methods cl;
-                cl.array = &trimmed_array;
-                cl.methods = methods;
-                cl.value = my_ppm->height;
-                methods->map_default(array, trim_height, (void *) &cl);
-                methods->free(&array);
-                my_ppm->pixels = trimmed_array;
-                
-        }
-        if (my_ppm->width % 2 != 0) {
-                my_ppm->width = my_ppm->width - 1;
-                A2 array = my_ppm->pixels;
-                A2 trimmed_array = methods->new(my_ppm->width, my_ppm->height,
-                                                sizeof(struct Pnm_rgb));
-                array_methods cl;
-                cl.array = &trimmed_array;
-                cl.methods = methods;
-                cl.value = my_ppm->width;
-                methods->map_default(array, trim_width, (void *) &cl);
-                methods->free(&array);
-                my_ppm->pixels = trimmed_array;
-        }
+        (void) methods;
+        my_ppm->width -= my_ppm->width % 2;
+        my_ppm->height -= my_ppm->height % 2;
         return my_ppm;
 }
 
-/********** trim_height ****************************************************
- *
- * This function is the apply function for our trimming function. It checks
- * that the current column index is less than the new array's height, then it
- * places the current element into the new array.
- *
- * Parameters:
- *      int col                          column
- *      int row                          row
- *      A2 array                         the array
- *      void *elem                       elem at that position
- *      void *cl                         closure struct
- *
- * Return: void
- *
- * Expects: closure is not NULL, elem is not NULL
- *     
- * Notes: Compression
- *      
- *************************************************************************/
-
-void trim_height(int col, int row, A2 array, void *elem, void *cl)
-{
-        assert(cl != NULL);
-        assert(elem != NULL);
-        (void) array;
-        array_methods *cl_p = cl;
-        A2Methods_T methods = cl_p->methods;
-        A2 *trim_array = cl_p->array;
-        int height = cl_p->value;
-        struct Pnm_rgb *ep = elem;
-        if (row < height) {
-                *(struct Pnm_rgb *)methods->at(*trim_array, col, row) = *ep;
-        }
-}
-
-/********** trim_width ****************************************************
- *
- * This function is the apply function for our trimming function. It checks
- * that the current row index is less than the new array's width, then it
- * places the current element into the new array.
- *
- * Parameters:
- *      int col                          column
- *      int row                          row
- *      A2 array                         the array
- *      void *elem                       elem at that position
- *      void *cl                         closure struct
- *
- * Return: void
- *
- * Expects: closure is not NULL, elem is not NULL
- *     
- * Notes: Compression
- *      
- *************************************************************************/
-void trim_width(int col, int row, A2 array, void *elem, void *cl)
-{
-        (void) array;
-        array_methods *cl_p = cl;
-        A2Methods_T methods = cl_p->methods;
-        A2 *trim_array = cl_p->array;
-        int width = cl_p->value;
-        struct Pnm_rgb *ep = elem;
-        if (col < width) {
-                *(struct Pnm_rgb *) methods->at(*trim_array, col, row) = *ep;
-        }
-}
-
 /********** to_comp_video *************************************************
  *
  * This function creates a new array that is type struct comp_v. It then 
  * calls on our mapping function (apply_comp_vid) to place everything in the
  * new array of the different type. It returns Pnm_ppm with the new array.
+ * If it is given tables (comp_table_new), pixels are converted with them.
  *
  * Parameters:
  *      Pnm_ppm my_ppm          the Pnm_ppm
  *      A2Methods_T methods     methods given
+ *      comp_table table        the tables, or NULL to do the arithmetic
  *
  * Return: Pnm_ppm
  *
- * Expects: my_ppm is not NULL, methods is not NULL
+ * Expects: my_ppm is not NULL, methods is not NULL, table is NULL or made 
+ *          for the ppm's denominator
  *     
  * Notes: We free our old array here! We ALLOC new array using methods->new
- *        but we do not free it. Compression
+ *        but we do not free it. Only the ppm's width and height of the old
+ *        array are read, which after trim_ppm can be less than all of it.
+ *        The pixels can be ppm_rgb8's or struct Pnm_rgb's (see ppm_read).
+ *        Compression
  *      
  *************************************************************************/
-Pnm_ppm to_comp_video(Pnm_ppm my_ppm, A2Methods_T methods)
+Pnm_ppm to_comp_video(Pnm_ppm my_ppm, A2Methods_T methods, 
+                      comp_table table)
 {
         assert(my_ppm != NULL);
         assert(methods != NULL);
+        assert(table == NULL || 
+               comp_table_denom(table) == my_ppm->denominator);
 
         A2 new_array = methods->new(my_ppm->width, my_ppm->height, 
                                     sizeof(struct comp_v));
@@ -219,6 +176,10 @@ Pnm_ppm to_comp_video(Pnm_ppm my_ppm, A2Methods_T methods)
         a_m.array = new_array;
         a_m.methods = methods;  
         a_m.value = my_ppm->denominator;                         
+        a_m.width = my_ppm->width;
+        a_m.height = my_ppm->height;
+        a_m.bytes = methods->size(my_ppm->pixels) == sizeof(ppm_rgb8);
+        a_m.table = table;
         void *cl = &a_m;
         methods->map_default(my_ppm->pixels, apply_comp_vid, cl);
         methods->free(&my_ppm->pixels);
@@ -226,6 +187,51 @@ Pnm_ppm to_comp_video(Pnm_ppm my_ppm, A2Methods_T methods)
         return my_ppm;
 }
 
+/********** to_comp_planes ************************************************
+ *
+ * This function is the planar version of to_comp_video: it converts the 
+ * pixels a whole row at a time (comp_vid_row) into separate Y, pB, and pR
+ * planes (see comp_planes_row) instead of an array of comp_v's.
+ *
+ * Parameters:
+ *      Pnm_ppm my_ppm          the Pnm_ppm, with plain methods
+ *      comp_table table        the tables, or NULL to do the arithmetic
+ *
+ * Return: Pnm_ppm, whose pixels are COMP_PLANES planes of floats made by 
+ *         UArray2_new_planes
+ *
+ * Expects: my_ppm is not NULL, its methods are one of the plain suites 
+ *          (uarray2rows.h), table is NULL or made for its denominator
+ *     
+ * Notes: frees the old array, as to_comp_video does. The rows are fastest
+ *        to read from a row-major array, but either layout works. 
+ *        Compression
+ *      
+ *************************************************************************/
+Pnm_ppm to_comp_planes(Pnm_ppm my_ppm, comp_table table)
+{
+        assert(my_ppm != NULL);
+        A2Methods_T methods = my_ppm->methods;
+        assert(uarray2_methods_is_plain(methods));
+        assert(table == NULL || 
+               comp_table_denom(table) == my_ppm->denominator);
+
+        A2 new_array = UArray2_new_planes(my_ppm->width, my_ppm->height, 
+                                          COMP_PLANES, sizeof(float));
+        array_methods a_m;
+        a_m.array = new_array;
+        a_m.methods = methods;
+        a_m.value = my_ppm->denominator;
+        a_m.width = my_ppm->width;
+        a_m.height = my_ppm->height;
+        a_m.bytes = methods->size(my_ppm->pixels) == sizeof(ppm_rgb8);
+        a_m.table = table;
+        UArray2_map_row_spans(my_ppm->pixels, comp_vid_row, &a_m);
+        methods->free(&my_ppm->pixels);
+        my_ppm->pixels = new_array;
+        return my_ppm;
+}
+
 /********** apply_comp_vid **************************************************
  *
  * This function is the apply function for when we change the values from 
@@ -244,7 +250,8 @@ Pnm_ppm to_comp_video(Pnm_ppm my_ppm, A2Methods_T methods)
  * Expects: closure is not NULL, elem is not NULL, assert that a is between 
  *          0 and 1.
  *     
- * Notes: We void col, row, and the array, Compression
+ * Notes: We void the array. Elements past the closure's width or height 
+ *        were trimmed off and are skipped. Compression
  *      
  *************************************************************************/
 void apply_comp_vid(int col, int row, A2 array, void *elem, void *cl)
@@ -256,33 +263,104 @@ void apply_comp_vid(int col, int row, A2 array, void *elem, void *cl)
         assert(elem != NULL);
 
         array_methods *a_m = cl;
+        if (col >= a_m->width || row >= a_m->height) {
+                return;         /* trimmed off */
+        }
         A2 new_array = a_m->array;
         A2Methods_T methods = a_m->methods;
         int denominator = a_m->value;
-        struct Pnm_rgb *rgb = elem;
 
-        /* Get the RGB values as floats */
-        float r = (float)rgb->red / denominator;
-        float g = (float)rgb->green / denominator;
-        float b = (float)rgb->blue / denominator;
-        
-        /* Find y, pB, pR */
-        comp_v comp_vid_elem;
-        comp_vid_elem.y = 0.299 * r + 0.587 * g + 0.114 * b;
+        struct Pnm_rgb rgb = get_rgb(elem, a_m->bytes);
+        comp_v comp_vid_elem = a_m->table != NULL 
+                               ? table_to_comp(a_m->table, rgb)
+                               : rgb_to_comp(rgb, denominator);
         assert(comp_vid_elem.y >= 0 && comp_vid_elem.y <= 1);
-        comp_vid_elem.pB = -0.168736 * r - 0.33125 * g + 0.5 * b;
-        comp_vid_elem.pR = 0.5 * r - 0.418688 * g - 0.081312 * b;
 
         /* Place in the array */
         *(struct comp_v *)methods->at(new_array, col, row) = comp_vid_elem;
 }
 
 
+/********** comp_vid_row ****************************************************
+ *
+ * This function is the row span version of apply_comp_vid: it changes a 
+ * whole row of RGB values to component video values and places them in the 
+ * same row of each of the new array's planes.
+ *
+ * Parameters:
+ *      int row                          row
+ *      UArray2_T array                  the array
+ *      void *span                       the row's ppm_rgb8's or Pnm_rgb's
+ *      int n                            how many there are
+ *      void *cl                         closure struct
+ *
+ * Return: void
+ *
+ * Expects: closure is not NULL, the new array is made by UArray2_new_planes
+ *          as wide as the closure's width, assert that a is between 0 and 1.
+ *     
+ * Notes: The kind of pixel and whether there are tables are the same for 
+ *        every row, so the row is handed whole to the matching row kernel,
+ *        and Y is checked once the row is done. The kernels are the exact 
+ *        ones (tables or rgb_to_comp, never the vector ones), so the output
+ *        is the same as apply_comp_vid's with any other layout. Rows past the closure's height, and pixels past its 
+ *        width, were trimmed off and are skipped. Compression
+ *      
+ *************************************************************************/
+static void comp_vid_row(int row, UArray2_T array, void *span, int n, 
+                         void *cl)
+{
+        (void) array;
+        assert(cl != NULL);
+        array_methods *a_m = cl;
+        if (row >= a_m->height) {
+                return;         /* trimmed off */
+        }
+        n = a_m->width;
+        comp_row comp = comp_planes_row(a_m->array, row);
+
+        if (a_m->table != NULL && a_m->bytes) {
+                table_rgb8_row_to_comp(a_m->table, span, n, comp);
+        } else if (a_m->table != NULL) {
+                table_row_to_comp(a_m->table, span, n, comp);
+        } else if (a_m->bytes) {
+                rgb8_row_to_comp_scalar(span, n, a_m->value, comp);
+        } else {
+                rgb_row_to_comp(span, n, a_m->value, comp);
+        }
+        assert(y_in_range(comp.y, n));
+}
+
+/********** y_in_range ******************************************************
+ *
+ * This function checks that a row of Y values are all between 0 and 1.
+ *
+ * Parameters:
+ *      const float *y                   the Y values
+ *      int n                            how many there are
+ *
+ * Return: true if every one is in range
+ *
+ * Expects: y holds n values
+ *     
+ * Notes: the loop has no branches, so it can be vectorized
+ *      
+ *************************************************************************/
+static bool y_in_range(const float *y, int n)
+{
+        int in_range = 1;
+        for (int i = 0; i < n; i++) {
+                in_range &= (y[i] >= 0) & (y[i] <= 1);
+        }
+        return in_range != 0;
+}
+
 /********** to_rgb *******************************************************
  *
- * This function creates a new array that is type struct Pnm_rgb. It then 
- * calls on our mapping function (apply_to_rgb) to place everything in the
- * new array of the different type. It returns Pnm_ppm with the new array.
+ * This function creates a new array that is type ppm_rgb8 (or struct 
+ * Pnm_rgb if the denominator is over 255). It then calls on our mapping 
+ * function (apply_to_rgb) to place everything in the new array of the 
+ * different type. It returns Pnm_ppm with the new array.
  *
  * Parameters:
  *      Pnm_ppm my_ppm          the Pnm_ppm
@@ -301,12 +379,19 @@ Pnm_ppm to_rgb(Pnm_ppm my_ppm, A2Methods_T methods)
         assert(my_ppm != NULL);
         assert(methods != NULL);
 
+        /* a ppm_rgb8 holds samples of up to 255 */
+        bool bytes = my_ppm->denominator <= 255;
         A2 new_array = methods->new(my_ppm->width, my_ppm->height, 
-                                    sizeof(struct Pnm_rgb));
+                                    bytes ? sizeof(ppm_rgb8) 
+                                          : sizeof(struct Pnm_rgb));
         array_methods a_m;
         a_m.array = new_array;
         a_m.methods = methods;  
         a_m.value = my_ppm->denominator;                         
+        a_m.width = my_ppm->width;
+        a_m.height = my_ppm->height;
+        a_m.bytes = bytes;
+        a_m.table = NULL;
         void *cl = &a_m;
         methods->map_default(my_ppm->pixels, apply_to_rgb, cl);
         methods->free(&my_ppm->pixels);
@@ -314,6 +399,51 @@ Pnm_ppm to_rgb(Pnm_ppm my_ppm, A2Methods_T methods)
         return my_ppm;
 }
 
+/********** planes_to_rgb *************************************************
+ *
+ * This function is the planar version of to_rgb: the comp video values are
+ * in planes (see to_comp_planes), and it converts a whole row at a time 
+ * (to_rgb_row).
+ *
+ * Parameters:
+ *      Pnm_ppm my_ppm          the Pnm_ppm, with plain methods
+ *
+ * Return: Pnm_ppm, with ppm_rgb8 pixels (or struct Pnm_rgb's if the 
+ *         denominator is over 255) in an array made by its methods
+ *
+ * Expects: my_ppm is not NULL, its methods are one of the plain suites 
+ *          (uarray2rows.h), and its pixels are COMP_PLANES planes made by
+ *          UArray2_new_planes
+ *     
+ * Notes: frees the planes. Decompression
+ *      
+ *************************************************************************/
+Pnm_ppm planes_to_rgb(Pnm_ppm my_ppm)
+{
+        assert(my_ppm != NULL);
+        A2Methods_T methods = my_ppm->methods;
+        assert(uarray2_methods_is_plain(methods));
+        assert(UArray2_planes(my_ppm->pixels) == COMP_PLANES);
+
+        bool bytes = my_ppm->denominator <= 255;
+        A2 new_array = methods->new(my_ppm->width, my_ppm->height, 
+                                    bytes ? sizeof(ppm_rgb8) 
+                                          : sizeof(struct Pnm_rgb));
+        array_methods a_m;
+        /* walks the new array, reading the planes */
+        a_m.array = my_ppm->pixels;
+        a_m.methods = methods;
+        a_m.value = my_ppm->denominator;
+        a_m.width = my_ppm->width;
+        a_m.height = my_ppm->height;
+        a_m.bytes = bytes;
+        a_m.table = NULL;
+        UArray2_map_row_spans(new_array, to_rgb_row, &a_m);
+        methods->free(&my_ppm->pixels);
+        my_ppm->pixels = new_array;
+        return my_ppm;
+}
+
 /********** apply_comp_vid ************************************************
  *
  * This function is the apply function for when we change the values from 
@@ -347,20 +477,133 @@ void apply_to_rgb(int col, int row, A2 array, void *elem, void *cl)
         A2 new_array = a_m->array;
         A2Methods_T methods = a_m->methods;
         float denom = (float)a_m->value;
-        
-        float y = comp_vid_elem->y;
-        float pB = comp_vid_elem->pB;
-        float pR = comp_vid_elem->pR;
 
-        struct Pnm_rgb rgb;
+        struct Pnm_rgb rgb = comp_to_rgb(*comp_vid_elem, denom);
 
-        /* Get rgb values */
-        rgb.red = rgb_help(((1.0 * y) + (0.0 * pB) + (1.402 * pR)), denom);
-        rgb.green = rgb_help(((1.0 * y) - (0.344136 * pB) - (0.714136 * pR)),
-                              denom);
-        rgb.blue = rgb_help(((1.0 * y) + (1.772 * pB) + (0.0 * pR)), denom);
+        put_rgb(methods->at(new_array, col, row), rgb, a_m->bytes);
+}
+
+/********** to_rgb_row ******************************************************
+ *
+ * This function is the row span version of apply_to_rgb: it changes a whole
+ * row of comp video values, from the same row of each plane of the array in
+ * the closure, to RGB values and places them in the span.
+ *
+ * Parameters:
+ *      int row                          row
+ *      UArray2_T array                  the new array
+ *      void *span                       the new array's row
+ *      int n                            how many pixels there are
+ *      void *cl                         closure struct
+ *
+ * Return: void
+ *
+ * Expects: closure is not NULL, the closure's array is made by 
+ *          UArray2_new_planes and is as wide as the span
+ *     
+ * Notes: ppm_rgb8's are made by comp_row_to_rgb8_scalar and Pnm_rgb's by
+ *        a loop with no branches in it, both with comp_to_rgb's double 
+ *        arithmetic, so the output is the same as apply_to_rgb's with any 
+ *        other layout. Decompression
+ *      
+ *************************************************************************/
+static void to_rgb_row(int row, UArray2_T array, void *span, int n, void *cl)
+{
+        (void) array;
+        assert(cl != NULL);
+        array_methods *a_m = cl;
+        comp_row comp = comp_planes_row(a_m->array, row);
+        float denom = (float)a_m->value;
+
+        if (a_m->bytes) {
+                comp_row_to_rgb8_scalar(comp, n, denom, span);
+                return;
+        }
+        assert(denom != 0);
+        struct Pnm_rgb *rgb = span;
+        for (int i = 0; i < n; i++) {
+                /* comp_to_rgb, with rgb_help's clamp written as selects */
+                float y = comp.y[i], pB = comp.pB[i], pR = comp.pR[i];
+                float red = (1.0 * y) + (0.0 * pB) + (1.402 * pR);
+                float green = (1.0 * y) - (0.344136 * pB) - 
+                              (0.714136 * pR);
+                float blue = (1.0 * y) + (1.772 * pB) + (0.0 * pR);
+                /* at most denom, so converting through int is the same 
+                   and needs no branch */
+                rgb[i].red = (int)(clamp_unit(red) * denom);
+                rgb[i].green = (int)(clamp_unit(green) * denom);
+                rgb[i].blue = (int)(clamp_unit(blue) * denom);
+        }
+}
+
+/********** clamp_unit *****************************************************
+ *
+ * This function clamps a number to [0, 1] the way rgb_help does.
+ *
+ * Parameters:
+ *      float num                        the number
+ *
+ * Return: 0 if num is below 0, 1 if it is above 1, and num otherwise
+ *
+ * Expects: N/A
+ *     
+ * Notes: both comparisons are made on num itself, so that gcc turns them 
+ *        into selects and can vectorize a loop that calls this
+ *      
+ *************************************************************************/
+static inline float clamp_unit(float num)
+{
+        float high = num > 1 ? 1 : num;
+        return num < 0 ? 0 : high;
+}
+
+/********** get_rgb ********************************************************
+ *
+ * This function reads a pixel that is either a ppm_rgb8 or a struct Pnm_rgb.
+ *
+ * Parameters:
+ *      const void *pixel                the pixel
+ *      bool bytes                       whether it is a ppm_rgb8
+ *
+ * Return: the pixel as a struct Pnm_rgb
+ *
+ * Expects: pixel is not NULL
+ *     
+ *************************************************************************/
+static inline struct Pnm_rgb get_rgb(const void *pixel, bool bytes)
+{
+        if (!bytes) {
+                return *(const struct Pnm_rgb *)pixel;
+        }
+        const ppm_rgb8 *p = pixel;
+        struct Pnm_rgb rgb = { p->red, p->green, p->blue };
+        return rgb;
+}
 
-        *(struct Pnm_rgb *)methods->at(new_array, col, row) = rgb;
+/********** put_rgb ********************************************************
+ *
+ * This function stores a pixel as a ppm_rgb8 or a struct Pnm_rgb.
+ *
+ * Parameters:
+ *      void *pixel                      where to store it
+ *      struct Pnm_rgb rgb               the pixel
+ *      bool bytes                       whether to store a ppm_rgb8
+ *
+ * Return: void
+ *
+ * Expects: pixel is not NULL, each of rgb's values fits in a byte if bytes
+ *     
+ *************************************************************************/
+static inline void put_rgb(void *pixel, struct Pnm_rgb rgb, bool bytes)
+{
+        if (!bytes) {
+                *(struct Pnm_rgb *)pixel = rgb;
+                return;
+        }
+        ppm_rgb8 *p = pixel;
+        p->red = rgb.red;
+        p->green = rgb.green;
+        p->blue = rgb.blue;
 }
 
 /********** rgb_help **************************************************
@@ -396,4 +639,1323 @@ float rgb_help(float num, float denom)
         return num * denom; 
 }
 
+/********** rgb_to_comp **************************************************
+ *
+ * This function converts a single RGB pixel into its component video values
+ * (Y, pB, and pR). It is the arithmetic behind apply_comp_vid, pulled out so
+ * the fused pipeline can convert pixels without building a new array.
+ *
+ * Parameters:
+ *      struct Pnm_rgb rgb      the pixel to convert
+ *      float denom             denominator of the image the pixel came from
+ *
+ * Return: the comp video values of the pixel
+ *
+ * Expects: denom is not 0
+ *     
+ * Notes: Compression
+ *      
+ *************************************************************************/
+comp_v rgb_to_comp(struct Pnm_rgb rgb, float denom)
+{
+        /* Get the RGB values as floats */
+        float r = (float)rgb.red / denom;
+        float g = (float)rgb.green / denom;
+        float b = (float)rgb.blue / denom;
+
+        /* Find y, pB, pR */
+        comp_v comp_vid_elem;
+        comp_vid_elem.y = 0.299 * r + 0.587 * g + 0.114 * b;
+        comp_vid_elem.pB = -0.168736 * r - 0.33125 * g + 0.5 * b;
+        comp_vid_elem.pR = 0.5 * r - 0.418688 * g - 0.081312 * b;
+        return comp_vid_elem;
+}
+
+/********** comp_to_rgb **************************************************
+ *
+ * This function converts a single pixel from component video values back to
+ * RGB values scaled to the given denominator. It is the arithmetic behind
+ * apply_to_rgb, pulled out so the fused pipeline can share it.
+ *
+ * Parameters:
+ *      comp_v comp_vid         the pixel to convert
+ *      float denom             denominator of the resulting image
+ *
+ * Return: the RGB values of the pixel
+ *
+ * Expects: denom is not 0
+ *     
+ * Notes: calls on helper function rgb_help to clamp values. Decompression
+ *      
+ *************************************************************************/
+struct Pnm_rgb comp_to_rgb(comp_v comp_vid, float denom)
+{
+        float y = comp_vid.y;
+        float pB = comp_vid.pB;
+        float pR = comp_vid.pR;
+
+        struct Pnm_rgb rgb;
+
+        /* Get rgb values */
+        rgb.red = rgb_help(((1.0 * y) + (0.0 * pB) + (1.402 * pR)), denom);
+        rgb.green = rgb_help(((1.0 * y) - (0.344136 * pB) - (0.714136 * pR)),
+                              denom);
+        rgb.blue = rgb_help(((1.0 * y) + (1.772 * pB) + (0.0 * pR)), denom);
+        return rgb;
+}
+
+/********** comp_row_new **************************************************
+ *
+ * This function allocates a row of n pixels in planar comp video form, that
+ * is, separate arrays of Y, pB, and pR values.
+ *
+ * Parameters:
+ *      int n                   number of pixels in the row
+ *
+ * Return: the new row
+ *
+ * Expects: n is not negative
+ *     
+ * Notes: the row must be freed with comp_row_free
+ *      
+ *************************************************************************/
+comp_row comp_row_new(int n)
+{
+        assert(n >= 0);
+        comp_row row;
+        row.y = ALLOC((n + 1) * sizeof(float));
+        row.pB = ALLOC((n + 1) * sizeof(float));
+        row.pR = ALLOC((n + 1) * sizeof(float));
+        return row;
+}
+
+/********** comp_row_free *************************************************
+ *
+ * This function frees a row made by comp_row_new.
+ *
+ * Parameters:
+ *      comp_row *row           the row to free
+ *
+ * Return: void
+ *
+ * Expects: row is not NULL
+ *     
+ * Notes: 
+ *      
+ *************************************************************************/
+void comp_row_free(comp_row *row)
+{
+        assert(row != NULL);
+        FREE(row->y);
+        FREE(row->pB);
+        FREE(row->pR);
+}
+
+/********** comp_planes_row ***********************************************
+ *
+ * This function finds one row of an array of comp video planes.
+ *
+ * Parameters:
+ *      A2 planes               array made by UArray2_new_planes with 
+ *                              COMP_PLANES planes of floats
+ *      int row                 the row
+ *
+ * Return: the row's Y, pB, and pR values, each contiguous and starting on a
+ *         cache line
+ *
+ * Expects: planes is not NULL, row is in range
+ *     
+ *************************************************************************/
+comp_row comp_planes_row(A2 planes, int row)
+{
+        assert(planes != NULL);
+        comp_row comp;
+        comp.y = UArray2_plane_row(planes, COMP_Y, row);
+        comp.pB = UArray2_plane_row(planes, COMP_PB, row);
+        comp.pR = UArray2_plane_row(planes, COMP_PR, row);
+        return comp;
+}
+
+/********** comp_row_offset ***********************************************
+ *
+ * This function returns the part of a planar row that starts at pixel i.
+ *
+ * Parameters:
+ *      comp_row row            the row
+ *      int i                   the first pixel of the new row
+ *
+ * Return: the row starting at pixel i
+ *
+ * Expects: N/A
+ *     
+ * Notes: used to hand the leftover pixels of a vector loop to the scalar one
+ *      
+ *************************************************************************/
+static inline comp_row comp_row_offset(comp_row row, int i)
+{
+        row.y += i;
+        row.pB += i;
+        row.pR += i;
+        return row;
+}
+
+/********** rgb_row_to_comp ***********************************************
+ *
+ * This function converts a row of Pnm_rgb's into planar comp video values.
+ *
+ * Parameters:
+ *      const struct Pnm_rgb *rgb       the row of pixels
+ *      int n                           number of pixels to convert
+ *      float denom                     denominator of the image
+ *      comp_row comp                   where to put the comp video values
+ *
+ * Return: void
+ *
+ * Expects: rgb is not NULL, comp holds n pixels, denom is not 0
+ *     
+ * Notes: same results as rgb_to_comp, Compression
+ *      
+ *************************************************************************/
+void rgb_row_to_comp(const struct Pnm_rgb *rgb, int n, float denom, 
+                     comp_row comp)
+{
+        assert(rgb != NULL);
+        for (int i = 0; i < n; i++) {
+                comp_v comp_vid_elem = rgb_to_comp(rgb[i], denom);
+                comp.y[i] = comp_vid_elem.y;
+                comp.pB[i] = comp_vid_elem.pB;
+                comp.pR[i] = comp_vid_elem.pR;
+        }
+}
+
+/********** rgb8_row_to_comp_scalar ***************************************
+ *
+ * This function converts a row of interleaved 8-bit rgb values into planar
+ * comp video values one pixel at a time.
+ *
+ * Parameters:
+ *      const unsigned char *rgb        the row of pixels, 3 bytes each
+ *      int n                           number of pixels to convert
+ *      float denom                     denominator of the image
+ *      comp_row comp                   where to put the comp video values
+ *
+ * Return: void
+ *
+ * Expects: rgb is not NULL, comp holds n pixels, denom is not 0
+ *     
+ * Notes: the fallback when the CPU has no vector unit we can use. Same 
+ *        results as rgb_to_comp. Compression
+ *      
+ *************************************************************************/
+static void rgb8_row_to_comp_scalar(const unsigned char *rgb, int n, 
+                                    float denom, comp_row comp)
+{
+        for (int i = 0; i < n; i++) {
+                struct Pnm_rgb pixel = { rgb[3 * i], rgb[3 * i + 1], 
+                                         rgb[3 * i + 2] };
+                comp_v comp_vid_elem = rgb_to_comp(pixel, denom);
+                comp.y[i] = comp_vid_elem.y;
+                comp.pB[i] = comp_vid_elem.pB;
+                comp.pR[i] = comp_vid_elem.pR;
+        }
+}
+
+/********** comp_row_to_rgb8_scalar ***************************************
+ *
+ * This function converts a row of planar comp video values into interleaved
+ * 8-bit rgb values one pixel at a time.
+ *
+ * Parameters:
+ *      comp_row comp                   the comp video values
+ *      int n                           number of pixels to convert
+ *      float denom                     denominator of the image, <= 255
+ *      unsigned char *rgb              where to put the pixels, 3 bytes each
+ *
+ * Return: void
+ *
+ * Expects: rgb is not NULL, comp holds n pixels, denom is not 0
+ *     
+ * Notes: the fallback when the CPU has no vector unit we can use. Same 
+ *        results as comp_to_rgb. Decompression
+ *      
+ *************************************************************************/
+static void comp_row_to_rgb8_scalar(comp_row comp, int n, float denom, 
+                                    unsigned char *rgb)
+{
+        for (int i = 0; i < n; i++) {
+                comp_v comp_vid_elem = { comp.y[i], comp.pB[i], comp.pR[i] };
+                struct Pnm_rgb pixel = comp_to_rgb(comp_vid_elem, denom);
+                rgb[3 * i] = pixel.red;
+                rgb[3 * i + 1] = pixel.green;
+                rgb[3 * i + 2] = pixel.blue;
+        }
+}
+
+#ifdef INT_SIMD
+
+/********** comp_of_rgb_sse ***********************************************
+ *
+ * This function converts 4 pixels from rgb (already divided by the 
+ * denominator) to comp video and stores them.
+ *
+ * Parameters:
+ *      __m128 r, g, b                  the red, green, and blue values
+ *      float *y, *pB, *pR              where to store the comp video values
+ *
+ * Return: void
+ *
+ * Expects: 4 floats can be written to each of y, pB, and pR
+ *     
+ * Notes: Compression
+ *      
+ *************************************************************************/
+__attribute__((target("sse4.1")))
+static inline void comp_of_rgb_sse(__m128 r, __m128 g, __m128 b, float *y, 
+                                   float *pB, float *pR)
+{
+        _mm_storeu_ps(y, _mm_add_ps(_mm_add_ps(
+                         _mm_mul_ps(_mm_set1_ps(0.299f), r),
+                         _mm_mul_ps(_mm_set1_ps(0.587f), g)),
+                         _mm_mul_ps(_mm_set1_ps(0.114f), b)));
+        _mm_storeu_ps(pB, _mm_add_ps(_mm_sub_ps(
+                          _mm_mul_ps(_mm_set1_ps(-0.168736f), r),
+                          _mm_mul_ps(_mm_set1_ps(0.33125f), g)),
+                          _mm_mul_ps(_mm_set1_ps(0.5f), b)));
+        _mm_storeu_ps(pR, _mm_sub_ps(_mm_sub_ps(
+                          _mm_mul_ps(_mm_set1_ps(0.5f), r),
+                          _mm_mul_ps(_mm_set1_ps(0.418688f), g)),
+                          _mm_mul_ps(_mm_set1_ps(0.081312f), b)));
+}
+
+/********** rgb8_row_to_comp_sse ******************************************
+ *
+ * SSE4.1 version of rgb8_row_to_comp, 8 pixels at a time. 
+ *
+ * Parameters: see rgb8_row_to_comp
+ *
+ * Return: void
+ *
+ * Expects: see rgb8_row_to_comp
+ *     
+ * Notes: leftover pixels go through rgb8_row_to_comp_scalar
+ *      
+ *************************************************************************/
+__attribute__((target("sse4.1")))
+static void rgb8_row_to_comp_sse(const unsigned char *rgb, int n, 
+                                 float denom, comp_row comp)
+{
+        __m128 d = _mm_set1_ps(denom);
+        int i = 0;
+        for (; i + 8 <= n; i += 8) {
+                __m128i r8, g8, b8;
+                load_rgb8(rgb + 3 * i, &r8, &g8, &b8);
+                for (int half = 0; half < 8; half += 4) {
+                        __m128 r = _mm_div_ps(_mm_cvtepi32_ps(
+                                              _mm_cvtepu8_epi32(r8)), d);
+                        __m128 g = _mm_div_ps(_mm_cvtepi32_ps(
+                                              _mm_cvtepu8_epi32(g8)), d);
+                        __m128 b = _mm_div_ps(_mm_cvtepi32_ps(
+                                              _mm_cvtepu8_epi32(b8)), d);
+                        comp_of_rgb_sse(r, g, b, comp.y + i + half, 
+                                        comp.pB + i + half, 
+                                        comp.pR + i + half);
+                        r8 = _mm_srli_si128(r8, 4);
+                        g8 = _mm_srli_si128(g8, 4);
+                        b8 = _mm_srli_si128(b8, 4);
+                }
+        }
+        rgb8_row_to_comp_scalar(rgb + 3 * i, n - i, denom, 
+                                comp_row_offset(comp, i));
+}
+
+/********** rgb8_row_to_comp_avx2 *****************************************
+ *
+ * AVX2 version of rgb8_row_to_comp, 8 pixels at a time.
+ *
+ * Parameters: see rgb8_row_to_comp
+ *
+ * Return: void
+ *
+ * Expects: see rgb8_row_to_comp
+ *     
+ * Notes: leftover pixels go through rgb8_row_to_comp_scalar
+ *      
+ *************************************************************************/
+__attribute__((target("avx2")))
+static void rgb8_row_to_comp_avx2(const unsigned char *rgb, int n, 
+                                  float denom, comp_row comp)
+{
+        __m256 d = _mm256_set1_ps(denom);
+        int i = 0;
+        for (; i + 8 <= n; i += 8) {
+                __m128i r8, g8, b8;
+                load_rgb8(rgb + 3 * i, &r8, &g8, &b8);
+                __m256 r = _mm256_div_ps(_mm256_cvtepi32_ps(
+                                         _mm256_cvtepu8_epi32(r8)), d);
+                __m256 g = _mm256_div_ps(_mm256_cvtepi32_ps(
+                                         _mm256_cvtepu8_epi32(g8)), d);
+                __m256 b = _mm256_div_ps(_mm256_cvtepi32_ps(
+                                         _mm256_cvtepu8_epi32(b8)), d);
+                _mm256_storeu_ps(comp.y + i, _mm256_add_ps(_mm256_add_ps(
+                                 _mm256_mul_ps(_mm256_set1_ps(0.299f), r),
+                                 _mm256_mul_ps(_mm256_set1_ps(0.587f), g)),
+                                 _mm256_mul_ps(_mm256_set1_ps(0.114f), b)));
+                _mm256_storeu_ps(comp.pB + i, _mm256_add_ps(_mm256_sub_ps(
+                                 _mm256_mul_ps(_mm256_set1_ps(-0.168736f), r),
+                                 _mm256_mul_ps(_mm256_set1_ps(0.33125f), g)),
+                                 _mm256_mul_ps(_mm256_set1_ps(0.5f), b)));
+                _mm256_storeu_ps(comp.pR + i, _mm256_sub_ps(_mm256_sub_ps(
+                                 _mm256_mul_ps(_mm256_set1_ps(0.5f), r),
+                                 _mm256_mul_ps(_mm256_set1_ps(0.418688f), g)),
+                                 _mm256_mul_ps(_mm256_set1_ps(0.081312f), b)));
+        }
+        rgb8_row_to_comp_scalar(rgb + 3 * i, n - i, denom, 
+                                comp_row_offset(comp, i));
+}
+
+/********** rgb8_of_comp_sse **********************************************
+ *
+ * This function converts 4 pixels from comp video to rgb values, clamped to 
+ * [0, 1] like rgb_help does, scaled by the denominator, and truncated to 
+ * 32-bit ints.
+ *
+ * Parameters:
+ *      const float *y, *pB, *pR        the comp video values
+ *      __m128 d                        the denominator in every lane
+ *      __m128i *r, *g, *b              where to put the rgb values
+ *
+ * Return: void
+ *
+ * Expects: 4 floats can be read from each of y, pB, and pR
+ *     
+ * Notes: Decompression
+ *      
+ *************************************************************************/
+__attribute__((target("sse4.1")))
+static inline void rgb8_of_comp_sse(const float *y, const float *pB, 
+                                    const float *pR, __m128 d, __m128i *r,
+                                    __m128i *g, __m128i *b)
+{
+        __m128 zero = _mm_setzero_ps();
+        __m128 one = _mm_set1_ps(1.0f);
+        __m128 yv = _mm_loadu_ps(y);
+        __m128 pBv = _mm_loadu_ps(pB);
+        __m128 pRv = _mm_loadu_ps(pR);
+        __m128 rf = _mm_add_ps(yv, _mm_mul_ps(_mm_set1_ps(1.402f), pRv));
+        __m128 gf = _mm_sub_ps(_mm_sub_ps(yv, 
+                               _mm_mul_ps(_mm_set1_ps(0.344136f), pBv)),
+                               _mm_mul_ps(_mm_set1_ps(0.714136f), pRv));
+        __m128 bf = _mm_add_ps(yv, _mm_mul_ps(_mm_set1_ps(1.772f), pBv));
+        *r = _mm_cvttps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(rf, zero), 
+                                                    one), d));
+        *g = _mm_cvttps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(gf, zero), 
+                                                    one), d));
+        *b = _mm_cvttps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(bf, zero), 
+                                                    one), d));
+}
+
+/********** comp_row_to_rgb8_sse ******************************************
+ *
+ * SSE4.1 version of comp_row_to_rgb8, 8 pixels at a time.
+ *
+ * Parameters: see comp_row_to_rgb8
+ *
+ * Return: void
+ *
+ * Expects: see comp_row_to_rgb8
+ *     
+ * Notes: leftover pixels go through comp_row_to_rgb8_scalar
+ *      
+ *************************************************************************/
+__attribute__((target("sse4.1")))
+static void comp_row_to_rgb8_sse(comp_row comp, int n, float denom, 
+                                 unsigned char *rgb)
+{
+        __m128 d = _mm_set1_ps(denom);
+        int i = 0;
+        for (; i + 8 <= n; i += 8) {
+                __m128i r0, g0, b0, r1, g1, b1;
+                rgb8_of_comp_sse(comp.y + i, comp.pB + i, comp.pR + i, d, 
+                                 &r0, &g0, &b0);
+                rgb8_of_comp_sse(comp.y + i + 4, comp.pB + i + 4, 
+                                 comp.pR + i + 4, d, &r1, &g1, &b1);
+                __m128i r = _mm_packus_epi32(r0, r1);
+                __m128i g = _mm_packus_epi32(g0, g1);
+                __m128i b = _mm_packus_epi32(b0, b1);
+                store_rgb8(rgb + 3 * i, _mm_packus_epi16(r, r), 
+                           _mm_packus_epi16(g, g), _mm_packus_epi16(b, b));
+        }
+        comp_row_to_rgb8_scalar(comp_row_offset(comp, i), n - i, denom, 
+                                rgb + 3 * i);
+}
+
+/********** pack_rgb8_avx2 ************************************************
+ *
+ * This function clamps 8 rgb values to [0, 1] like rgb_help does, scales 
+ * them by the denominator, and truncates them to bytes.
+ *
+ * Parameters:
+ *      __m256 x                        the values
+ *      __m256 d                        the denominator in every lane
+ *
+ * Return: the 8 bytes, in the low 8 bytes
+ *
+ * Expects: the denominator is at most 255
+ *     
+ * Notes: Decompression
+ *      
+ *************************************************************************/
+__attribute__((target("avx2")))
+static inline __m128i pack_rgb8_avx2(__m256 x, __m256 d)
+{
+        x = _mm256_min_ps(_mm256_max_ps(x, _mm256_setzero_ps()), 
+                          _mm256_set1_ps(1.0f));
+        __m256i v = _mm256_cvttps_epi32(_mm256_mul_ps(x, d));
+        __m128i w = _mm_packus_epi32(_mm256_castsi256_si128(v), 
+                                     _mm256_extracti128_si256(v, 1));
+        return _mm_packus_epi16(w, w);
+}
+
+/********** comp_row_to_rgb8_avx2 *****************************************
+ *
+ * AVX2 version of comp_row_to_rgb8, 8 pixels at a time.
+ *
+ * Parameters: see comp_row_to_rgb8
+ *
+ * Return: void
+ *
+ * Expects: see comp_row_to_rgb8
+ *     
+ * Notes: leftover pixels go through comp_row_to_rgb8_scalar
+ *      
+ *************************************************************************/
+__attribute__((target("avx2")))
+static void comp_row_to_rgb8_avx2(comp_row comp, int n, float denom, 
+                                  unsigned char *rgb)
+{
+        __m256 d = _mm256_set1_ps(denom);
+        int i = 0;
+        for (; i + 8 <= n; i += 8) {
+                __m256 y = _mm256_loadu_ps(comp.y + i);
+                __m256 pB = _mm256_loadu_ps(comp.pB + i);
+                __m256 pR = _mm256_loadu_ps(comp.pR + i);
+                __m256 r = _mm256_add_ps(y, _mm256_mul_ps(
+                                         _mm256_set1_ps(1.402f), pR));
+                __m256 g = _mm256_sub_ps(_mm256_sub_ps(y, _mm256_mul_ps(
+                                         _mm256_set1_ps(0.344136f), pB)),
+                                         _mm256_mul_ps(
+                                         _mm256_set1_ps(0.714136f), pR));
+                __m256 b = _mm256_add_ps(y, _mm256_mul_ps(
+                                         _mm256_set1_ps(1.772f), pB));
+                store_rgb8(rgb + 3 * i, pack_rgb8_avx2(r, d), 
+                           pack_rgb8_avx2(g, d), pack_rgb8_avx2(b, d));
+        }
+        comp_row_to_rgb8_scalar(comp_row_offset(comp, i), n - i, denom, 
+                                rgb + 3 * i);
+}
+
+#endif
+
+/********** rgb8_row_to_comp **********************************************
+ *
+ * This function converts a row of interleaved 8-bit rgb values (as found in
+ * a raw ppm) into planar comp video values. It uses the widest vector unit 
+ * the CPU has (AVX2, then SSE4.1), falling back to converting one pixel at 
+ * a time.
+ *
+ * Parameters:
+ *      const unsigned char *rgb        the row of pixels, 3 bytes each
+ *      int n                           number of pixels to convert
+ *      float denom                     denominator of the image, <= 255
+ *      comp_row comp                   where to put the comp video values
+ *
+ * Return: void
+ *
+ * Expects: rgb is not NULL, comp holds n pixels, denom is not 0
+ *     
+ * Notes: the vector kernels can differ from rgb_to_comp by up to 1e-6 (see
+ *        int.h). Compression
+ *      
+ *************************************************************************/
+void rgb8_row_to_comp(const unsigned char *rgb, int n, float denom, 
+                      comp_row comp)
+{
+        assert(rgb != NULL);
+        assert(denom != 0);
+#ifdef INT_SIMD
+        if (__builtin_cpu_supports("avx2")) {
+                rgb8_row_to_comp_avx2(rgb, n, denom, comp);
+                return;
+        }
+        if (__builtin_cpu_supports("sse4.1")) {
+                rgb8_row_to_comp_sse(rgb, n, denom, comp);
+                return;
+        }
+#endif
+        rgb8_row_to_comp_scalar(rgb, n, denom, comp);
+}
+
+/********** comp_row_to_rgb8 **********************************************
+ *
+ * This function converts a row of planar comp video values into interleaved
+ * 8-bit rgb values, clamping like rgb_help does. It uses the widest vector 
+ * unit the CPU has (AVX2, then SSE4.1), falling back to converting one pixel
+ * at a time.
+ *
+ * Parameters:
+ *      comp_row comp                   the comp video values
+ *      int n                           number of pixels to convert
+ *      float denom                     denominator of the image, <= 255
+ *      unsigned char *rgb              where to put the pixels, 3 bytes each
+ *
+ * Return: void
+ *
+ * Expects: rgb is not NULL, comp holds n pixels, denom is not 0
+ *     
+ * Notes: the vector kernels can differ from comp_to_rgb by 1 (see int.h).
+ *        Decompression
+ *      
+ *************************************************************************/
+void comp_row_to_rgb8(comp_row comp, int n, float denom, unsigned char *rgb)
+{
+        assert(rgb != NULL);
+        assert(denom != 0 && denom <= 255);
+#ifdef INT_SIMD
+        if (__builtin_cpu_supports("avx2")) {
+                comp_row_to_rgb8_avx2(comp, n, denom, rgb);
+                return;
+        }
+        if (__builtin_cpu_supports("sse4.1")) {
+                comp_row_to_rgb8_sse(comp, n, denom, rgb);
+                return;
+        }
+#endif
+        comp_row_to_rgb8_scalar(comp, n, denom, rgb);
+}
+
+/* 
+ * the rgb to comp video coefficients of rgb_to_comp, with the signs of the
+ * terms it subtracts folded in; rows are Y, pB, and pR, columns red, green,
+ * and blue
+ */
+static const double TABLE_COEFS[3][3] = {
+        {  0.299,     0.587,     0.114    },
+        { -0.168736, -0.33125,   0.5      },
+        {  0.5,      -0.418688, -0.081312 }
+};
+
+struct comp_table {
+        unsigned denom;
+        /* samples from 0 to limit - 1 are in the table */
+        unsigned limit;
+        /* shares[(channel * limit + sample) * 3 + output]: what a sample of 
+           the channel (red, green, blue) adds to the output (Y, pB, pR) */
+        double *shares;
+};
+
+/********** comp_table_new ************************************************
+ *
+ * This function builds the lookup tables rgb_to_comp's arithmetic can be 
+ * replaced with for one denominator.
+ *
+ * Parameters:
+ *      unsigned denom          the denominator
+ *
+ * Return: the new table
+ *
+ * Expects: denom is not 0
+ *     
+ * Notes: each share is the same double rgb_to_comp computes (the sample 
+ *        over denom as a float, times the coefficient). Every byte value 
+ *        has an entry even when denom is under 255, so rows of raw bytes 
+ *        can be looked up without checking. Must be freed with 
+ *        comp_table_free.
+ *      
+ *************************************************************************/
+comp_table comp_table_new(unsigned denom)
+{
+        assert(denom != 0);
+        comp_table table;
+        NEW(table);
+        table->denom = denom;
+        table->limit = (denom > 255 ? denom : 255) + 1;
+        table->shares = ALLOC(3 * 3 * table->limit * sizeof(double));
+        for (unsigned c = 0; c < 3; c++) {
+                for (unsigned v = 0; v < table->limit; v++) {
+                        float sample = (float)v / (float)denom;
+                        double *share = table->shares + 
+                                        (c * table->limit + v) * 3;
+                        for (unsigned out = 0; out < 3; out++) {
+                                share[out] = TABLE_COEFS[out][c] * sample;
+                        }
+                }
+        }
+        return table;
+}
+
+/********** comp_table_free ***********************************************
+ *
+ * This function frees a table made by comp_table_new.
+ *
+ * Parameters:
+ *      comp_table *table       pointer to the table to free
+ *
+ * Return: void
+ *
+ * Expects: table and *table are not NULL
+ *     
+ * Notes: sets *table to NULL
+ *      
+ *************************************************************************/
+void comp_table_free(comp_table *table)
+{
+        assert(table != NULL && *table != NULL);
+        FREE((*table)->shares);
+        FREE(*table);
+}
+
+/********** comp_table_denom **********************************************
+ *
+ * This function returns the denominator a table was built for.
+ *
+ * Parameters:
+ *      comp_table table        the table
+ *
+ * Return: its denominator
+ *
+ * Expects: table is not NULL
+ *     
+ *************************************************************************/
+unsigned comp_table_denom(comp_table table)
+{
+        assert(table != NULL);
+        return table->denom;
+}
+
+/********** shares_to_comp ************************************************
+ *
+ * This function adds up one pixel's shares from the tables.
+ *
+ * Parameters:
+ *      comp_table table        the tables
+ *      unsigned r, g, b        the pixel's samples, each under the limit
+ *
+ * Return: the comp video values of the pixel
+ *
+ * Expects: N/A
+ *     
+ * Notes: the adds are in rgb_to_comp's order, so the results are exactly 
+ *        the same as its. Compression
+ *      
+ *************************************************************************/
+static inline comp_v shares_to_comp(comp_table table, unsigned r, unsigned g,
+                                    unsigned b)
+{
+        const double *red = table->shares + r * 3;
+        const double *green = table->shares + (table->limit + g) * 3;
+        const double *blue = table->shares + (2 * table->limit + b) * 3;
+
+        comp_v comp_vid_elem;
+        comp_vid_elem.y = red[0] + green[0] + blue[0];
+        comp_vid_elem.pB = red[1] + green[1] + blue[1];
+        comp_vid_elem.pR = red[2] + green[2] + blue[2];
+        return comp_vid_elem;
+}
+
+/********** table_to_comp *************************************************
+ *
+ * This function is rgb_to_comp done with lookup tables.
+ *
+ * Parameters:
+ *      comp_table table        tables for the pixel's denominator
+ *      struct Pnm_rgb rgb      the pixel to convert
+ *
+ * Return: the comp video values of the pixel
+ *
+ * Expects: table is not NULL, and no sample of the pixel is over the 
+ *          table's denominator (or 255)
+ *     
+ * Notes: same results as rgb_to_comp. Compression
+ *      
+ *************************************************************************/
+comp_v table_to_comp(comp_table table, struct Pnm_rgb rgb)
+{
+        assert(table != NULL);
+        assert(rgb.red < table->limit && rgb.green < table->limit && 
+               rgb.blue < table->limit);
+        return shares_to_comp(table, rgb.red, rgb.green, rgb.blue);
+}
+
+/********** table_row_to_comp *********************************************
+ *
+ * This function is rgb_row_to_comp done with lookup tables.
+ *
+ * Parameters:
+ *      comp_table table                tables for the image's denominator
+ *      const struct Pnm_rgb *rgb       the row of pixels
+ *      int n                           number of pixels to convert
+ *      comp_row comp                   where to put the comp video values
+ *
+ * Return: void
+ *
+ * Expects: table and rgb are not NULL, comp holds n pixels, no sample is 
+ *          over the table's denominator (or 255)
+ *     
+ * Notes: same results as rgb_to_comp. Compression
+ *      
+ *************************************************************************/
+void table_row_to_comp(comp_table table, const struct Pnm_rgb *rgb, int n, 
+                       comp_row comp)
+{
+        assert(table != NULL && rgb != NULL);
+        for (int i = 0; i < n; i++) {
+                comp_v comp_vid_elem = table_to_comp(table, rgb[i]);
+                comp.y[i] = comp_vid_elem.y;
+                comp.pB[i] = comp_vid_elem.pB;
+                comp.pR[i] = comp_vid_elem.pR;
+        }
+}
+
+/********** table_rgb8_row_to_comp ****************************************
+ *
+ * This function is rgb8_row_to_comp done with lookup tables.
+ *
+ * Parameters:
+ *      comp_table table                tables for the image's denominator
+ *      const unsigned char *rgb        the row of pixels, 3 bytes each
+ *      int n                           number of pixels to convert
+ *      comp_row comp                   where to put the comp video values
+ *
+ * Return: void
+ *
+ * Expects: table and rgb are not NULL, comp holds n pixels
+ *     
+ * Notes: same results as rgb_to_comp, unlike the vector kernels of 
+ *        rgb8_row_to_comp. Compression
+ *      
+ *************************************************************************/
+void table_rgb8_row_to_comp(comp_table table, const unsigned char *rgb, 
+                            int n, comp_row comp)
+{
+        assert(table != NULL && rgb != NULL);
+        for (int i = 0; i < n; i++) {
+                comp_v comp_vid_elem = shares_to_comp(table, rgb[3 * i], 
+                                                      rgb[3 * i + 1], 
+                                                      rgb[3 * i + 2]);
+                comp.y[i] = comp_vid_elem.y;
+                comp.pB[i] = comp_vid_elem.pB;
+                comp.pR[i] = comp_vid_elem.pR;
+        }
+}
+
+/* 
+ * the rgb to comp video coefficients (as in rgb_to_comp) in units of 
+ * 2 ^ -COLOR_BITS, for fixed_color_new; rows are Y, pB, and pR, columns red, 
+ * green, and blue
+ */
+#define COLOR_BITS 20
+static const int32_t COLOR_COEFS[3][3] = {
+        {  313524,  615514,  119538 },
+        { -176933, -347341,  524288 },
+        {  524288, -439026,  -85262 }
+};
+
+/* 
+ * the comp video to rgb coefficients (as in comp_to_rgb) in units of 
+ * 2 ^ -13, for fixed_mulhrs with a value shifted left by 2 
+ */
+const int RGB_PR_RED = 11485;
+const int RGB_PB_GREEN = 2819;
+const int RGB_PR_GREEN = 5850;
+const int RGB_PB_BLUE = 14516;
+
+/********** fixed_color_new ***********************************************
+ *
+ * This function finds the fixed-point rgb to comp video coefficients for 
+ * the given denominator, folding the division by the denominator into them.
+ *
+ * Parameters:
+ *      unsigned denom                  denominator of the image
+ *
+ * Return: the coefficients
+ *
+ * Expects: denom is at least 1 and at most 65535
+ *     
+ * Notes: the shift is the largest (up to 15) that keeps every coefficient 
+ *        in an int16_t, so as many bits as possible are kept; for a 
+ *        denominator of 255 it is 11. Only integer math. Compression
+ *      
+ *************************************************************************/
+fixed_color fixed_color_new(unsigned denom)
+{
+        assert(denom >= 1 && denom <= 65535);
+        fixed_color color;
+        int16_t *rows[3] = { color.y, color.pB, color.pR };
+        int64_t den = (int64_t)denom << COLOR_BITS;
+        for (color.shift = 15; color.shift > 0; color.shift--) {
+                int64_t num = (int64_t)COLOR_COEFS[0][1] << 
+                              (FIXED_BITS + color.shift);
+                if ((num + den / 2) / den <= INT16_MAX) {
+                        break;
+                }
+        }
+        for (int i = 0; i < 3; i++) {
+                for (int j = 0; j < 3; j++) {
+                        /* a multiply, since some coefficients are 
+                           negative and shifting those left is undefined */
+                        int64_t num = (int64_t)COLOR_COEFS[i][j] * 
+                                      ((int64_t)1 << (FIXED_BITS + 
+                                                      color.shift));
+                        /* rounded half away from zero */
+                        num += (num < 0) ? -den / 2 : den / 2;
+                        rows[i][j] = num / den;
+                }
+        }
+        return color;
+}
+
+/********** fixed_row_new *************************************************
+ *
+ * This function allocates a row of n pixels in planar fixed-point comp 
+ * video form.
+ *
+ * Parameters:
+ *      int n                   number of pixels in the row
+ *
+ * Return: the new row
+ *
+ * Expects: n is not negative
+ *     
+ * Notes: the row must be freed with fixed_row_free
+ *      
+ *************************************************************************/
+fixed_row fixed_row_new(int n)
+{
+        assert(n >= 0);
+        fixed_row row;
+        row.y = ALLOC((n + 1) * sizeof(int16_t));
+        row.pB = ALLOC((n + 1) * sizeof(int16_t));
+        row.pR = ALLOC((n + 1) * sizeof(int16_t));
+        return row;
+}
+
+/********** fixed_row_free ************************************************
+ *
+ * This function frees a row made by fixed_row_new.
+ *
+ * Parameters:
+ *      fixed_row *row          the row to free
+ *
+ * Return: void
+ *
+ * Expects: row is not NULL
+ *     
+ *************************************************************************/
+void fixed_row_free(fixed_row *row)
+{
+        assert(row != NULL);
+        FREE(row->y);
+        FREE(row->pB);
+        FREE(row->pR);
+}
+
+/********** clamp *********************************************************
+ *
+ * This function clamps an int to [lo, hi].
+ *
+ * Parameters:
+ *      int64_t x               the value
+ *      int lo, hi              the bounds
+ *
+ * Return: x, or the bound it is past
+ *
+ * Expects: lo <= hi
+ *     
+ *************************************************************************/
+static inline int clamp(int64_t x, int lo, int hi)
+{
+        return x < lo ? lo : (x > hi ? hi : x);
+}
+
+/********** fixed_of_rgb **************************************************
+ *
+ * This function converts one pixel to fixed-point comp video.
+ *
+ * Parameters:
+ *      const fixed_color *color        coefficients for the denominator
+ *      int64_t r, g, b                 the pixel's red, green, and blue
+ *      fixed_row comp                  where to put the values
+ *      int i                           which pixel of comp to put them in
+ *
+ * Return: void
+ *
+ * Expects: color is not NULL
+ *     
+ * Notes: each value is rounded and then clamped, Y to [0, FIXED_ONE] and pB
+ *        and pR to [-FIXED_ONE / 2, FIXED_ONE / 2]; the vector kernel does 
+ *        the same in 32-bit lanes. Compression
+ *      
+ *************************************************************************/
+static inline void fixed_of_rgb(const fixed_color *color, int64_t r, 
+                                int64_t g, int64_t b, fixed_row comp, int i)
+{
+        int shift = color->shift;
+        int64_t round = (shift > 0) ? 1 << (shift - 1) : 0;
+        comp.y[i] = clamp((color->y[0] * r + color->y[1] * g + 
+                           color->y[2] * b + round) >> shift, 0, FIXED_ONE);
+        comp.pB[i] = clamp((color->pB[0] * r + color->pB[1] * g + 
+                            color->pB[2] * b + round) >> shift, 
+                           -FIXED_ONE / 2, FIXED_ONE / 2);
+        comp.pR[i] = clamp((color->pR[0] * r + color->pR[1] * g + 
+                            color->pR[2] * b + round) >> shift, 
+                           -FIXED_ONE / 2, FIXED_ONE / 2);
+}
+
+/********** fixed_rgb_row_to_comp *****************************************
+ *
+ * This function converts a row of Pnm_rgb's into planar fixed-point comp 
+ * video values.
+ *
+ * Parameters:
+ *      const struct Pnm_rgb *rgb       the row of pixels
+ *      int n                           number of pixels to convert
+ *      const fixed_color *color        coefficients for the denominator
+ *      fixed_row comp                  where to put the comp video values
+ *
+ * Return: void
+ *
+ * Expects: rgb and color are not NULL, comp holds n pixels
+ *     
+ * Notes: Compression
+ *      
+ *************************************************************************/
+void fixed_rgb_row_to_comp(const struct Pnm_rgb *rgb, int n, 
+                           const fixed_color *color, fixed_row comp)
+{
+        assert(rgb != NULL && color != NULL);
+        for (int i = 0; i < n; i++) {
+                fixed_of_rgb(color, rgb[i].red, rgb[i].green, rgb[i].blue, 
+                             comp, i);
+        }
+}
+
+/********** fixed_rgb8_row_to_comp_scalar *********************************
+ *
+ * This function converts a row of interleaved 8-bit rgb values into planar
+ * fixed-point comp video values one pixel at a time.
+ *
+ * Parameters: see fixed_rgb8_row_to_comp
+ *
+ * Return: void
+ *
+ * Expects: see fixed_rgb8_row_to_comp
+ *     
+ * Notes: the fallback when the CPU has no AVX2, and used for the pixels 
+ *        left over by the vector loop. Compression
+ *      
+ *************************************************************************/
+static void fixed_rgb8_row_to_comp_scalar(const unsigned char *rgb, int n, 
+                                          const fixed_color *color, 
+                                          fixed_row comp)
+{
+        for (int i = 0; i < n; i++) {
+                fixed_of_rgb(color, rgb[3 * i], rgb[3 * i + 1], 
+                             rgb[3 * i + 2], comp, i);
+        }
+}
+
+/********** rgb_of_fixed **************************************************
+ *
+ * This function converts one fixed-point comp video pixel to 8-bit rgb.
+ *
+ * Parameters:
+ *      fixed_row comp                  the comp video values
+ *      int i                           which pixel of comp to convert
+ *      unsigned char *rgb              where to put the pixel, 3 bytes
+ *
+ * Return: void
+ *
+ * Expects: rgb is not NULL
+ *     
+ * Notes: like comp_to_rgb, each value is clamped to [0, 1] and then scaled 
+ *        to 255 and truncated. Decompression
+ *      
+ *************************************************************************/
+static inline void rgb_of_fixed(fixed_row comp, int i, unsigned char *rgb)
+{
+        int y = comp.y[i];
+        int pB = comp.pB[i] * 4;
+        int pR = comp.pR[i] * 4;
+        int red = y + fixed_mulhrs(pR, RGB_PR_RED);
+        int green = y - fixed_mulhrs(pB, RGB_PB_GREEN) - 
+                    fixed_mulhrs(pR, RGB_PR_GREEN);
+        int blue = y + fixed_mulhrs(pB, RGB_PB_BLUE);
+        /* x * 255 / FIXED_ONE, as (x * 8) * 510 >> 16 */
+        rgb[0] = fixed_mulhi(clamp(red, 0, FIXED_ONE) * 8, 510);
+        rgb[1] = fixed_mulhi(clamp(green, 0, FIXED_ONE) * 8, 510);
+        rgb[2] = fixed_mulhi(clamp(blue, 0, FIXED_ONE) * 8, 510);
+}
+
+/********** fixed_comp_row_to_rgb8_scalar *********************************
+ *
+ * This function converts a row of planar fixed-point comp video values into
+ * interleaved 8-bit rgb values one pixel at a time.
+ *
+ * Parameters: see fixed_comp_row_to_rgb8
+ *
+ * Return: void
+ *
+ * Expects: see fixed_comp_row_to_rgb8
+ *     
+ * Notes: the fallback when the CPU has no AVX2, and used for the pixels 
+ *        left over by the vector loop. Decompression
+ *      
+ *************************************************************************/
+static void fixed_comp_row_to_rgb8_scalar(fixed_row comp, int n, 
+                                          unsigned char *rgb)
+{
+        for (int i = 0; i < n; i++) {
+                rgb_of_fixed(comp, i, rgb + 3 * i);
+        }
+}
+
+#ifdef INT_SIMD
+
+/********** fixed_of_rgb_avx2 *********************************************
+ *
+ * This function finds one of Y, pB, or pR for 16 pixels, as fixed_of_rgb 
+ * does.
+ *
+ * Parameters:
+ *      __m256i rg_lo, rg_hi            the pixels' red and green values, 
+ *                                      paired up by _mm256_unpack*_epi16
+ *      __m256i b_lo, b_hi              the same for blue and 1
+ *      const int16_t coef[3]           the value's coefficients
+ *      int shift                       the coefficients' extra shift
+ *      int lo, hi                      what to clamp the value to
+ *
+ * Return: the 16 values
+ *
+ * Expects: N/A
+ *     
+ * Notes: _mm256_madd_epi16 does the multiplies and the first add in 32-bit
+ *        lanes, and pairing blue with 1 adds the rounding term. Compression
+ *      
+ *************************************************************************/
+__attribute__((target("avx2")))
+static inline __m256i fixed_of_rgb_avx2(__m256i rg_lo, __m256i rg_hi, 
+                                        __m256i b_lo, __m256i b_hi, 
+                                        const int16_t coef[3], int shift, 
+                                        int lo, int hi)
+{
+        uint16_t round = (shift > 0) ? 1 << (shift - 1) : 0;
+        __m256i rg = _mm256_set1_epi32((uint16_t)coef[0] | 
+                                       (uint32_t)(uint16_t)coef[1] << 16);
+        __m256i b = _mm256_set1_epi32((uint16_t)coef[2] | 
+                                      (uint32_t)round << 16);
+        __m128i count = _mm_cvtsi32_si128(shift);
+        __m256i sum_lo = _mm256_sra_epi32(_mm256_add_epi32(
+                                          _mm256_madd_epi16(rg_lo, rg),
+                                          _mm256_madd_epi16(b_lo, b)), count);
+        __m256i sum_hi = _mm256_sra_epi32(_mm256_add_epi32(
+                                          _mm256_madd_epi16(rg_hi, rg),
+                                          _mm256_madd_epi16(b_hi, b)), count);
+        return _mm256_min_epi16(_mm256_max_epi16(
+                                _mm256_packs_epi32(sum_lo, sum_hi),
+                                _mm256_set1_epi16(lo)), 
+                                _mm256_set1_epi16(hi));
+}
+
+/********** fixed_rgb8_row_to_comp_avx2 ***********************************
+ *
+ * AVX2 version of fixed_rgb8_row_to_comp, 16 pixels at a time.
+ *
+ * Parameters: see fixed_rgb8_row_to_comp
+ *
+ * Return: void
+ *
+ * Expects: see fixed_rgb8_row_to_comp
+ *     
+ * Notes: leftover pixels go through fixed_rgb8_row_to_comp_scalar
+ *      
+ *************************************************************************/
+__attribute__((target("avx2")))
+static void fixed_rgb8_row_to_comp_avx2(const unsigned char *rgb, int n, 
+                                        const fixed_color *color, 
+                                        fixed_row comp)
+{
+        __m256i one = _mm256_set1_epi16(1);
+        int i = 0;
+        for (; i + 16 <= n; i += 16) {
+                __m128i r0, g0, b0, r1, g1, b1;
+                load_rgb8(rgb + 3 * i, &r0, &g0, &b0);
+                load_rgb8(rgb + 3 * i + 24, &r1, &g1, &b1);
+                __m256i r = _mm256_cvtepu8_epi16(_mm_unpacklo_epi64(r0, r1));
+                __m256i g = _mm256_cvtepu8_epi16(_mm_unpacklo_epi64(g0, g1));
+                __m256i b = _mm256_cvtepu8_epi16(_mm_unpacklo_epi64(b0, b1));
+                __m256i rg_lo = _mm256_unpacklo_epi16(r, g);
+                __m256i rg_hi = _mm256_unpackhi_epi16(r, g);
+                __m256i b_lo = _mm256_unpacklo_epi16(b, one);
+                __m256i b_hi = _mm256_unpackhi_epi16(b, one);
+                _mm256_storeu_si256((__m256i *)(comp.y + i), 
+                                    fixed_of_rgb_avx2(rg_lo, rg_hi, b_lo, 
+                                                      b_hi, color->y, 
+                                                      color->shift, 0, 
+                                                      FIXED_ONE));
+                _mm256_storeu_si256((__m256i *)(comp.pB + i), 
+                                    fixed_of_rgb_avx2(rg_lo, rg_hi, b_lo, 
+                                                      b_hi, color->pB, 
+                                                      color->shift, 
+                                                      -FIXED_ONE / 2, 
+                                                      FIXED_ONE / 2));
+                _mm256_storeu_si256((__m256i *)(comp.pR + i), 
+                                    fixed_of_rgb_avx2(rg_lo, rg_hi, b_lo, 
+                                                      b_hi, color->pR, 
+                                                      color->shift, 
+                                                      -FIXED_ONE / 2, 
+                                                      FIXED_ONE / 2));
+        }
+        fixed_rgb8_row_to_comp_scalar(rgb + 3 * i, n - i, color, 
+                                      fixed_row_offset(comp, i));
+}
+
+/********** rgb8_of_fixed_avx2 ********************************************
+ *
+ * This function turns 16 red, green, or blue values in units of 
+ * 1 / FIXED_ONE into bytes, as rgb_of_fixed does.
+ *
+ * Parameters:
+ *      __m256i x               the values
+ *
+ * Return: the 16 bytes
+ *
+ * Expects: N/A
+ *     
+ * Notes: Decompression
+ *      
+ *************************************************************************/
+__attribute__((target("avx2")))
+static inline __m128i rgb8_of_fixed_avx2(__m256i x)
+{
+        x = _mm256_min_epi16(_mm256_max_epi16(x, _mm256_setzero_si256()), 
+                             _mm256_set1_epi16(FIXED_ONE));
+        x = _mm256_mulhi_epu16(_mm256_slli_epi16(x, 3), 
+                               _mm256_set1_epi16(510));
+        /* packus works within each 128-bit lane, so gather the two halves */
+        x = _mm256_permute4x64_epi64(_mm256_packus_epi16(x, x), 0x08);
+        return _mm256_castsi256_si128(x);
+}
+
+/********** fixed_comp_row_to_rgb8_avx2 ***********************************
+ *
+ * AVX2 version of fixed_comp_row_to_rgb8, 16 pixels at a time.
+ *
+ * Parameters: see fixed_comp_row_to_rgb8
+ *
+ * Return: void
+ *
+ * Expects: see fixed_comp_row_to_rgb8
+ *     
+ * Notes: leftover pixels go through fixed_comp_row_to_rgb8_scalar
+ *      
+ *************************************************************************/
+__attribute__((target("avx2")))
+static void fixed_comp_row_to_rgb8_avx2(fixed_row comp, int n, 
+                                        unsigned char *rgb)
+{
+        int i = 0;
+        for (; i + 16 <= n; i += 16) {
+                __m256i y = _mm256_loadu_si256((const __m256i *)(comp.y + i));
+                __m256i pB = _mm256_slli_epi16(_mm256_loadu_si256(
+                                               (const __m256i *)(comp.pB + 
+                                                                 i)), 2);
+                __m256i pR = _mm256_slli_epi16(_mm256_loadu_si256(
+                                               (const __m256i *)(comp.pR + 
+                                                                 i)), 2);
+                __m256i red = _mm256_add_epi16(y, _mm256_mulhrs_epi16(pR, 
+                                               _mm256_set1_epi16(RGB_PR_RED)));
+                __m256i green = _mm256_sub_epi16(_mm256_sub_epi16(y, 
+                                        _mm256_mulhrs_epi16(pB, 
+                                        _mm256_set1_epi16(RGB_PB_GREEN))),
+                                        _mm256_mulhrs_epi16(pR, 
+                                        _mm256_set1_epi16(RGB_PR_GREEN)));
+                __m256i blue = _mm256_add_epi16(y, _mm256_mulhrs_epi16(pB, 
+                                                _mm256_set1_epi16(
+                                                RGB_PB_BLUE)));
+                __m128i r8 = rgb8_of_fixed_avx2(red);
+                __m128i g8 = rgb8_of_fixed_avx2(green);
+                __m128i b8 = rgb8_of_fixed_avx2(blue);
+                store_rgb8(rgb + 3 * i, r8, g8, b8);
+                store_rgb8(rgb + 3 * i + 24, _mm_srli_si128(r8, 8), 
+                           _mm_srli_si128(g8, 8), _mm_srli_si128(b8, 8));
+        }
+        fixed_comp_row_to_rgb8_scalar(fixed_row_offset(comp, i), n - i, 
+                                      rgb + 3 * i);
+}
+
+#endif
+
+/********** fixed_rgb8_row_to_comp ****************************************
+ *
+ * This function converts a row of interleaved 8-bit rgb values into planar
+ * fixed-point comp video values. It uses AVX2 when the CPU has it, falling
+ * back to converting one pixel at a time.
+ *
+ * Parameters:
+ *      const unsigned char *rgb        the row of pixels, 3 bytes each
+ *      int n                           number of pixels to convert
+ *      const fixed_color *color        coefficients for the denominator, 
+ *                                      which is at most 255
+ *      fixed_row comp                  where to put the comp video values
+ *
+ * Return: void
+ *
+ * Expects: rgb and color are not NULL, comp holds n pixels
+ *     
+ * Notes: the same results either way. Compression
+ *      
+ *************************************************************************/
+void fixed_rgb8_row_to_comp(const unsigned char *rgb, int n, 
+                            const fixed_color *color, fixed_row comp)
+{
+        assert(rgb != NULL && color != NULL);
+#ifdef INT_SIMD
+        if (__builtin_cpu_supports("avx2")) {
+                fixed_rgb8_row_to_comp_avx2(rgb, n, color, comp);
+                return;
+        }
+#endif
+        fixed_rgb8_row_to_comp_scalar(rgb, n, color, comp);
+}
+
+/********** fixed_comp_row_to_rgb8 ****************************************
+ *
+ * This function converts a row of planar fixed-point comp video values into
+ * interleaved 8-bit rgb values out of 255. It uses AVX2 when the CPU has 
+ * it, falling back to converting one pixel at a time.
+ *
+ * Parameters:
+ *      fixed_row comp                  the comp video values
+ *      int n                           number of pixels to convert
+ *      unsigned char *rgb              where to put the pixels, 3 bytes each
+ *
+ * Return: void
+ *
+ * Expects: rgb is not NULL, comp holds n pixels
+ *     
+ * Notes: the same results either way. Decompression
+ *      
+ *************************************************************************/
+void fixed_comp_row_to_rgb8(fixed_row comp, int n, unsigned char *rgb)
+{
+        assert(rgb != NULL);
+#ifdef INT_SIMD
+        if (__builtin_cpu_supports("avx2")) {
+                fixed_comp_row_to_rgb8_avx2(comp, n, rgb);
+                return;
+        }
+#endif
+        fixed_comp_row_to_rgb8_scalar(comp, n, rgb);
+}
+
 #undef A2
\ No newline at end of file
@@ -9,24 +9,144 @@
  *     Interface of int.h.
  *
  *************************************************************************/
+#ifndef INT_INCLUDED
+#define INT_INCLUDED
 #include "pnm.h"
 #include <stdbool.h>
+#include <stdint.h>
 
-Pnm_ppm int_parent(Pnm_ppm my_ppm, bool compress);
+/* a single pixel in component video form */
+typedef struct comp_v {
+        float y, pB, pR;
+} comp_v;
+
+/* lookup tables for converting pixels to comp video (see comp_table_new) */
+typedef struct comp_table *comp_table;
+
+Pnm_ppm int_parent(Pnm_ppm my_ppm, bool compress, comp_table table);
 
 /* Compress */
 Pnm_ppm trim_ppm(Pnm_ppm my_ppm, A2Methods_T methods);
-void trim_height(int col, int row, A2Methods_UArray2 array, void *elem, 
-                 void *cl);
-void trim_width(int col, int row, A2Methods_UArray2 array, void *elem,
-                void *cl);
-Pnm_ppm to_comp_video(Pnm_ppm my_ppm, A2Methods_T methods);
+Pnm_ppm to_comp_video(Pnm_ppm my_ppm, A2Methods_T methods, 
+                      comp_table table);
+Pnm_ppm to_comp_planes(Pnm_ppm my_ppm, comp_table table);
 void apply_comp_vid(int col, int row, A2Methods_UArray2 array, void *elem, 
                     void *cl);
 
 /* Decompress */
 Pnm_ppm to_rgb(Pnm_ppm my_ppm, A2Methods_T methods);
+Pnm_ppm planes_to_rgb(Pnm_ppm my_ppm);
 void apply_to_rgb(int col, int row, A2Methods_UArray2 array, void *elem, 
                   void *cl);
 float rgb_help(float num, float denom);
-#undef A2
\ No newline at end of file
+
+/* Per-pixel conversions shared with the fused pipeline in compress40.c */
+comp_v rgb_to_comp(struct Pnm_rgb rgb, float denom);
+struct Pnm_rgb comp_to_rgb(comp_v comp_vid, float denom);
+
+/* one row of pixels in planar comp video form */
+typedef struct comp_row {
+        float *y, *pB, *pR;
+} comp_row;
+
+comp_row comp_row_new(int n);
+void comp_row_free(comp_row *row);
+
+/* 
+ * to_comp_planes and inverse_DCT_planes keep comp video images as 
+ * separate planes of floats in one UArray2 (see UArray2_new_planes in 
+ * uarray2rows.h), in this order
+ */
+enum { COMP_Y, COMP_PB, COMP_PR, COMP_PLANES };
+comp_row comp_planes_row(A2Methods_UArray2 planes, int row);
+
+/*
+ * Whole-row conversions used by the fused pipeline. The rgb8 versions work on
+ * interleaved 8-bit rgb (as in a raw ppm with a denominator of at most 255)
+ * and use SSE4.1 or AVX2 when the CPU has them. The vector kernels work in
+ * single precision where the per-pixel conversions go through double, so 
+ * their Y, pB, and pR can differ from rgb_to_comp by up to 1e-6 and their 
+ * rgb values from comp_to_rgb by at most 1.
+ */
+void rgb_row_to_comp(const struct Pnm_rgb *rgb, int n, float denom, 
+                     comp_row comp);
+void rgb8_row_to_comp(const unsigned char *rgb, int n, float denom, 
+                      comp_row comp);
+void comp_row_to_rgb8(comp_row comp, int n, float denom, unsigned char *rgb);
+
+/*
+ * Lookup tables for rgb_to_comp: for one denominator, what each sample of 
+ * each channel adds to Y, pB, and pR, so a pixel takes nine loads and six 
+ * adds instead of three divides and nine multiplies. The entries are the 
+ * doubles rgb_to_comp computes and are added in its order, so the results
+ * are exactly rgb_to_comp's. A table takes 72 * (denominator + 1) bytes 
+ * (at least 256 entries per channel) and can be kept for any number of 
+ * images with its denominator, and is handed to whatever should use it.
+ */
+comp_table comp_table_new(unsigned denom);
+void comp_table_free(comp_table *table);
+unsigned comp_table_denom(comp_table table);
+
+comp_v table_to_comp(comp_table table, struct Pnm_rgb rgb);
+void table_row_to_comp(comp_table table, const struct Pnm_rgb *rgb, int n, 
+                       comp_row comp);
+void table_rgb8_row_to_comp(comp_table table, const unsigned char *rgb, 
+                            int n, comp_row comp);
+
+/*
+ * Fixed-point comp video, for the integer pipeline (see compress40_fixed in
+ * compress40.h): Y, pB, and pR are int16_t's in units of 1 / FIXED_ONE, and
+ * no floating point is used, so the results are the same everywhere. The 
+ * rgb8 versions use AVX2 (16 pixels in 16-bit lanes) when the CPU has it, 
+ * with exactly the same results.
+ */
+#define FIXED_BITS 12
+#define FIXED_ONE (1 << FIXED_BITS)
+
+/* one row of pixels in planar fixed-point comp video form */
+typedef struct fixed_row {
+        int16_t *y, *pB, *pR;
+} fixed_row;
+
+/* the rgb to comp video coefficients for one denominator, each scaled by 
+   2 ^ (FIXED_BITS + shift) / denominator */
+typedef struct fixed_color {
+        int16_t y[3], pB[3], pR[3];
+        int shift;
+} fixed_color;
+
+fixed_color fixed_color_new(unsigned denom);
+fixed_row fixed_row_new(int n);
+void fixed_row_free(fixed_row *row);
+
+void fixed_rgb_row_to_comp(const struct Pnm_rgb *rgb, int n, 
+                           const fixed_color *color, fixed_row comp);
+void fixed_rgb8_row_to_comp(const unsigned char *rgb, int n, 
+                            const fixed_color *color, fixed_row comp);
+/* always makes rgb values out of 255 */
+void fixed_comp_row_to_rgb8(fixed_row comp, int n, unsigned char *rgb);
+
+/* the part of a row that starts at pixel i, for handing the leftover 
+   pixels of a vector loop to a scalar one */
+static inline fixed_row fixed_row_offset(fixed_row row, int i)
+{
+        row.y += i;
+        row.pB += i;
+        row.pR += i;
+        return row;
+}
+
+/* the 16-bit multiplies the fixed-point kernels are built from, the same 
+   as _mm256_mulhrs_epi16 and _mm256_mulhi_epu16 lane by lane (>> on a 
+   negative int is an arithmetic shift with gcc) */
+static inline int fixed_mulhrs(int x, int y)
+{
+        return (x * y + (1 << 14)) >> 15;
+}
+
+static inline unsigned fixed_mulhi(unsigned x, unsigned y)
+{
+        return (x * y) >> 16;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,264 @@
+/*************************************************************************
+ *
+ *                     jobarena.c
+ *
+ *     Assignment: arith
+ *     Author:   Eva Caro
+ *     Date:     3/6/24
+ *
+ *     Implementation of job_arena. An arena is a list of chunks, each one
+ *     ALLOC'd, that it allocates from in order. When a request doesn't fit
+ *     in the rest of the current chunk, the arena moves on to the next 
+ *     chunk that it does fit in, making a new one at the end if there is 
+ *     none. Resetting goes back to the first chunk and keeps them all, so 
+ *     a job that allocates what the one before it did never calls ALLOC.
+ *
+ *************************************************************************/
+
+#include <stdint.h>
+#include "jobarena.h"
+#include "assert.h"
+#include "mem.h"
+
+/* every allocation starts on a boundary of this many bytes (a cache line) */
+#define ARENA_ALIGN 64
+/* the smallest chunk made, so that small allocations share one */
+#define CHUNK_MIN (1024 * 1024)
+
+struct chunk {
+        struct chunk *next;
+        /* the usable part of the chunk, from an aligned start */
+        char *start, *limit;
+};
+
+struct job_arena {
+        /* the chunks, oldest first, and the one being allocated from */
+        struct chunk *first, *last, *current;
+        /* the free part of the current chunk */
+        char *avail;
+        /* bytes in all of the chunks */
+        size_t capacity;
+};
+
+/* the arena each thread's arrays are made in, if any */
+static __thread job_arena in_use = NULL;
+
+static struct chunk *chunk_new(size_t bytes);
+static size_t align_up(size_t size);
+
+/********** job_arena_new ***************************************************
+ *
+ * This function makes an empty arena.
+ *
+ * Parameters: none
+ *
+ * Return: the new arena
+ *
+ * Expects: N/A
+ *     
+ * Notes: no chunk is made until the first allocation. The arena must be 
+ *        freed with job_arena_free.
+ *      
+ ***********************************************************************/
+job_arena job_arena_new(void)
+{
+        job_arena arena;
+        NEW(arena);
+        arena->first = arena->last = arena->current = NULL;
+        arena->avail = NULL;
+        arena->capacity = 0;
+        return arena;
+}
+
+/********** job_arena_free **************************************************
+ *
+ * This function frees an arena and all of its chunks, and sets *arena to 
+ * NULL.
+ *
+ * Parameters:
+ *      job_arena *arena        the arena to free
+ *
+ * Return: N/A
+ *
+ * Expects: arena and *arena are not NULL
+ *     
+ * Notes: everything allocated from the arena is gone. If it is the calling
+ *        thread's arena in use, the thread is left with none.
+ *      
+ ***********************************************************************/
+void job_arena_free(job_arena *arena)
+{
+        assert(arena != NULL && *arena != NULL);
+        struct chunk *chunk = (*arena)->first;
+        while (chunk != NULL) {
+                struct chunk *next = chunk->next;
+                FREE(chunk);
+                chunk = next;
+        }
+        if (in_use == *arena) {
+                in_use = NULL;
+        }
+        FREE(*arena);
+}
+
+/********** job_arena_alloc *************************************************
+ *
+ * This function allocates size bytes from an arena.
+ *
+ * Parameters:
+ *      job_arena arena         the arena to allocate from
+ *      size_t size             number of bytes wanted
+ *
+ * Return: a pointer to the bytes, aligned to ARENA_ALIGN
+ *
+ * Expects: arena is not NULL
+ *     
+ * Notes: the bytes are not zeroed, and last until the arena is reset or 
+ *        freed. Raises Mem_Failed (through ALLOC) if a new chunk is needed
+ *        and can't be had. A chunk skipped because the request didn't fit 
+ *        goes unused until the next reset.
+ *      
+ ***********************************************************************/
+void *job_arena_alloc(job_arena arena, size_t size)
+{
+        assert(arena != NULL);
+        size = align_up(size == 0 ? 1 : size);
+        struct chunk *chunk = arena->current;
+        if (chunk != NULL && (size_t)(chunk->limit - arena->avail) >= size) {
+                void *p = arena->avail;
+                arena->avail += size;
+                return p;
+        }
+
+        /* the first chunk after this one that fits the request */
+        chunk = (chunk == NULL) ? arena->first : chunk->next;
+        while (chunk != NULL && (size_t)(chunk->limit - chunk->start) < size) {
+                chunk = chunk->next;
+        }
+        if (chunk == NULL) {
+                /* grow geometrically, so a big job makes few chunks */
+                size_t bytes = size;
+                if (bytes < CHUNK_MIN) {
+                        bytes = CHUNK_MIN;
+                }
+                if (bytes < arena->capacity) {
+                        bytes = arena->capacity;
+                }
+                chunk = chunk_new(bytes);
+                if (arena->last == NULL) {
+                        arena->first = chunk;
+                } else {
+                        arena->last->next = chunk;
+                }
+                arena->last = chunk;
+                arena->capacity += bytes;
+        }
+        arena->current = chunk;
+        arena->avail = chunk->start + size;
+        return chunk->start;
+}
+
+/********** job_arena_reset *************************************************
+ *
+ * This function frees everything allocated from an arena at once, keeping
+ * its chunks for the allocations that come after.
+ *
+ * Parameters:
+ *      job_arena arena         the arena to reset
+ *
+ * Return: N/A
+ *
+ * Expects: arena is not NULL
+ *     
+ * Notes: pointers from before the reset must not be used after it
+ *      
+ ***********************************************************************/
+void job_arena_reset(job_arena arena)
+{
+        assert(arena != NULL);
+        arena->current = arena->first;
+        arena->avail = (arena->first == NULL) ? NULL : arena->first->start;
+}
+
+/********** job_arena_use ***************************************************
+ *
+ * This function sets the arena that the calling thread's UArray2s and 
+ * UArray2bs are made in.
+ *
+ * Parameters:
+ *      job_arena arena         the arena to use, or NULL for none
+ *
+ * Return: N/A
+ *
+ * Expects: N/A
+ *     
+ * Notes: each thread has its own; other threads are not affected
+ *      
+ ***********************************************************************/
+void job_arena_use(job_arena arena)
+{
+        in_use = arena;
+}
+
+/********** job_arena_current ***********************************************
+ *
+ * This function returns the calling thread's arena in use.
+ *
+ * Parameters: none
+ *
+ * Return: the arena, or NULL if there is none
+ *
+ * Expects: N/A
+ *     
+ * Notes: see job_arena_use
+ *      
+ ***********************************************************************/
+job_arena job_arena_current(void)
+{
+        return in_use;
+}
+
+/********** chunk_new *******************************************************
+ *
+ * This function makes a chunk with at least bytes usable bytes, starting on
+ * an ARENA_ALIGN boundary.
+ *
+ * Parameters:
+ *      size_t bytes            usable bytes wanted
+ *
+ * Return: the new chunk, with the chunk header at the start of the ALLOC
+ *
+ * Expects: bytes is a multiple of ARENA_ALIGN
+ *     
+ * Notes: freed with a single FREE
+ *      
+ ***********************************************************************/
+static struct chunk *chunk_new(size_t bytes)
+{
+        struct chunk *chunk = ALLOC(sizeof(struct chunk) + ARENA_ALIGN + 
+                                    bytes);
+        uintptr_t start = (uintptr_t)(chunk + 1);
+        start = (start + ARENA_ALIGN - 1) & ~(uintptr_t)(ARENA_ALIGN - 1);
+        chunk->next = NULL;
+        chunk->start = (char *)start;
+        chunk->limit = chunk->start + bytes;
+        return chunk;
+}
+
+/********** align_up ********************************************************
+ *
+ * This function rounds a size up to a multiple of ARENA_ALIGN, so that the
+ * allocation after it is aligned too.
+ *
+ * Parameters:
+ *      size_t size             the size to round
+ *
+ * Return: the rounded size
+ *
+ * Expects: size is not within ARENA_ALIGN of SIZE_MAX
+ *     
+ ***********************************************************************/
+static size_t align_up(size_t size)
+{
+        return (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
@@ -0,0 +1,40 @@
+/*************************************************************************
+ *
+ *                     jobarena.h
+ *
+ *     Assignment: arith
+ *     Author:   Eva Caro
+ *     Date:     3/6/24
+ *
+ *     Interface of job_arena, the memory one image's arrays are made from.
+ *     Allocating from an arena is a pointer bump; nothing in it is freed 
+ *     on its own. job_arena_reset gives all of it back at once but keeps 
+ *     the memory, so the next image reuses pages that are already mapped.
+ *
+ *     While a thread has an arena in use (job_arena_use), UArray2_new, 
+ *     UArray2_new_row_major, and UArray2b_new make their arrays in it and
+ *     freeing those arrays does nothing; the memory comes back when the 
+ *     arena is reset.
+ *
+ *************************************************************************/
+
+#ifndef JOBARENA_INCLUDED
+#define JOBARENA_INCLUDED
+#include <stddef.h>
+
+typedef struct job_arena *job_arena;
+
+job_arena job_arena_new(void);
+void job_arena_free(job_arena *arena);
+
+/* size bytes, aligned to a cache line, not zeroed; never returns NULL */
+void *job_arena_alloc(job_arena arena, size_t size);
+
+/* frees everything allocated from arena, keeping the memory */
+void job_arena_reset(job_arena arena);
+
+/* sets (or, with NULL, clears) the calling thread's arena in use */
+void job_arena_use(job_arena arena);
+job_arena job_arena_current(void);
+
+#endif
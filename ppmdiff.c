@@ -8,7 +8,9 @@
  *
  *     Implementation of ppmdiff.c, which quantizes the difference between
  *     two files (one must be the compressed and decompressed version of the
- *     other).
+ *     other). Given a third file, it compares the second and third files' 
+ *     differences from the first, e.g. the same image decompressed after 
+ *     floating-point and fixed-point compression (40image --fixed).
  *
  *************************************************************************/
 
@@ -23,61 +25,111 @@
 #include "uarray2b.h"
 
 /* Function Declarations */
-void ppmdiff(FILE *file1, FILE *file2);
+FILE *open_file(const char *name, int *stdin_count);
+Pnm_ppm read_file(const char *name, int *stdin_count);
+double ppmdiff(Pnm_ppm ppm_1, Pnm_ppm ppm_2);
 
 
 int main(int argc, char *argv[]) 
 {
-        FILE *file1, *file2;
-        (void) argc;
         int count = 0;
 
-        if (argc != 3) {
-                fprintf(stderr, "Must provide 2 arguments\n");
+        if (argc != 3 && argc != 4) {
+                fprintf(stderr, "Must provide 2 or 3 arguments\n");
                 exit(EXIT_FAILURE);
+        }
+        Pnm_ppm original = read_file(argv[1], &count);
+        Pnm_ppm first = read_file(argv[2], &count);
+        double e1 = ppmdiff(original, first);
+        Pnm_ppmfree(&first);
+        if (argc == 3) {
+                printf("E: %.4f\n", e1);
         } else {
-                for (int i = 1; i < argc; i++) {
-                        if (strcmp(argv[i], "-") == 0) {
-                                count++;
-                                if (count > 1) {
-                                        fprintf(stderr, "both files are -\n");
-                                        exit(EXIT_FAILURE);
-                                }
-                                if (i == 1) {
-                                        file1 = stdin;
-                                } else {
-                                        file2 = stdin;
-                                }
-                        } else {
-                                if (i == 1) {
-                                        file1 = fopen(argv[i], "r");
-                                } else {
-                                        file2 = fopen(argv[i], "r");
-                                }     
-                        }
-                }
-                assert(file1 != NULL);
-                assert(file2 != NULL); 
+                Pnm_ppm second = read_file(argv[3], &count);
+                double e2 = ppmdiff(original, second);
+                Pnm_ppmfree(&second);
+                printf("E(%s): %.6f\n", argv[2], e1);
+                printf("E(%s): %.6f\n", argv[3], e2);
+                printf("difference: %+.6f (%+.2f%%)\n", e2 - e1, 
+                       e1 == 0 ? 0.0 : 100 * (e2 - e1) / e1);
+        }
+        Pnm_ppmfree(&original);
+        return 0;
+}
 
-                ppmdiff(file1, file2);  
-                if (file1 == stdin) {
-                        fclose(file2);
-                } else if (file2 == stdin) {
-                        fclose(file1);
-                } else {
-                        fclose(file1);
-                        fclose(file2);
+/********** open_file *****************************************************
+ *
+ * This function opens a file named on the command line, where - is stdin.
+ *
+ * Parameters:
+ *      const char *name        the name
+ *      int *stdin_count        how many times stdin has been used so far
+ *
+ * Return: the open file
+ *
+ * Expects: the file can be opened (CRE if not)
+ *     
+ * Notes: exits if stdin is named more than once
+ *      
+ ***********************************************************************/
+FILE *open_file(const char *name, int *stdin_count)
+{
+        if (strcmp(name, "-") == 0) {
+                (*stdin_count)++;
+                if (*stdin_count > 1) {
+                        fprintf(stderr, "more than one file is -\n");
+                        exit(EXIT_FAILURE);
                 }
+                return stdin;
         }
-        return 0;
+        FILE *file = fopen(name, "r");
+        assert(file != NULL);
+        return file;
 }
 
+/********** read_file *****************************************************
+ *
+ * This function reads the ppm in a file named on the command line.
+ *
+ * Parameters:
+ *      const char *name        the name, or - for stdin
+ *      int *stdin_count        how many times stdin has been used so far
+ *
+ * Return: the ppm, which must be freed with Pnm_ppmfree
+ *
+ * Expects: see open_file
+ *     
+ ***********************************************************************/
+Pnm_ppm read_file(const char *name, int *stdin_count)
+{
+        FILE *file = open_file(name, stdin_count);
+        Pnm_ppm ppm = Pnm_ppmread(file, uarray2_methods_blocked);
+        if (file != stdin) {
+                fclose(file);
+        }
+        return ppm;
+}
 
-void ppmdiff(FILE *file1, FILE *file2)
+/********** ppmdiff *******************************************************
+ *
+ * This function finds the root mean square difference between two ppms,
+ * over every sample, each as a fraction of its ppm's denominator.
+ *
+ * Parameters:
+ *      Pnm_ppm ppm_1, ppm_2    the ppms
+ *
+ * Return: E, the difference
+ *
+ * Expects: the ppms were read with uarray2_methods_blocked and their 
+ *          widths and heights differ by at most 1
+ *     
+ * Notes: exits, printing 1.0, if the sizes differ by more than that. Only
+ *        the pixels both ppms have are compared.
+ *      
+ ***********************************************************************/
+double ppmdiff(Pnm_ppm ppm_1, Pnm_ppm ppm_2)
 {
         A2Methods_T methods = uarray2_methods_blocked;
-        Pnm_ppm ppm_1 = Pnm_ppmread(file1, methods);
-        Pnm_ppm ppm_2 = Pnm_ppmread(file2, methods);
         A2Methods_UArray2 pixels1 = ppm_1->pixels;
         A2Methods_UArray2 pixels2 = ppm_2->pixels;
         double finalSum = 0;
@@ -129,7 +181,5 @@ void ppmdiff(FILE *file1, FILE *file2)
                 
         }
 
-        printf("E: %.4f\n", finalSum);
-        Pnm_ppmfree(&ppm_1);
-        Pnm_ppmfree(&ppm_2);
+        return finalSum;
 }
@@ -0,0 +1,588 @@
+/*************************************************************************
+ *
+ *                     ppmio.c
+ *
+ *     Assignment: arith
+ *     Author:   Eva Caro
+ *     Date:     3/6/24
+ *
+ *     Implementation of ppmio. Parses the header of a plain (P3) or raw (P6)
+ *     ppm itself and then hands the pixels out one row at a time, so only a
+ *     single row of the image is ever held in memory. ppm_read and 
+ *     ppm_write move a whole image a row at a time, straight between the 
+ *     file and a row-major array when they can.
+ *
+ *************************************************************************/
+
+#include <ctype.h>
+#include <string.h>
+#include "ppmio.h"
+#include "uarray2rows.h"
+#include "assert.h"
+#include "mem.h"
+#include "except.h"
+
+const unsigned MAXDENOM = 65535;
+const unsigned BYTEDENOM = 255;
+
+static unsigned read_header_num(source input);
+static unsigned read_sample(ppm_stream stream);
+static void skip_space(source input);
+static void check_bytes(const unsigned char *raw, size_t n, 
+                        unsigned denominator);
+static void check_row(const struct Pnm_rgb *row, unsigned width, 
+                      unsigned denominator);
+static void read_rgb8_rows(ppm_stream stream, A2Methods_UArray2 pixels, 
+                           A2Methods_T methods);
+static void read_rgb_rows(ppm_stream stream, A2Methods_UArray2 pixels, 
+                          A2Methods_T methods);
+static void pack_row(Pnm_ppm ppm, unsigned row, unsigned char *bytes);
+
+/********** ppm_read ******************************************************
+ *
+ * This function reads a whole ppm into a Pnm_ppm, like Pnm_ppmread, but 
+ * with 3-byte ppm_rgb8 pixels when the denominator is at most 255.
+ *
+ * Parameters:
+ *      FILE *input             where to read the ppm from
+ *      A2Methods_T methods     methods used to make the pixels array
+ *
+ * Return: the new Pnm_ppm
+ *
+ * Expects: input and methods are not NULL
+ *     
+ * Notes: raises Pnm_Badformat as ppm_stream_open and ppm_stream_read_row 
+ *        do. A raw ppm with one byte per sample is read a row at a time 
+ *        with a single fread, and straight into the array when it is a 
+ *        row-major UArray2 (as uarray2_methods_plain_rows makes); plain and
+ *        two-byte ppms fall back to ppm_stream_read_row. Freed with 
+ *        Pnm_ppmfree.
+ *      
+ ***********************************************************************/
+Pnm_ppm ppm_read(FILE *input, A2Methods_T methods)
+{
+        assert(input != NULL && methods != NULL);
+        source src = source_new(input);
+        ppm_stream stream = ppm_stream_open(src);
+        bool bytes = stream->denominator <= BYTEDENOM;
+
+        Pnm_ppm ppm;
+        NEW(ppm);
+        ppm->width = stream->width;
+        ppm->height = stream->height;
+        ppm->denominator = stream->denominator;
+        ppm->methods = methods;
+        ppm->pixels = methods->new(stream->width, stream->height, 
+                                   bytes ? sizeof(ppm_rgb8) 
+                                         : sizeof(struct Pnm_rgb));
+        if (bytes && !stream->plain) {
+                read_rgb8_rows(stream, ppm->pixels, methods);
+        } else {
+                read_rgb_rows(stream, ppm->pixels, methods);
+        }
+
+        ppm_stream_close(&stream);
+        source_free(&src);
+        return ppm;
+}
+
+/********** ppm_write *****************************************************
+ *
+ * This function writes a Pnm_ppm out as a raw (P6) ppm, like Pnm_ppmwrite.
+ *
+ * Parameters:
+ *      FILE *output            where to write the ppm
+ *      Pnm_ppm ppm             the ppm, with ppm_rgb8 or struct Pnm_rgb 
+ *                              pixels (see ppm_read)
+ *
+ * Return: N/A
+ *
+ * Expects: output and ppm are not NULL, ppm_rgb8 pixels only with a 
+ *          denominator of at most 255
+ *     
+ * Notes: each row is written with a single fwrite, straight from the array
+ *        when it holds ppm_rgb8's in row-major order and otherwise from a 
+ *        row buffer. Samples take two bytes if the denominator is over 255.
+ *      
+ ***********************************************************************/
+void ppm_write(FILE *output, Pnm_ppm ppm)
+{
+        assert(output != NULL && ppm != NULL);
+        A2Methods_T methods = ppm->methods;
+        unsigned width = ppm->width, height = ppm->height;
+        bool bytes = methods->size(ppm->pixels) == sizeof(ppm_rgb8);
+        assert(!bytes || ppm->denominator <= BYTEDENOM);
+        size_t row_bytes = (size_t)width * 3 * 
+                           (ppm->denominator > BYTEDENOM ? 2 : 1);
+
+        fprintf(output, "P6\n%u %u\n%u\n", width, height, ppm->denominator);
+        if (width == 0 || height == 0) {
+                return;
+        }
+        if (bytes && uarray2_methods_is_plain(methods) && 
+            UArray2_row_major(ppm->pixels)) {
+                for (unsigned row = 0; row < height; row++) {
+                        fwrite(methods->at(ppm->pixels, 0, row), 1, 
+                               row_bytes, output);
+                }
+                return;
+        }
+        unsigned char *buffer = ALLOC(row_bytes);
+        for (unsigned row = 0; row < height; row++) {
+                pack_row(ppm, row, buffer);
+                fwrite(buffer, 1, row_bytes, output);
+        }
+        FREE(buffer);
+}
+
+/********** ppm_stream_open ***********************************************
+ *
+ * This function reads the header of a ppm from the given input and returns
+ * a ppm_stream that is ready to hand out the rows of the image.
+ *
+ * Parameters:
+ *      source input            where to read the ppm from
+ *
+ * Return: a new ppm_stream positioned at the first row of pixels
+ *
+ * Expects: input is not NULL
+ *     
+ * Notes: raises Pnm_Badformat if the input is not a P3 or P6 ppm or the 
+ *        header is malformed. Allocates memory that is freed by 
+ *        ppm_stream_close, which does not free input.
+ *      
+ ***********************************************************************/
+ppm_stream ppm_stream_open(source input)
+{
+        assert(input != NULL);
+        int p = source_getc(input);
+        int kind = source_getc(input);
+        if (p != 'P' || (kind != '3' && kind != '6')) {
+                RAISE(Pnm_Badformat);
+        }
+
+        ppm_stream stream;
+        NEW(stream);
+        stream->input = input;
+        stream->plain = (kind == '3');
+        stream->width = read_header_num(input);
+        stream->height = read_header_num(input);
+        stream->denominator = read_header_num(input);
+        if (stream->denominator == 0 || stream->denominator > MAXDENOM) {
+                RAISE(Pnm_Badformat);
+        }
+        /* exactly one whitespace character separates header from pixels */
+        if (!isspace(source_getc(input))) {
+                RAISE(Pnm_Badformat);
+        }
+
+        unsigned sample_bytes = (stream->denominator > BYTEDENOM) ? 2 : 1;
+        stream->row_bytes = (size_t)stream->width * 3 * sample_bytes;
+        stream->raw = stream->plain ? NULL : ALLOC(stream->row_bytes + 1);
+        stream->rows_read = 0;
+        return stream;
+}
+
+/********** ppm_stream_read_row *******************************************
+ *
+ * This function reads the next row of the ppm into the given array of 
+ * Pnm_rgb's.
+ *
+ * Parameters:
+ *      ppm_stream stream       the ppm being read
+ *      struct Pnm_rgb *row     where to put the row, must hold width pixels
+ *
+ * Return: N/A
+ *
+ * Expects: stream and row are not NULL, there is a row left to read
+ *     
+ * Notes: raises Pnm_Badformat if the input ends before the row does or a
+ *        sample is over the denominator. Raw rows are read with a single
+ *        source_read, which doesn't copy at all if the input is mapped.
+ *      
+ ***********************************************************************/
+void ppm_stream_read_row(ppm_stream stream, struct Pnm_rgb *row)
+{
+        assert(stream != NULL);
+        assert(row != NULL);
+        assert(stream->rows_read < stream->height);
+        unsigned width = stream->width;
+
+        if (stream->plain) {
+                for (unsigned col = 0; col < width; col++) {
+                        row[col].red = read_sample(stream);
+                        row[col].green = read_sample(stream);
+                        row[col].blue = read_sample(stream);
+                }
+        } else {
+                const unsigned char *raw = source_read(stream->input, 
+                                                       stream->row_bytes,
+                                                       stream->raw);
+                if (raw == NULL) {
+                        RAISE(Pnm_Badformat);
+                }
+                if (stream->denominator <= BYTEDENOM) {
+                        check_bytes(raw, stream->row_bytes, 
+                                    stream->denominator);
+                        for (unsigned col = 0; col < width; col++) {
+                                row[col].red = raw[3 * col];
+                                row[col].green = raw[3 * col + 1];
+                                row[col].blue = raw[3 * col + 2];
+                        }
+                } else {
+                        /* two bytes per sample, most significant first */
+                        for (unsigned col = 0; col < width; col++) {
+                                const unsigned char *s = raw + 6 * col;
+                                row[col].red = (s[0] << 8) | s[1];
+                                row[col].green = (s[2] << 8) | s[3];
+                                row[col].blue = (s[4] << 8) | s[5];
+                        }
+                        check_row(row, width, stream->denominator);
+                }
+        }
+        stream->rows_read++;
+}
+
+/********** ppm_stream_read_bytes *****************************************
+ *
+ * This function reads the next row of a raw ppm with one byte per sample and
+ * returns it as is, 3 bytes (red, green, blue) per pixel.
+ *
+ * Parameters:
+ *      ppm_stream stream       the ppm being read
+ *
+ * Return: the bytes of the row, good until the next row is read
+ *
+ * Expects: stream is not NULL, the ppm is raw with a denominator of at most
+ *          255, there is a row left to read
+ *     
+ * Notes: raises Pnm_Badformat if the input ends before the row does or a
+ *        sample is over the denominator. Points straight into the mapping
+ *        when the input is mapped, so nothing is copied or unpacked.
+ *      
+ ***********************************************************************/
+const unsigned char *ppm_stream_read_bytes(ppm_stream stream)
+{
+        assert(stream != NULL);
+        assert(!stream->plain && stream->denominator <= BYTEDENOM);
+        assert(stream->rows_read < stream->height);
+
+        const unsigned char *raw = source_read(stream->input, 
+                                               stream->row_bytes, 
+                                               stream->raw);
+        if (raw == NULL) {
+                RAISE(Pnm_Badformat);
+        }
+        check_bytes(raw, stream->row_bytes, stream->denominator);
+        stream->rows_read++;
+        return raw;
+}
+
+/********** ppm_stream_close **********************************************
+ *
+ * This function frees the memory used by a ppm_stream. It does not close 
+ * the input.
+ *
+ * Parameters:
+ *      ppm_stream *stream      pointer to the stream to free
+ *
+ * Return: N/A
+ *
+ * Expects: stream and *stream are not NULL
+ *     
+ * Notes: sets *stream to NULL
+ *      
+ ***********************************************************************/
+void ppm_stream_close(ppm_stream *stream)
+{
+        assert(stream != NULL && *stream != NULL);
+        if ((*stream)->raw != NULL) {
+                FREE((*stream)->raw);
+        }
+        FREE(*stream);
+}
+
+/********** read_header_num ***********************************************
+ *
+ * This function skips whitespace and comments and reads an unsigned decimal
+ * number from the input. It is used for the header and for plain pixels.
+ *
+ * Parameters:
+ *      source input            where to read the number from
+ *
+ * Return: the number read
+ *
+ * Expects: input is not NULL
+ *     
+ * Notes: raises Pnm_Badformat if there is no number to read
+ *      
+ ***********************************************************************/
+static unsigned read_header_num(source input)
+{
+        skip_space(input);
+        bool ok;
+        unsigned n = source_read_unsigned(input, &ok);
+        if (!ok) {
+                RAISE(Pnm_Badformat);
+        }
+        return n;
+}
+
+/********** skip_space ****************************************************
+ *
+ * This function skips over whitespace and '#' comments in a ppm header.
+ *
+ * Parameters:
+ *      source input            where to skip from
+ *
+ * Return: N/A
+ *
+ * Expects: input is not NULL
+ *     
+ * Notes: leaves the next non-space character unread
+ *      
+ ***********************************************************************/
+static void skip_space(source input)
+{
+        int c = source_getc(input);
+        while (isspace(c) || c == '#') {
+                if (c == '#') {
+                        while (c != '\n' && c != EOF) {
+                                c = source_getc(input);
+                        }
+                }
+                c = source_getc(input);
+        }
+        source_ungetc(input, c);
+}
+
+/********** read_sample ***************************************************
+ *
+ * This function reads one sample of a plain ppm.
+ *
+ * Parameters:
+ *      ppm_stream stream       the plain ppm being read
+ *
+ * Return: the sample
+ *
+ * Expects: stream is not NULL
+ *     
+ * Notes: raises Pnm_Badformat if there is no number to read or it is over
+ *        the denominator
+ *      
+ ***********************************************************************/
+static unsigned read_sample(ppm_stream stream)
+{
+        unsigned n = read_header_num(stream->input);
+        if (n > stream->denominator) {
+                RAISE(Pnm_Badformat);
+        }
+        return n;
+}
+
+/********** check_bytes ***************************************************
+ *
+ * This function checks that no sample of a raw row with one byte per sample
+ * is over the denominator.
+ *
+ * Parameters:
+ *      const unsigned char *raw        the row
+ *      size_t n                        how many samples it has
+ *      unsigned denominator            the ppm's denominator
+ *
+ * Return: N/A
+ *
+ * Expects: raw is not NULL
+ *     
+ * Notes: raises Pnm_Badformat if a sample is over the denominator. Does 
+ *        nothing for a denominator of 255, which no byte can be over, and
+ *        otherwise takes the maximum of the row without branching so it
+ *        vectorizes.
+ *      
+ ***********************************************************************/
+static void check_bytes(const unsigned char *raw, size_t n, 
+                        unsigned denominator)
+{
+        if (denominator >= BYTEDENOM) {
+                return;
+        }
+        unsigned char most = 0;
+        for (size_t i = 0; i < n; i++) {
+                most = raw[i] > most ? raw[i] : most;
+        }
+        if (most > denominator) {
+                RAISE(Pnm_Badformat);
+        }
+}
+
+/********** check_row *****************************************************
+ *
+ * This function checks that no sample of a row of Pnm_rgb's is over the 
+ * denominator.
+ *
+ * Parameters:
+ *      const struct Pnm_rgb *row       the row
+ *      unsigned width                  how many pixels it has
+ *      unsigned denominator            the ppm's denominator
+ *
+ * Return: N/A
+ *
+ * Expects: row is not NULL
+ *     
+ * Notes: raises Pnm_Badformat if a sample is over the denominator
+ *      
+ ***********************************************************************/
+static void check_row(const struct Pnm_rgb *row, unsigned width, 
+                      unsigned denominator)
+{
+        for (unsigned col = 0; col < width; col++) {
+                if (row[col].red > denominator || 
+                    row[col].green > denominator ||
+                    row[col].blue > denominator) {
+                        RAISE(Pnm_Badformat);
+                }
+        }
+}
+
+/********** read_rgb8_rows ************************************************
+ *
+ * This function reads the rest of a raw ppm with one byte per sample into 
+ * an array of ppm_rgb8's.
+ *
+ * Parameters:
+ *      ppm_stream stream               the ppm, with no rows read yet
+ *      A2Methods_UArray2 pixels        the array, as big as the ppm
+ *      A2Methods_T methods             the array's methods
+ *
+ * Return: N/A
+ *
+ * Expects: stream, pixels, and methods are not NULL
+ *     
+ * Notes: raises Pnm_Badformat if the input ends early or a sample is over
+ *        the denominator. With 
+ *        a row-major UArray2 each row is freaded right into place.
+ *      
+ ***********************************************************************/
+static void read_rgb8_rows(ppm_stream stream, A2Methods_UArray2 pixels, 
+                           A2Methods_T methods)
+{
+        unsigned width = stream->width;
+        if (width == 0) {
+                return;
+        }
+        bool in_place = uarray2_methods_is_plain(methods) && 
+                        UArray2_row_major(pixels);
+        for (unsigned row = 0; row < stream->height; row++) {
+                if (in_place) {
+                        unsigned char *dest = methods->at(pixels, 0, row);
+                        const unsigned char *raw = 
+                                source_read(stream->input, stream->row_bytes,
+                                            dest);
+                        if (raw == NULL) {
+                                RAISE(Pnm_Badformat);
+                        }
+                        if (raw != dest) {
+                                memcpy(dest, raw, stream->row_bytes);
+                        }
+                        check_bytes(dest, stream->row_bytes, 
+                                    stream->denominator);
+                        stream->rows_read++;
+                        continue;
+                }
+                const unsigned char *raw = ppm_stream_read_bytes(stream);
+                for (unsigned col = 0; col < width; col++) {
+                        ppm_rgb8 *pixel = methods->at(pixels, col, row);
+                        pixel->red = raw[3 * col];
+                        pixel->green = raw[3 * col + 1];
+                        pixel->blue = raw[3 * col + 2];
+                }
+        }
+}
+
+/********** read_rgb_rows *************************************************
+ *
+ * This function reads the rest of a ppm one row at a time with 
+ * ppm_stream_read_row, and puts the pixels in the array as ppm_rgb8's or
+ * struct Pnm_rgb's (whichever the array's elements are).
+ *
+ * Parameters:
+ *      ppm_stream stream               the ppm, with no rows read yet
+ *      A2Methods_UArray2 pixels        the array, as big as the ppm
+ *      A2Methods_T methods             the array's methods
+ *
+ * Return: N/A
+ *
+ * Expects: stream, pixels, and methods are not NULL, ppm_rgb8 elements 
+ *          only if the denominator is at most 255
+ *     
+ * Notes: raises Pnm_Badformat if the input is malformed or ends early
+ *      
+ ***********************************************************************/
+static void read_rgb_rows(ppm_stream stream, A2Methods_UArray2 pixels, 
+                          A2Methods_T methods)
+{
+        unsigned width = stream->width;
+        bool bytes = methods->size(pixels) == sizeof(ppm_rgb8);
+        struct Pnm_rgb *line = ALLOC((width + 1) * sizeof(struct Pnm_rgb));
+        for (unsigned row = 0; row < stream->height; row++) {
+                ppm_stream_read_row(stream, line);
+                for (unsigned col = 0; col < width; col++) {
+                        void *elem = methods->at(pixels, col, row);
+                        if (bytes) {
+                                ppm_rgb8 *pixel = elem;
+                                pixel->red = line[col].red;
+                                pixel->green = line[col].green;
+                                pixel->blue = line[col].blue;
+                        } else {
+                                *(struct Pnm_rgb *)elem = line[col];
+                        }
+                }
+        }
+        FREE(line);
+}
+
+/********** pack_row ******************************************************
+ *
+ * This function packs one row of a Pnm_ppm into the bytes of a raw ppm.
+ *
+ * Parameters:
+ *      Pnm_ppm ppm             the ppm
+ *      unsigned row            which row
+ *      unsigned char *bytes    where to put the row, must hold 3 * width 
+ *                              samples
+ *
+ * Return: N/A
+ *
+ * Expects: ppm and bytes are not NULL, row is less than the height
+ *     
+ * Notes: samples are one byte if the denominator is at most 255, and two 
+ *        (most significant first) otherwise
+ *      
+ ***********************************************************************/
+static void pack_row(Pnm_ppm ppm, unsigned row, unsigned char *bytes)
+{
+        A2Methods_T methods = ppm->methods;
+        bool rgb8 = methods->size(ppm->pixels) == sizeof(ppm_rgb8);
+        bool wide = ppm->denominator > BYTEDENOM;
+        for (unsigned col = 0; col < ppm->width; col++) {
+                void *elem = methods->at(ppm->pixels, col, row);
+                unsigned sample[3];
+                if (rgb8) {
+                        const ppm_rgb8 *pixel = elem;
+                        sample[0] = pixel->red;
+                        sample[1] = pixel->green;
+                        sample[2] = pixel->blue;
+                } else {
+                        const struct Pnm_rgb *pixel = elem;
+                        sample[0] = pixel->red;
+                        sample[1] = pixel->green;
+                        sample[2] = pixel->blue;
+                }
+                for (int i = 0; i < 3; i++) {
+                        if (wide) {
+                                *bytes++ = sample[i] >> 8;
+                        }
+                        *bytes++ = sample[i];
+                }
+        }
+}
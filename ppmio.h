@@ -0,0 +1,61 @@
+/*************************************************************************
+ *
+ *                     ppmio.h
+ *
+ *     Assignment: arith
+ *     Author:   Eva Caro
+ *     Date:     3/6/24
+ *
+ *     Interface of ppmio, which reads a ppm one row at a time instead of
+ *     loading the whole image like Pnm_ppmread does. The ppm can come from
+ *     any source (see source.h). It can also read and write a whole ppm, 
+ *     keeping 8-bit pixels packed in 3 bytes.
+ *
+ *************************************************************************/
+
+#ifndef PPMIO_INCLUDED
+#define PPMIO_INCLUDED
+#include <stdio.h>
+#include <stdbool.h>
+#include "pnm.h"
+#include "source.h"
+
+/* a ppm being read in one row at a time */
+typedef struct ppm_stream *ppm_stream;
+
+struct ppm_stream {
+        source input;
+        /* header information */
+        unsigned width, height, denominator;
+        /* true for a plain (P3) ppm, false for a raw (P6) one */
+        bool plain;
+        /* bytes in one raw row, and a buffer to read it into when the
+           input is not mapped */
+        size_t row_bytes;
+        unsigned char *raw;
+        /* number of rows read so far */
+        unsigned rows_read;
+};
+
+/* 
+ * a pixel of a ppm whose denominator is at most 255, packed as it is in a 
+ * raw ppm; a quarter of the size of a struct Pnm_rgb
+ */
+typedef struct ppm_rgb8 {
+        unsigned char red, green, blue;
+} ppm_rgb8;
+
+/*
+ * Whole-image reading and writing. The pixels of a Pnm_ppm from ppm_read 
+ * are ppm_rgb8's if its denominator is at most 255 and struct Pnm_rgb's 
+ * otherwise; the array's element size tells which. ppm_write takes either.
+ */
+Pnm_ppm ppm_read(FILE *input, A2Methods_T methods);
+void ppm_write(FILE *output, Pnm_ppm ppm);
+
+ppm_stream ppm_stream_open(source input);
+void ppm_stream_read_row(ppm_stream stream, struct Pnm_rgb *row);
+const unsigned char *ppm_stream_read_bytes(ppm_stream stream);
+void ppm_stream_close(ppm_stream *stream);
+
+#endif
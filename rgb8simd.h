@@ -0,0 +1,103 @@
+/*************************************************************************
+ *
+ *                     rgb8simd.h
+ *
+ *     Assignment: arith
+ *     Author:   Eva Caro
+ *     Date:     3/6/24
+ *
+ *     SSE4.1 helpers for moving between interleaved 8-bit rgb pixels and 
+ *     separate red, green, and blue bytes, shared by the vector kernels of
+ *     int.c and blocktable.c. Only for x86 with gcc; the kernels that use
+ *     them check the CPU first.
+ *
+ *************************************************************************/
+
+#ifndef RGB8SIMD_INCLUDED
+#define RGB8SIMD_INCLUDED
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+
+/********** load_rgb8 *****************************************************
+ *
+ * This function loads 8 interleaved 8-bit rgb pixels (24 bytes) and splits 
+ * them into their red, green, and blue bytes.
+ *
+ * Parameters:
+ *      const unsigned char *rgb        the pixels
+ *      __m128i *r, *g, *b              where to put the 8 red, green, and 
+ *                                      blue bytes (in the low 8 bytes)
+ *
+ * Return: void
+ *
+ * Expects: 24 bytes can be read from rgb
+ *     
+ * Notes: reads exactly 24 bytes, never past the end of the row
+ *      
+ *************************************************************************/
+__attribute__((target("sse4.1")))
+static inline void load_rgb8(const unsigned char *rgb, __m128i *r, 
+                             __m128i *g, __m128i *b)
+{
+        __m128i lo = _mm_loadu_si128((const __m128i *)rgb);
+        __m128i hi = _mm_loadl_epi64((const __m128i *)(rgb + 16));
+        *r = _mm_or_si128(_mm_shuffle_epi8(lo, _mm_setr_epi8(0, 3, 6, 9, 12,
+                                           15, -1, -1, -1, -1, -1, -1, -1, 
+                                           -1, -1, -1)),
+                          _mm_shuffle_epi8(hi, _mm_setr_epi8(-1, -1, -1, -1,
+                                           -1, -1, 2, 5, -1, -1, -1, -1, -1,
+                                           -1, -1, -1)));
+        *g = _mm_or_si128(_mm_shuffle_epi8(lo, _mm_setr_epi8(1, 4, 7, 10, 13,
+                                           -1, -1, -1, -1, -1, -1, -1, -1, 
+                                           -1, -1, -1)),
+                          _mm_shuffle_epi8(hi, _mm_setr_epi8(-1, -1, -1, -1,
+                                           -1, 0, 3, 6, -1, -1, -1, -1, -1,
+                                           -1, -1, -1)));
+        *b = _mm_or_si128(_mm_shuffle_epi8(lo, _mm_setr_epi8(2, 5, 8, 11, 14,
+                                           -1, -1, -1, -1, -1, -1, -1, -1, 
+                                           -1, -1, -1)),
+                          _mm_shuffle_epi8(hi, _mm_setr_epi8(-1, -1, -1, -1,
+                                           -1, 1, 4, 7, -1, -1, -1, -1, -1,
+                                           -1, -1, -1)));
+}
+
+/********** store_rgb8 ****************************************************
+ *
+ * This function interleaves 8 red, green, and blue bytes into 8 rgb pixels
+ * (24 bytes) and stores them.
+ *
+ * Parameters:
+ *      unsigned char *rgb              where to store the pixels
+ *      __m128i r, g, b                 the red, green, and blue bytes (in the
+ *                                      low 8 bytes)
+ *
+ * Return: void
+ *
+ * Expects: 24 bytes can be written to rgb
+ *     
+ * Notes: writes exactly 24 bytes
+ *      
+ *************************************************************************/
+__attribute__((target("sse4.1")))
+static inline void store_rgb8(unsigned char *rgb, __m128i r, __m128i g, 
+                              __m128i b)
+{
+        __m128i rg = _mm_unpacklo_epi64(r, g);
+        __m128i out0 = _mm_or_si128(_mm_shuffle_epi8(rg, _mm_setr_epi8(0, 8,
+                                    -1, 1, 9, -1, 2, 10, -1, 3, 11, -1, 4, 12,
+                                    -1, 5)),
+                                    _mm_shuffle_epi8(b, _mm_setr_epi8(-1, -1,
+                                    0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, 
+                                    -1, 4, -1)));
+        __m128i out1 = _mm_or_si128(_mm_shuffle_epi8(rg, _mm_setr_epi8(13, -1,
+                                    6, 14, -1, 7, 15, -1, -1, -1, -1, -1, -1,
+                                    -1, -1, -1)),
+                                    _mm_shuffle_epi8(b, _mm_setr_epi8(-1, 5, 
+                                    -1, -1, 6, -1, -1, 7, -1, -1, -1, -1, -1,
+                                    -1, -1, -1)));
+        _mm_storeu_si128((__m128i *)rgb, out0);
+        _mm_storel_epi64((__m128i *)(rgb + 16), out1);
+}
+
+#endif
+#endif
@@ -0,0 +1,317 @@
+/*************************************************************************
+ *
+ *                     source.c
+ *
+ *     Assignment: arith
+ *     Author:   Eva Caro
+ *     Date:     3/6/24
+ *
+ *     Implementation of source. Files on local disk are mapped with mmap so
+ *     that pixels and codewords can be read right out of the page cache 
+ *     without stdio copying them first. Anything that can't be mapped 
+ *     (stdin, pipes) is read through its FILE as usual.
+ *
+ *************************************************************************/
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "source.h"
+#include "assert.h"
+#include "mem.h"
+
+struct source {
+        /* the FILE to read from, NULL if the source is mapped */
+        FILE *input;
+        /* the mapping, its length, and how far into it we have read */
+        const unsigned char *bytes;
+        size_t length;
+        size_t pos;
+        /* how much of the front of the mapping source_release has given 
+           back */
+        size_t released;
+};
+
+/********** source_new ****************************************************
+ *
+ * This function makes a source that reads from the given FILE.
+ *
+ * Parameters:
+ *      FILE *input             where to read from
+ *
+ * Return: the new source
+ *
+ * Expects: input is not NULL
+ *     
+ * Notes: source_free does not close input
+ *      
+ ***********************************************************************/
+source source_new(FILE *input)
+{
+        assert(input != NULL);
+        source src;
+        NEW(src);
+        src->input = input;
+        src->bytes = NULL;
+        src->length = 0;
+        src->pos = 0;
+        src->released = 0;
+        return src;
+}
+
+/********** source_map ****************************************************
+ *
+ * This function maps the named file into memory and makes a source that 
+ * reads from the mapping. The kernel is told the file will be read from
+ * front to back.
+ *
+ * Parameters:
+ *      const char *path        name of the file to map
+ *
+ * Return: the new source, or NULL if the file can't be mapped (it doesn't 
+ *         exist, isn't a regular file, is empty, or mmap fails)
+ *
+ * Expects: path is not NULL
+ *     
+ * Notes: the file is unmapped by source_free. Callers should fall back to 
+ *        opening the file with fopen when NULL is returned.
+ *      
+ ***********************************************************************/
+source source_map(const char *path)
+{
+        assert(path != NULL);
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+                return NULL;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || 
+            info.st_size == 0) {
+                close(fd);
+                return NULL;
+        }
+        void *bytes = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (bytes == MAP_FAILED) {
+                return NULL;
+        }
+        madvise(bytes, info.st_size, MADV_SEQUENTIAL);
+
+        source src;
+        NEW(src);
+        src->input = NULL;
+        src->bytes = bytes;
+        src->length = info.st_size;
+        src->pos = 0;
+        src->released = 0;
+        return src;
+}
+
+/********** source_free ***************************************************
+ *
+ * This function frees a source, unmapping its file if it has one.
+ *
+ * Parameters:
+ *      source *src             pointer to the source to free
+ *
+ * Return: N/A
+ *
+ * Expects: src and *src are not NULL
+ *     
+ * Notes: does not close the FILE of a source made with source_new. Sets 
+ *        *src to NULL.
+ *      
+ ***********************************************************************/
+void source_free(source *src)
+{
+        assert(src != NULL && *src != NULL);
+        if ((*src)->bytes != NULL) {
+                munmap((void *)(*src)->bytes, (*src)->length);
+        }
+        FREE(*src);
+}
+
+/********** source_mapped *************************************************
+ *
+ * This function tells whether a source reads from a mapped file.
+ *
+ * Parameters:
+ *      source src              the source
+ *
+ * Return: true if src was made by source_map
+ *
+ * Expects: src is not NULL
+ *     
+ * Notes: pointers handed back by source_read on a mapped source stay good 
+ *        until the source is freed, not just until the next read
+ *      
+ ***********************************************************************/
+bool source_mapped(source src)
+{
+        assert(src != NULL);
+        return src->bytes != NULL;
+}
+
+/********** source_release ************************************************
+ *
+ * This function gives back the memory of the part of a mapped file that has
+ * already been read, so that reading a file from front to back keeps only 
+ * about one chunk of it resident instead of all of it.
+ *
+ * Parameters:
+ *      source src              the source
+ *
+ * Return: N/A
+ *
+ * Expects: src is not NULL
+ *     
+ * Notes: only whole pages before the read position are given back (with 
+ *        MADV_DONTNEED), so nothing not yet read is dropped. The mapping is
+ *        private and never written, so a page given back is just read from
+ *        the file again if it is touched, and old pointers from source_read
+ *        stay good. Does nothing for a FILE.
+ *      
+ ***********************************************************************/
+void source_release(source src)
+{
+        assert(src != NULL);
+        if (src->bytes == NULL) {
+                return;
+        }
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        size_t end = src->pos / page * page;
+        if (end > src->released) {
+                madvise((void *)(src->bytes + src->released), 
+                        end - src->released, MADV_DONTNEED);
+                src->released = end;
+        }
+}
+
+/********** source_getc ***************************************************
+ *
+ * This function reads the next byte from a source, like getc.
+ *
+ * Parameters:
+ *      source src              where to read from
+ *
+ * Return: the byte as an unsigned char converted to an int, or EOF
+ *
+ * Expects: src is not NULL
+ *     
+ * Notes: 
+ *      
+ ***********************************************************************/
+int source_getc(source src)
+{
+        assert(src != NULL);
+        if (src->input != NULL) {
+                return getc(src->input);
+        }
+        if (src->pos >= src->length) {
+                return EOF;
+        }
+        return src->bytes[src->pos++];
+}
+
+/********** source_ungetc *************************************************
+ *
+ * This function pushes back the byte last read by source_getc, like ungetc.
+ *
+ * Parameters:
+ *      source src              the source to push back onto
+ *      int c                   the byte last read (or EOF, which is ignored)
+ *
+ * Return: N/A
+ *
+ * Expects: src is not NULL, only one byte is pushed back between reads
+ *     
+ * Notes: 
+ *      
+ ***********************************************************************/
+void source_ungetc(source src, int c)
+{
+        assert(src != NULL);
+        if (c == EOF) {
+                return;
+        }
+        if (src->input != NULL) {
+                ungetc(c, src->input);
+        } else {
+                assert(src->pos > 0);
+                src->pos--;
+        }
+}
+
+/********** source_read_unsigned ******************************************
+ *
+ * This function skips whitespace and reads an unsigned decimal number, like
+ * fscanf's %u.
+ *
+ * Parameters:
+ *      source src              where to read from
+ *      bool *ok                set to whether a number was read
+ *
+ * Return: the number read, 0 if there wasn't one
+ *
+ * Expects: src and ok are not NULL
+ *     
+ * Notes: the character after the number is left unread
+ *      
+ ***********************************************************************/
+unsigned source_read_unsigned(source src, bool *ok)
+{
+        assert(src != NULL);
+        assert(ok != NULL);
+        int c = source_getc(src);
+        while (isspace(c)) {
+                c = source_getc(src);
+        }
+        *ok = isdigit(c);
+        unsigned n = 0;
+        while (isdigit(c)) {
+                n = n * 10 + (c - '0');
+                c = source_getc(src);
+        }
+        source_ungetc(src, c);
+        return n;
+}
+
+/********** source_read ***************************************************
+ *
+ * This function reads the next n bytes from a source. For a mapped source,
+ * it returns a pointer straight into the mapping and nothing is copied. For
+ * a FILE, the bytes are read into buffer with a single fread.
+ *
+ * Parameters:
+ *      source src              where to read from
+ *      size_t n                number of bytes to read
+ *      unsigned char *buffer   where to put the bytes if they must be copied,
+ *                              must hold n bytes
+ *
+ * Return: a pointer to the n bytes (either into the mapping or buffer), or
+ *         NULL if fewer than n bytes were left
+ *
+ * Expects: src and buffer are not NULL
+ *     
+ * Notes: a pointer into the mapping is valid until source_free is called
+ *      
+ ***********************************************************************/
+const unsigned char *source_read(source src, size_t n, unsigned char *buffer)
+{
+        assert(src != NULL);
+        assert(buffer != NULL);
+        if (src->input != NULL) {
+                if (fread(buffer, 1, n, src->input) != n) {
+                        return NULL;
+                }
+                return buffer;
+        }
+        if (src->length - src->pos < n) {
+                return NULL;
+        }
+        const unsigned char *bytes = src->bytes + src->pos;
+        src->pos += n;
+        return bytes;
+}
@@ -0,0 +1,34 @@
+/*************************************************************************
+ *
+ *                     source.h
+ *
+ *     Assignment: arith
+ *     Author:   Eva Caro
+ *     Date:     3/6/24
+ *
+ *     Interface of source, a place to read input bytes from. A source is 
+ *     either a FILE (such as stdin) or a file on disk mapped into memory, 
+ *     in which case reads hand back pointers straight into the mapping.
+ *
+ *************************************************************************/
+
+#ifndef SOURCE_INCLUDED
+#define SOURCE_INCLUDED
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef struct source *source;
+
+source source_new(FILE *input);
+source source_map(const char *path);
+void source_free(source *src);
+bool source_mapped(source src);
+void source_release(source src);
+
+int source_getc(source src);
+void source_ungetc(source src, int c);
+unsigned source_read_unsigned(source src, bool *ok);
+const unsigned char *source_read(source src, size_t n, unsigned char *buffer);
+
+#endif
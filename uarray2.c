@@ -15,18 +15,42 @@
  *************************************************************************/
 #include <stdio.h>
 #include <stdlib.h>
-#include "uarray.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
 #include "mem.h"
 #include "assert.h"
 #include "uarray2.h"
+#include "uarray2rows.h"
+#include "jobarena.h"
 
 struct UArray2_T_struct {
         int width;
         int height;
         int size;
-        UArray_T data;
+        /* element (column, row) is at column * col_step + row * row_step */
+        int col_step;
+        int row_step;
+        /* number of planes stacked in the array (see UArray2_new_planes), 
+           or 0 if it was made some other way */
+        int planes;
+        /* the first element, aligned to ELEM_ALIGN, or NULL if there are 
+           none */
+        char *elems;
+        /* what ALLOC returned for the elements, for FREE; NULL if there 
+           are none or the array was made in an arena */
+        void *raw;
+        /* whether the array was made in the arena in use at the time */
+        bool in_arena;
 };
 
+/* the elements start on a boundary of this many bytes (a cache line) */
+#define ELEM_ALIGN 64
+
+static UArray2_T uarray2_new(int width, int height, int size, bool row_major,
+                             int stride);
+static char *uarray2_base(UArray2_T uarray2);
+
 /********** UArray2_new ****************************************************
  *
  * This function creates a new UArray2 given the width, height, and size of
@@ -42,22 +66,194 @@ struct UArray2_T_struct {
  * Expects: width and height are >= 0, and size is the amount of memory
  *          each element requires (and is greater than 0)
  *    
- * Notes: this function allocates memory
+ * Notes: this function allocates memory. The elements are stored column by
+ *        column; UArray2_new_row_major stores them row by row instead.
  *    
  *************************************************************************/
 UArray2_T UArray2_new(int width, int height, int size)
+{
+        return uarray2_new(width, height, size, false, width);
+}
+
+/********** UArray2_new_row_major *******************************************
+ *
+ * This function creates a new UArray2 given the width, height, and size of
+ * every element, storing the elements row by row, so that walking along a 
+ * row (as UArray2_map_row_major does) touches memory in order.
+ *
+ * Parameters:
+ *      int width               width of the array  
+ *      int height              height of the array
+ *      int size                size of each element in the array
+ *
+ * Return: the allocated UArray2
+ *
+ * Expects: width and height are >= 0, and size is the amount of memory
+ *          each element requires (and is greater than 0)
+ *    
+ * Notes: this function allocates memory. Every other UArray2 function works
+ *        the same on either layout.
+ *    
+ *************************************************************************/
+UArray2_T UArray2_new_row_major(int width, int height, int size)
+{
+        return uarray2_new(width, height, size, true, width);
+}
+
+/********** UArray2_new_planes *********************************************
+ *
+ * This function creates a plane-major UArray2: planes images of width by 
+ * height elements (one per component of an image, say), stacked one after
+ * another in a row-major UArray2 that is width wide and planes * height 
+ * high. Row r of plane p is row p * height + r.
+ *
+ * Parameters:
+ *      int width               width of each plane
+ *      int height              height of each plane
+ *      int planes              number of planes
+ *      int size                size of each element in the array
+ *
+ * Return: the allocated UArray2
+ *
+ * Expects: width and height are >= 0, planes and size are greater than 0
+ *    
+ * Notes: this function allocates memory (see uarray2_new). If size divides
+ *        ELEM_ALIGN, the rows are padded so that every one of them, and so
+ *        every plane, starts on an ELEM_ALIGN boundary; each row is still 
+ *        contiguous, from UArray2_plane_row. Everything in uarray2.h works
+ *        on the whole stack.
+ *    
+ *************************************************************************/
+UArray2_T UArray2_new_planes(int width, int height, int planes, int size)
+{
+        assert(planes > 0);
+        assert(size > 0);
+        int stride = width;
+        if (ELEM_ALIGN % size == 0) {
+                int per_line = ELEM_ALIGN / size;
+                stride = (width + per_line - 1) / per_line * per_line;
+        }
+        UArray2_T uarray2 = uarray2_new(width, height * planes, size, true, 
+                                        stride);
+        uarray2->planes = planes;
+        return uarray2;
+}
+
+/********** UArray2_plane_row ***********************************************
+ *
+ * This function finds a row of one plane of a UArray2 made by 
+ * UArray2_new_planes.
+ *
+ * Parameters:
+ *      UArray2_T uarray2               given array
+ *      int plane                       which plane
+ *      int row                         which row of that plane
+ *
+ * Return: a pointer to the first element of the row; the rest of the row
+ *         follows it
+ *
+ * Expects: uarray2 is not NULL and was made by UArray2_new_planes, plane and
+ *          row are in range (CRE if not)
+ *    
+ *************************************************************************/
+void *UArray2_plane_row(UArray2_T uarray2, int plane, int row)
+{
+        assert(uarray2 != NULL);
+        assert(uarray2->planes > 0);
+        int height = uarray2->height / uarray2->planes;
+        assert(0 <= plane && plane < uarray2->planes);
+        assert(0 <= row && row < height);
+        return uarray2->elems + (ptrdiff_t)(plane * height + row) * 
+                                uarray2->row_step * uarray2->size;
+}
+
+/********** UArray2_planes **************************************************
+ *
+ * This function tells how many planes a UArray2 has.
+ *
+ * Parameters:
+ *      UArray2_T uarray2               given array
+ *
+ * Return: the number of planes if uarray2 was made by UArray2_new_planes, 
+ *         0 if it was not
+ *
+ * Expects: uarray2 is not NULL (CRE if it is)
+ *    
+ * Notes: the layout is kept in the array, so code that is handed an array 
+ *        can tell a stack of planes from an array of whole elements 
+ *        whichever methods made it
+ *    
+ *************************************************************************/
+int UArray2_planes(UArray2_T uarray2)
+{
+        assert(uarray2 != NULL);
+        return uarray2->planes;
+}
+
+/********** uarray2_new ****************************************************
+ *
+ * This function does the work of UArray2_new, UArray2_new_row_major, and
+ * UArray2_new_planes.
+ *
+ * Parameters:
+ *      int width               width of the array  
+ *      int height              height of the array
+ *      int size                size of each element in the array
+ *      bool row_major          whether to store the elements row by row
+ *                              (true) or column by column (false)
+ *      int stride              elements from the start of one row to the
+ *                              start of the next, if row_major
+ *
+ * Return: the allocated UArray2
+ *
+ * Expects: width and height are >= 0, size is greater than 0, stride is at
+ *          least width
+ *    
+ * Notes: this function allocates memory, from the calling thread's 
+ *        job_arena if it has one in use (see jobarena.h). Either way the 
+ *        elements are zeroed and start on an ELEM_ALIGN boundary.
+ *    
+ *************************************************************************/
+static UArray2_T uarray2_new(int width, int height, int size, bool row_major,
+                             int stride)
 {
         /* check that inputs are valid */
         assert(width >= 0);
         assert(height >= 0);
         assert(size > 0);
+        assert(stride >= width);
         /* Create the struct and fill it out */
-        UArray2_T new_UArray2 = ALLOC(sizeof(struct UArray2_T_struct));
+        job_arena arena = job_arena_current();
+        UArray2_T new_UArray2;
+        if (arena != NULL) {
+                new_UArray2 = job_arena_alloc(arena, 
+                                              sizeof(struct UArray2_T_struct));
+        } else {
+                new_UArray2 = ALLOC(sizeof(struct UArray2_T_struct));
+        }
         new_UArray2->width = width;
         new_UArray2->height = height;
         new_UArray2->size = size;
-        /* The length of this 1D UArray is width * height */
-        new_UArray2->data = UArray_new(width * height, size);
+        new_UArray2->col_step = row_major ? 1 : height;
+        new_UArray2->row_step = row_major ? stride : 1;
+        new_UArray2->planes = 0;
+        new_UArray2->elems = NULL;
+        new_UArray2->raw = NULL;
+        new_UArray2->in_arena = (arena != NULL);
+        size_t bytes = (size_t)(row_major ? stride : width) * height * size;
+        if (width == 0 || height == 0) {
+                return new_UArray2;
+        }
+        if (arena != NULL) {
+                /* arena allocations are already ELEM_ALIGN aligned */
+                new_UArray2->elems = job_arena_alloc(arena, bytes);
+        } else {
+                new_UArray2->raw = ALLOC(bytes + ELEM_ALIGN);
+                new_UArray2->elems = (char *)(((uintptr_t)new_UArray2->raw + 
+                                               ELEM_ALIGN - 1) & 
+                                              ~(uintptr_t)(ELEM_ALIGN - 1));
+        }
+        memset(new_UArray2->elems, 0, bytes);
 
         return new_UArray2;
 }
@@ -75,13 +271,21 @@ UArray2_T UArray2_new(int width, int height, int size)
  *          and that the pointer that the input pointer is pointing to 
  *          cannot be NULL
  *     
- * Notes: this function frees memory
+ * Notes: this function frees memory, unless the array was made in a 
+ *        job_arena, in which case it only clears the pointer
  *     
  *************************************************************************/
 void UArray2_free(UArray2_T *uarray2_p) 
 {
         assert(uarray2_p != NULL && *uarray2_p != NULL);
-        UArray_free(&((*uarray2_p)->data));
+        if ((*uarray2_p)->in_arena) {
+                /* the arena gets the memory back on reset */
+                *uarray2_p = NULL;
+                return;
+        }
+        if ((*uarray2_p)->raw != NULL) {
+                FREE((*uarray2_p)->raw);
+        }
 
         FREE(*uarray2_p);
 }
@@ -175,7 +379,9 @@ void *UArray2_at(UArray2_T uarray2, int column, int row)
         assert(uarray2 != NULL);
         assert(0 <= column && column < uarray2->width);
         assert(0 <= row && row < uarray2->height);
-        return UArray_at(uarray2->data, column * uarray2->height + row);
+        return uarray2->elems + ((ptrdiff_t)column * uarray2->col_step + 
+                                 (ptrdiff_t)row * uarray2->row_step) * 
+                                uarray2->size;
 }
 
 /********** UArray2_map_col_major *****************************************
@@ -202,7 +408,9 @@ void *UArray2_at(UArray2_T uarray2, int column, int row)
  * Expects: uarray2 is not NULL (CRE if it is), that the apply function is
  *          valid
  *    
- * Notes: Apply function supplies client with anything they need
+ * Notes: Apply function supplies client with anything they need. Finds 
+ *        the first element once and steps a pointer from there, rather than
+ *        calling UArray2_at on each element.
  *    
  *************************************************************************/
 
@@ -210,10 +418,14 @@ void *UArray2_at(UArray2_T uarray2, int column, int row)
                             UArray2_T uarray2, void *val, void *cl), void *cl)
 {
         assert(uarray2 != NULL);
+        char *base = uarray2_base(uarray2);
+        ptrdiff_t col_step = (ptrdiff_t)uarray2->col_step * uarray2->size;
+        ptrdiff_t row_step = (ptrdiff_t)uarray2->row_step * uarray2->size;
         for (int column = 0; column < uarray2->width; column++) {
+                char *elem = base + column * col_step;
                 for (int row = 0; row < uarray2->height; row++) {
-                        apply(column, row, uarray2, UArray2_at(uarray2, column, 
-                                                               row), cl);
+                        apply(column, row, uarray2, elem, cl);
+                        elem += row_step;
                 }
         }
 }
@@ -244,7 +456,9 @@ void *UArray2_at(UArray2_T uarray2, int column, int row)
  * Expects: uarray2 is not NULL (CRE if it is), that the apply function is
  *          valid
  *    
- * Notes: Apply function supplies client with anything they need
+ * Notes: Apply function supplies client with anything they need. Finds 
+ *        the first element once and steps a pointer from there, rather than
+ *        calling UArray2_at on each element.
  *    
  *************************************************************************/
 
@@ -252,11 +466,176 @@ void UArray2_map_row_major(UArray2_T uarray2, void apply(int column, int row,
                             UArray2_T uarray2, void *val, void *cl), void *cl)
 {      
         assert(uarray2 != NULL);
+        char *base = uarray2_base(uarray2);
+        ptrdiff_t col_step = (ptrdiff_t)uarray2->col_step * uarray2->size;
+        ptrdiff_t row_step = (ptrdiff_t)uarray2->row_step * uarray2->size;
         for (int row = 0; row < uarray2->height; row++) {
+                char *elem = base + row * row_step;
                 for (int column = 0; column < uarray2->width; column++) {
-                        apply(column, row, uarray2, UArray2_at(uarray2, column,
-                                                               row), cl);
+                        apply(column, row, uarray2, elem, cl);
+                        elem += col_step;
+                }
+        }
+}
+
+/********** UArray2_map_tiles ********************************************
+ *
+ * This function goes through the UArray2 one tile at a time: the array is 
+ * cut into tile-by-tile squares (smaller at the right and bottom edges if 
+ * the tile does not divide the width or height), the squares are visited
+ * in row major order, and so are the elements inside each square. 
+ *
+ * Parameters:
+ *      UArray2 uarray2                    given array
+ *      int tile                           the side of a square, in elements
+ *      void apply ()                      the pointer function, called as 
+ *                                         UArray2_map_row_major calls it
+ *      void *cl                           closure, passed to apply
+ *
+ * Return: None
+ *
+ * Expects: uarray2 is not NULL, tile > 0 (CRE if not)
+ *    
+ * Notes: With a tile small enough for the cache, everything near an element
+ *        (above, below, and to either side) is visited close together in 
+ *        time, whichever way the array is stored. An even tile never splits
+ *        a 2-by-2 block that starts at an even column and row.
+ *    
+ *************************************************************************/
+void UArray2_map_tiles(UArray2_T uarray2, int tile, void apply(int column, 
+                       int row, UArray2_T uarray2, void *val, void *cl), 
+                       void *cl)
+{
+        assert(uarray2 != NULL);
+        assert(tile > 0);
+        char *base = uarray2_base(uarray2);
+        ptrdiff_t col_step = (ptrdiff_t)uarray2->col_step * uarray2->size;
+        ptrdiff_t row_step = (ptrdiff_t)uarray2->row_step * uarray2->size;
+        for (int row0 = 0; row0 < uarray2->height; row0 += tile) {
+                int row1 = row0 + tile;
+                if (row1 > uarray2->height) {
+                        row1 = uarray2->height;
+                }
+                for (int col0 = 0; col0 < uarray2->width; col0 += tile) {
+                        int col1 = col0 + tile;
+                        if (col1 > uarray2->width) {
+                                col1 = uarray2->width;
+                        }
+                        for (int row = row0; row < row1; row++) {
+                                char *elem = base + row * row_step + 
+                                             col0 * col_step;
+                                for (int column = col0; column < col1; 
+                                     column++) {
+                                        apply(column, row, uarray2, elem, cl);
+                                        elem += col_step;
+                                }
+                        }
+                }
+        }
+}
+
+/********** UArray2_map_row_spans ****************************************
+ *
+ * This function goes through the UArray2 a row at a time, from the top, and
+ * calls the apply function once per row with a pointer to the whole row, 
+ * so the client can hand it to a whole-row kernel.
+ *
+ * Parameters:
+ *      UArray2 uarray2                    given array
+ *      void apply ()                      the pointer function
+ *              apply(int row)             which row this is
+ *              apply(UArray2_T)           the original UArray2
+ *              apply(void *span)          the row's width elements, one 
+ *                                         after the other
+ *              apply(int n)               number of elements in the span
+ *              apply(void *cl)            closure if needed by client  
+ *     void *cl                            closure, passed to apply
+ *
+ * Return: None
+ *
+ * Expects: uarray2 is not NULL (CRE if it is)
+ *    
+ * Notes: For an array made by UArray2_new_row_major the span is the row 
+ *        itself. For a column-major one the row is copied into a buffer, 
+ *        handed to apply, and copied back, so changes to the span always 
+ *        reach the array.
+ *    
+ *************************************************************************/
+void UArray2_map_row_spans(UArray2_T uarray2, void apply(int row, 
+                           UArray2_T uarray2, void *span, int n, void *cl), 
+                           void *cl)
+{
+        assert(uarray2 != NULL);
+        int width = uarray2->width;
+        int size = uarray2->size;
+        char *base = uarray2_base(uarray2);
+        if (base == NULL) {
+                return;
+        }
+        if (UArray2_row_major(uarray2)) {
+                ptrdiff_t row_step = (ptrdiff_t)uarray2->row_step * size;
+                for (int row = 0; row < uarray2->height; row++) {
+                        apply(row, uarray2, base + row * row_step, width, cl);
                 }
+                return;
         }
+
+        ptrdiff_t col_step = (ptrdiff_t)uarray2->col_step * size;
+        char *span = ALLOC(width * size);
+        for (int row = 0; row < uarray2->height; row++) {
+                char *elem = base + row * (ptrdiff_t)size;
+                for (int column = 0; column < width; column++) {
+                        memcpy(span + column * size, elem + column * col_step,
+                               size);
+                }
+                apply(row, uarray2, span, width, cl);
+                for (int column = 0; column < width; column++) {
+                        memcpy(elem + column * col_step, span + column * size,
+                               size);
+                }
+        }
+        FREE(span);
+}
+
+/********** UArray2_row_major **********************************************
+ *
+ * This function tells whether a UArray2 is stored row by row.
+ * 
+ * Parameters:
+ *      UArray2_T uarray2               given array
+ *
+ * Return: true if uarray2 was made by UArray2_new_row_major (or is only one
+ *         row high), false if it is stored column by column
+ *
+ * Expects: uarray is not NULL (CRE if it is)
+ *     
+ * Notes: when this is true, the elements of each row are next to each other,
+ *        starting at UArray2_at(uarray2, 0, row)
+ *     
+ *************************************************************************/
+bool UArray2_row_major(UArray2_T uarray2)
+{
+        assert(uarray2 != NULL);
+        return uarray2->col_step == 1;
+}
+
+/********** uarray2_base ***************************************************
+ *
+ * This function finds where the elements of a UArray2 start.
+ * 
+ * Parameters:
+ *      UArray2_T uarray2               given array
+ *
+ * Return: a pointer to the first element, or NULL if there are none
+ *
+ * Expects: uarray is not NULL
+ *     
+ * Notes: the elements are in one block (ALLOC'd, or from an arena), so 
+ *        every other element is at a fixed offset from this one
+ *     
+ *************************************************************************/
+static char *uarray2_base(UArray2_T uarray2)
+{
+        return uarray2->elems;
 }
 
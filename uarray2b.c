@@ -8,86 +8,111 @@
  *
  *
  *     Implemention of UArray2B_T.h, which is a 2-dimensional blocked
- *     UArray. Uses Hanson's unblocked arrays.
+ *     UArray. All of the blocks share one aligned allocation.
  *
  *************************************************************************/
 
 #include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
 #include "assert.h"
 #include "mem.h"
-#include "uarray.h"
-#include "uarray2.h"
 #include "uarray2b.h"
+#include "jobarena.h"
 
 #define T UArray2b_T
 
+/* cells start on a boundary of this many bytes (a cache line) */
+#define CELL_ALIGN 64
+
 struct T { /* represents a 2D array of cells each of size 'size' */
         int width, height;
         unsigned blocksize;
         unsigned size;
-        UArray2_T blocks;
         /*
-         * matrix of blocks, each blocksize * blocksize 
-         *
-         * matrix dimensions are width and height divided by blocksize,
-         * rounded up
+         * all of the cells, in one allocation, aligned to CELL_ALIGN
          *
-         * a block is a Uarray_T of length blocksize * blocksize 
-         * and size 'size'
+         * the blocks are laid out back to back, blocksize * blocksize 
+         * cells each, going down each column of blocks before moving 
+         * right to the next one (the order UArray2b_map visits them in)
          *
-         * invariant relating cells in blocks to cells in the abstraction
-         *  described in section on coordinate transformations below
+         * there are width and height divided by blocksize, rounded up, 
+         * blocks across and down; cell (i, j) is number 
+         * (i % blocksize) * blocksize + j % blocksize of block 
+         * (i / blocksize, j / blocksize)
+         */
+        char *cells;
+        int xblocks, yblocks;
+        size_t block_bytes;
+        /*
+         * when blocksize is a power of two, i / blocksize is 
+         * i >> shift and i % blocksize is i & mask
          */
+        bool pow2;
+        unsigned shift, mask;
+        /* what ALLOC returned, for FREE, or NULL if the array was made in 
+           a job_arena */
+        void *raw;
 };
 
-#include <stdio.h>  /* include so we can print diagnostics */
-
+/*
+ * Makes a blocked array in one allocation, zeroed like a UArray's. Freeing
+ * it is two FREEs however many blocks there are. If the calling thread has
+ * a job_arena in use, the array is made in it instead and freeing it does
+ * nothing (see jobarena.h).
+ */
 T UArray2b_new(int width, int height, int size, int blocksize)
 {
         assert(blocksize > 0);
+        assert(width >= 0 && height >= 0);
+        assert(size > 0);
+        job_arena arena = job_arena_current();
         T array;
-        NEW(array);
+        if (arena != NULL) {
+                array = job_arena_alloc(arena, sizeof(*array));
+        } else {
+                NEW(array);
+        }
         array->width  = width;
         array->height = height;
         array->size   = size;
         array->blocksize = blocksize;
-        array->blocks = UArray2_new((width  + blocksize - 1) / blocksize,
-                                    (height + blocksize - 1) / blocksize,
-                                    sizeof(UArray_T));
-        int xblocks = UArray2_width (array->blocks); 
-        int yblocks = UArray2_height(array->blocks);
-        for (int i = 0; i < xblocks; i++) {
-                for (int j = 0; j < yblocks; j++) {
-                        UArray_T *block = UArray2_at(array->blocks, i, j);
-                        *block = UArray_new(blocksize * blocksize, size);
-                        
-                        if (0) {
-                                fprintf(stderr, "Allocated %p; put %p at %p\n",
-                                (void *)*block, 
-                                (void *)*(UArray_T*)UArray2_at(array->blocks, 
-                                i, j),
-                                UArray2_at(array->blocks, i, j));
-                        }
-                }
+        array->xblocks = (width  + blocksize - 1) / blocksize;
+        array->yblocks = (height + blocksize - 1) / blocksize;
+        array->block_bytes = (size_t)blocksize * blocksize * size;
+
+        array->pow2 = (blocksize & (blocksize - 1)) == 0;
+        array->mask = blocksize - 1;
+        array->shift = 0;
+        while ((1u << array->shift) < (unsigned)blocksize) {
+                array->shift++;
+        }
+
+        size_t bytes = array->block_bytes * array->xblocks * array->yblocks;
+        if (arena != NULL) {
+                /* arena allocations are already CELL_ALIGN aligned */
+                array->raw = NULL;
+                array->cells = job_arena_alloc(arena, bytes);
+                memset(array->cells, 0, bytes);
+                return array;
         }
+        array->raw = ALLOC(bytes + CELL_ALIGN);
+        memset(array->raw, 0, bytes + CELL_ALIGN);
+        array->cells = (char *)(((uintptr_t)array->raw + CELL_ALIGN - 1) & 
+                                ~(uintptr_t)(CELL_ALIGN - 1));
         return array;
 }
 
 void UArray2b_free(T *array2b)
 {
-        int i;
         assert(array2b && *array2b);
-        T array = *array2b;
-        int xblocks = UArray2_width (array->blocks);
-        int yblocks = UArray2_height(array->blocks);
-        assert(UArray2_size(array->blocks) == sizeof(UArray_T));
-        for (i = 0; i < xblocks; i++) {
-                for (int j = 0; j < yblocks; j++) {
-                        UArray_T *p = UArray2_at(array->blocks, i, j);
-                        UArray_free(p);
-                }
+        if ((*array2b)->raw == NULL) {
+                *array2b = NULL;
+                return;
         }
-        UArray2_free(&(*array2b)->blocks);
+        FREE((*array2b)->raw);
         FREE(*array2b);
 }
 
@@ -112,42 +137,53 @@ void *UArray2b_at(T array2b, int i, int j)
         assert(i >= 0 && j >= 0);
         /* avoid unused cells */
         assert(i < array2b->width && j < array2b->height);
-        int b  = array2b->blocksize;
-        int bx = i / b;   /* block x coordinate */
-        int by = j / b;   /* block y coordinate */
-        UArray_T *blockp = UArray2_at(array2b->blocks, bx, by);
-        return UArray_at(*blockp, (i % b) * b + j % b);
+        int bx, by, cell;
+        if (array2b->pow2) {
+                unsigned shift = array2b->shift;
+                unsigned mask = array2b->mask;
+                bx = i >> shift;
+                by = j >> shift;
+                cell = ((i & mask) << shift) | (j & mask);
+        } else {
+                int b = array2b->blocksize;
+                bx = i / b;
+                by = j / b;
+                cell = (i % b) * b + j % b;
+        }
+        return array2b->cells + 
+               (size_t)(bx * array2b->yblocks + by) * array2b->block_bytes + 
+               (size_t)cell * array2b->size;
 }
 
+/*
+ * Blocks and the cells in them are visited in the order they are stored, 
+ * so this is one pass straight through memory
+ */
 void UArray2b_map(T array2b, 
                   void apply(int col, int row, T array2b,
                              void *elem, void *cl),
                   void *cl)
 {
         assert(array2b != NULL);
-        int       h      = array2b->height;
-        int       w      = array2b->width;
-        int       b      = array2b->blocksize;
-        UArray2_T blocks = array2b->blocks;
-        int       bw     = UArray2_width(blocks);
-        int       bh     = UArray2_height(blocks);
-
-        for (int bx = 0; bx < bw; bx++) {
-                for (int by = 0; by < bh; by++) {
-                        UArray_T *blockp = UArray2_at(blocks, bx, by);
-                        UArray_T  block  = *blockp;
-                        int       len    = UArray_length(block);
+        int  h    = array2b->height;
+        int  w    = array2b->width;
+        int  b    = array2b->blocksize;
+        int  size = array2b->size;
+        char *elem = array2b->cells;
+
+        for (int bx = 0; bx < array2b->xblocks; bx++) {
+                for (int by = 0; by < array2b->yblocks; by++) {
                         /* (i0, j0) correspond to upper left */
                         /* corner of block (bx, by)          */
                         int i0 = b * bx; 
                         int j0 = b * by; 
-                        for (int cell = 0; cell < len; cell++) {
-                                int i = i0 + cell / b;
-                                int j = j0 + cell % b;
-                                /* measured overhead 0.5% to 1.5% */
-                                if (i < w && j < h) {
-                                        apply(i, j, array2b, 
-                                              UArray_at(block, cell), cl);
+                        for (int i = i0; i < i0 + b; i++) {
+                                for (int j = j0; j < j0 + b; j++) {
+                                        if (i < w && j < h) {
+                                                apply(i, j, array2b, elem, 
+                                                      cl);
+                                        }
+                                        elem += size;
                                 }
                         }
                 }
@@ -177,4 +213,5 @@ int UArray2b_blocksize(T array2b)
         return array2b->blocksize;
 }
 
-int UArray2b_version_uses_UArray2_T = 1;
\ No newline at end of file
+/* the blocks are no longer kept in a UArray2_T */
+int UArray2b_version_uses_UArray2_T = 0;
\ No newline at end of file
@@ -0,0 +1,60 @@
+/*************************************************************************
+ *
+ *                     uarray2rows.h
+ *
+ *     Assignment: arith
+ *     Author:   Eva Caro
+ *     Date:     3/6/24
+ *
+ *     Row-major storage for UArray2_T. A UArray2 made by UArray2_new keeps 
+ *     its elements column by column, so walking along a row strides by a 
+ *     whole column each step. One made by UArray2_new_row_major keeps them
+ *     row by row instead; everything else in uarray2.h works on both, as 
+ *     does UArray2_map_row_spans, which hands its apply function a whole 
+ *     row at a time.
+ *
+ *     UArray2_new_planes stacks several same-sized images (the planes of a
+ *     structure-of-arrays image) in one row-major array, each row starting
+ *     on a cache line; UArray2_plane_row finds a row of one plane, and 
+ *     UArray2_planes tells a stack of planes from any other UArray2.
+ *
+ *     uarray2_methods_plain_rows is uarray2_methods_plain with new() making
+ *     row-major arrays. Since the layout lives in the array, arrays from 
+ *     either suite can be used through either one, and code that needs to
+ *     know the layout asks the array (after uarray2_methods_is_plain says 
+ *     it is a UArray2), never which suite it came with.
+ *
+ *************************************************************************/
+
+#ifndef UARRAY2ROWS_INCLUDED
+#define UARRAY2ROWS_INCLUDED
+#include <stdbool.h>
+#include "uarray2.h"
+#include "a2methods.h"
+
+extern UArray2_T UArray2_new_row_major(int width, int height, int size);
+extern bool UArray2_row_major(UArray2_T uarray2);
+
+extern UArray2_T UArray2_new_planes(int width, int height, int planes, 
+                                    int size);
+extern void *UArray2_plane_row(UArray2_T uarray2, int plane, int row);
+extern int UArray2_planes(UArray2_T uarray2);
+
+/* visits tile-by-tile squares in row major order, and the elements in each
+ * square in row major order */
+extern void UArray2_map_tiles(UArray2_T uarray2, int tile, void apply(
+                              int column, int row, UArray2_T uarray2, 
+                              void *val, void *cl), void *cl);
+
+/* calls apply once per row, top to bottom, with the row's n elements laid 
+ * out one after the other in span; works on either layout */
+extern void UArray2_map_row_spans(UArray2_T uarray2, void apply(int row, 
+                                  UArray2_T uarray2, void *span, int n, 
+                                  void *cl), void *cl);
+
+extern A2Methods_T uarray2_methods_plain_rows;
+
+/* true if methods is either plain suite, so that its arrays are UArray2's */
+extern bool uarray2_methods_is_plain(A2Methods_T methods);
+
+#endif
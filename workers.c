@@ -0,0 +1,260 @@
+/*************************************************************************
+ *
+ *                     workers.c
+ *
+ *     Assignment: arith
+ *     Author:   Eva Caro
+ *     Date:     3/6/24
+ *
+ *     Implementation of workers. The threads sleep on a condition variable
+ *     between runs. Each run bumps a generation counter and wakes them; 
+ *     they then claim jobs one at a time from a shared counter until there
+ *     are none left, so faster threads simply end up doing more jobs.
+ *
+ *************************************************************************/
+
+#include <pthread.h>
+#include <stdbool.h>
+#include "workers.h"
+#include "assert.h"
+#include "mem.h"
+
+struct worker {
+        workers pool;
+        unsigned id;
+};
+
+struct workers {
+        /* number of threads, counting the one that calls workers_run */
+        unsigned count;
+        pthread_t *threads;
+        struct worker *args;
+
+        pthread_mutex_t lock;
+        pthread_cond_t start, done;
+        /* bumped by every workers_run, so threads know there is work */
+        unsigned long generation;
+        /* background threads still working on the current run */
+        unsigned busy;
+        bool quit;
+
+        /* the current run */
+        workers_apply *apply;
+        void *cl;
+        int jobs;
+        int next;
+};
+
+static void *worker_main(void *arg);
+static void do_jobs(workers pool, unsigned id);
+
+/********** workers_new ***************************************************
+ *
+ * This function makes a pool of count threads: the calling thread and 
+ * count - 1 new ones.
+ *
+ * Parameters:
+ *      unsigned count          number of threads to run jobs on
+ *
+ * Return: the new pool
+ *
+ * Expects: count is at least 1
+ *     
+ * Notes: a pool of 1 starts no threads and runs every job on the caller.
+ *        The pool must be freed with workers_free.
+ *      
+ ***********************************************************************/
+workers workers_new(unsigned count)
+{
+        assert(count >= 1);
+        workers pool;
+        NEW(pool);
+        pool->count = count;
+        pool->threads = ALLOC(count * sizeof(pthread_t));
+        pool->args = ALLOC(count * sizeof(struct worker));
+        pthread_mutex_init(&pool->lock, NULL);
+        pthread_cond_init(&pool->start, NULL);
+        pthread_cond_init(&pool->done, NULL);
+        pool->generation = 0;
+        pool->busy = 0;
+        pool->quit = false;
+        pool->apply = NULL;
+        pool->cl = NULL;
+        pool->jobs = 0;
+        pool->next = 0;
+
+        for (unsigned id = 1; id < count; id++) {
+                pool->args[id].pool = pool;
+                pool->args[id].id = id;
+                int err = pthread_create(&pool->threads[id], NULL, 
+                                         worker_main, &pool->args[id]);
+                assert(err == 0);
+        }
+        return pool;
+}
+
+/********** workers_count *************************************************
+ *
+ * This function gives the number of threads in a pool.
+ *
+ * Parameters:
+ *      workers pool            the pool
+ *
+ * Return: the number of threads, counting the calling thread
+ *
+ * Expects: pool is not NULL
+ *     
+ * Notes: worker numbers passed to apply functions are less than this
+ *      
+ ***********************************************************************/
+unsigned workers_count(workers pool)
+{
+        assert(pool != NULL);
+        return pool->count;
+}
+
+/********** workers_run ***************************************************
+ *
+ * This function runs apply(job, worker, cl) for every job from 0 to 
+ * jobs - 1, spread over the threads of the pool, and waits for all of them
+ * to finish.
+ *
+ * Parameters:
+ *      workers pool            the pool
+ *      int jobs                number of jobs
+ *      workers_apply *apply    the function that runs one job
+ *      void *cl                closure passed to apply
+ *
+ * Return: N/A
+ *
+ * Expects: pool and apply are not NULL
+ *     
+ * Notes: jobs can run in any order and at the same time, so apply must 
+ *        only touch memory that belongs to its job or its worker. An 
+ *        exception raised by apply ends the program (see workers.h).
+ *      
+ ***********************************************************************/
+void workers_run(workers pool, int jobs, workers_apply *apply, void *cl)
+{
+        assert(pool != NULL);
+        assert(apply != NULL);
+        pthread_mutex_lock(&pool->lock);
+        pool->apply = apply;
+        pool->cl = cl;
+        pool->jobs = jobs;
+        pool->next = 0;
+        pool->busy = pool->count - 1;
+        pool->generation++;
+        pthread_cond_broadcast(&pool->start);
+        pthread_mutex_unlock(&pool->lock);
+
+        do_jobs(pool, 0);
+
+        pthread_mutex_lock(&pool->lock);
+        while (pool->busy > 0) {
+                pthread_cond_wait(&pool->done, &pool->lock);
+        }
+        pthread_mutex_unlock(&pool->lock);
+}
+
+/********** workers_free **************************************************
+ *
+ * This function stops the threads of a pool and frees it.
+ *
+ * Parameters:
+ *      workers *pool           pointer to the pool to free
+ *
+ * Return: N/A
+ *
+ * Expects: pool and *pool are not NULL, no workers_run is in progress
+ *     
+ * Notes: sets *pool to NULL
+ *      
+ ***********************************************************************/
+void workers_free(workers *pool)
+{
+        assert(pool != NULL && *pool != NULL);
+        workers p = *pool;
+        pthread_mutex_lock(&p->lock);
+        p->quit = true;
+        pthread_cond_broadcast(&p->start);
+        pthread_mutex_unlock(&p->lock);
+        for (unsigned id = 1; id < p->count; id++) {
+                pthread_join(p->threads[id], NULL);
+        }
+        pthread_mutex_destroy(&p->lock);
+        pthread_cond_destroy(&p->start);
+        pthread_cond_destroy(&p->done);
+        FREE(p->threads);
+        FREE(p->args);
+        FREE(*pool);
+}
+
+/********** worker_main ***************************************************
+ *
+ * This is the body of each background thread: wait for a run, do jobs 
+ * until there are none left, report back, and wait again.
+ *
+ * Parameters:
+ *      void *arg               the thread's struct worker
+ *
+ * Return: NULL
+ *
+ * Expects: arg is not NULL
+ *     
+ * Notes: returns when the pool is freed
+ *      
+ ***********************************************************************/
+static void *worker_main(void *arg)
+{
+        struct worker *self = arg;
+        workers pool = self->pool;
+        unsigned long seen = 0;
+
+        pthread_mutex_lock(&pool->lock);
+        for (;;) {
+                while (pool->generation == seen && !pool->quit) {
+                        pthread_cond_wait(&pool->start, &pool->lock);
+                }
+                if (pool->quit) {
+                        break;
+                }
+                seen = pool->generation;
+                pthread_mutex_unlock(&pool->lock);
+
+                do_jobs(pool, self->id);
+
+                pthread_mutex_lock(&pool->lock);
+                pool->busy--;
+                if (pool->busy == 0) {
+                        pthread_cond_signal(&pool->done);
+                }
+        }
+        pthread_mutex_unlock(&pool->lock);
+        return NULL;
+}
+
+/********** do_jobs *******************************************************
+ *
+ * This function claims and runs jobs of the current run until there are 
+ * none left.
+ *
+ * Parameters:
+ *      workers pool            the pool
+ *      unsigned id             number of the thread doing the jobs
+ *
+ * Return: N/A
+ *
+ * Expects: pool is not NULL
+ *     
+ * Notes: jobs are claimed with an atomic add on pool->next
+ *      
+ ***********************************************************************/
+static void do_jobs(workers pool, unsigned id)
+{
+        int job;
+        while ((job = __atomic_fetch_add(&pool->next, 1, 
+                                         __ATOMIC_RELAXED)) < pool->jobs) {
+                pool->apply(job, id, pool->cl);
+        }
+}
@@ -0,0 +1,36 @@
+/*************************************************************************
+ *
+ *                     workers.h
+ *
+ *     Assignment: arith
+ *     Author:   Eva Caro
+ *     Date:     3/6/24
+ *
+ *     Interface of workers, a fixed pool of threads that run numbered jobs.
+ *     workers_run hands out jobs 0 to n - 1 to the threads (the calling 
+ *     thread included) and returns once every job is finished.
+ *
+ *     What of cii40 can be used on other threads (here and in batch.c): 
+ *     mem.h's ALLOC, NEW, and FREE are malloc and free underneath, so they
+ *     are thread safe. Exceptions are not: except.h keeps a single stack 
+ *     of TRY handlers for the whole program, so nothing raised on another
+ *     thread (a failed assert, an ALLOC out of memory, Pnm_Badformat) can 
+ *     be caught. Nothing in arith uses TRY, so any of them ends the 
+ *     program, from whichever thread it is raised.
+ *
+ *************************************************************************/
+
+#ifndef WORKERS_INCLUDED
+#define WORKERS_INCLUDED
+
+typedef struct workers *workers;
+
+/* runs job number job on thread number worker (0 is the calling thread) */
+typedef void workers_apply(int job, unsigned worker, void *cl);
+
+workers workers_new(unsigned count);
+unsigned workers_count(workers pool);
+void workers_run(workers pool, int jobs, workers_apply *apply, void *cl);
+void workers_free(workers *pool);
+
+#endif